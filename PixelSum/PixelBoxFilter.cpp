@@ -0,0 +1,193 @@
+#include "PixelBoxFilter.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void subtractLine(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	subtractArraySSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] - src1[x];
+	}
+#endif // __SSE2__
+}
+
+void scaleLine(const unsigned int* src, float scale, float* dst, int len)
+{
+#ifdef __SSE2__
+	convertScaleU32SSE(src, scale, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = float(src[x]) * scale;
+	}
+#endif // __SSE2__
+}
+
+void divideLine(const unsigned int* src0, const unsigned int* src1, float* dst, int len)
+{
+#ifdef __SSE2__
+	divideU32SSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src1[x] != 0 ? float(src0[x]) / float(src1[x]) : 0.0f;
+	}
+#endif // __SSE2__
+}
+
+BoxFilter::BoxFilter(const PixelSum& pixelSum, int threads)
+	: _pixelSum(pixelSum)
+	, _threads(threads)
+{
+}
+
+void BoxFilter::getBandLine(const unsigned int* bottom, const unsigned int* top, unsigned int* dst, int xWidth)
+{
+	if (top == nullptr)
+	{
+		if (dst != bottom)
+		{
+			memcpy(dst, bottom, xWidth * sizeof(unsigned int));
+		}
+
+		return;
+	}
+
+	subtractLine(bottom, top, dst, xWidth);
+}
+
+void BoxFilter::getWindowLine(const unsigned int* columns, int xWidth, int radius, unsigned int* dst)
+{
+	// S(x) = columns(min(x + r, w - 1)) - columns(x - r - 1)
+	int innerBegin = std::min(radius + 1, xWidth);
+	int innerEnd = std::max(xWidth - radius, innerBegin);
+
+	for (int x = 0; x < innerBegin; ++x)
+	{
+		dst[x] = columns[std::min(x + radius, xWidth - 1)];
+	}
+
+	if (innerEnd > innerBegin)
+	{
+		subtractLine(columns + innerBegin + radius, columns + innerBegin - radius - 1, dst + innerBegin, innerEnd - innerBegin);
+	}
+
+	for (int x = innerEnd; x < xWidth; ++x)
+	{
+		dst[x] = columns[xWidth - 1] - (x - radius - 1 >= 0 ? columns[x - radius - 1] : 0);
+	}
+}
+
+void BoxFilter::getSum(int radius, unsigned int* dst) const
+{
+	getSum(&radius, 1, &dst);
+}
+
+void BoxFilter::getMean(int radius, float* dst) const
+{
+	getMean(&radius, 1, &dst);
+}
+
+void BoxFilter::getNonZeroMean(int radius, float* dst) const
+{
+	getNonZeroMean(&radius, 1, &dst);
+}
+
+void BoxFilter::getSum(const int* radii, int count, unsigned int* const* dst) const
+{
+	filter(radii, count, Output::Sum, reinterpret_cast<void* const*>(dst));
+}
+
+void BoxFilter::getMean(const int* radii, int count, float* const* dst) const
+{
+	filter(radii, count, Output::Mean, reinterpret_cast<void* const*>(dst));
+}
+
+void BoxFilter::getNonZeroMean(const int* radii, int count, float* const* dst) const
+{
+	filter(radii, count, Output::NonZeroMean, reinterpret_cast<void* const*>(dst));
+}
+
+void BoxFilter::filter(const int* radii, int count, Output output, void* const* dst) const
+{
+	assert(radii != nullptr && dst != nullptr);
+
+	int xWidth = _pixelSum.getWidth();
+	int yHeight = _pixelSum.getHeight();
+
+	bool nonZero = output == Output::NonZeroMean;
+
+	utils::parallelFor(yHeight, _threads, [&](int begin, int end) {
+		std::vector<unsigned int> top(xWidth);
+		std::vector<unsigned int> bottom(xWidth);
+		std::vector<unsigned int> sums(xWidth);
+
+		std::vector<unsigned int> nonZeroTop(nonZero ? xWidth : 0);
+		std::vector<unsigned int> nonZeroBottom(nonZero ? xWidth : 0);
+		std::vector<unsigned int> counts(nonZero ? xWidth : 0);
+
+		for (int i = 0; i < count; ++i)
+		{
+			int radius = radii[i];
+			assert(radius >= 0);
+
+			// Mean is divided by the unclamped area like getPixelAverage
+			float scale = float(1.0 / (double(2 * radius + 1) * double(2 * radius + 1)));
+
+			for (int y = begin; y < end; ++y)
+			{
+				int y0 = y - radius - 1;
+				int y1 = std::min(y + radius, yHeight - 1);
+
+				// Columns of the band. SA(x, y1) - SA(x, y0)
+				_pixelSum.getSummedAreaLine(y1, bottom.data(), nonZero ? nonZeroBottom.data() : nullptr);
+
+				if (y0 >= 0)
+				{
+					_pixelSum.getSummedAreaLine(y0, top.data(), nonZero ? nonZeroTop.data() : nullptr);
+
+					getBandLine(bottom.data(), top.data(), bottom.data(), xWidth);
+					if (nonZero)
+					{
+						getBandLine(nonZeroBottom.data(), nonZeroTop.data(), nonZeroBottom.data(), xWidth);
+					}
+				}
+
+				size_t offset = size_t(y) * xWidth;
+
+				switch (output)
+				{
+				case Output::Sum:
+					getWindowLine(bottom.data(), xWidth, radius, static_cast<unsigned int*>(dst[i]) + offset);
+					break;
+
+				case Output::Mean:
+					getWindowLine(bottom.data(), xWidth, radius, sums.data());
+					scaleLine(sums.data(), scale, static_cast<float*>(dst[i]) + offset, xWidth);
+					break;
+
+				case Output::NonZeroMean:
+					getWindowLine(bottom.data(), xWidth, radius, sums.data());
+					getWindowLine(nonZeroBottom.data(), xWidth, radius, counts.data());
+					divideLine(sums.data(), counts.data(), static_cast<float*>(dst[i]) + offset, xWidth);
+					break;
+				}
+			}
+		}
+	});
+}
+
+} // End integral
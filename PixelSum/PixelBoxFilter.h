@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * Box filter of a whole image from the summed area tables of integral::PixelSum.
+ * Output pixel (x, y) is the value of the (2 * radius + 1)^2 region centered at (x, y),
+ * clamped to the borders of the buffer the same way as the region queries:
+ *
+ *   getSum         - getPixelSum(x - r, y - r, x + r, y + r)
+ *   getMean        - getPixelAverage(...), divided by the unclamped area
+ *   getNonZeroMean - getNonZeroAverage(...)
+ *
+ * A line of the output is a difference of two lines of the tables, so the inner
+ * part of a line is computed by SSE without clamping and branches per pixel.
+ * Lines are split between threads. Several radii can be computed from one table
+ * pass, outputs are xWidth * yHeight arrays.
+ */
+class PIXEL_SUM_API BoxFilter
+{
+public:
+	// Contrustors/Destructor
+	BoxFilter(const PixelSum& pixelSum, int threads = 0);	// threads <= 0 - one per hardware thread
+
+	// Methods
+	void getSum(int radius, unsigned int* dst) const;
+	void getMean(int radius, float* dst) const;
+	void getNonZeroMean(int radius, float* dst) const;
+
+	// Output i is filtered with radii[i]
+	void getSum(const int* radii, int count, unsigned int* const* dst) const;
+	void getMean(const int* radii, int count, float* const* dst) const;
+	void getNonZeroMean(const int* radii, int count, float* const* dst) const;
+
+	// Columns of a band of lines of a summed area table. dst = bottom - top, top can be nullptr
+	static void getBandLine(const unsigned int* bottom, const unsigned int* top, unsigned int* dst, int xWidth);
+
+	// Sums of the windows x - radius..x + radius of a line, clamped to the borders.
+	// 'columns' is a line of a summed area table or a difference of two lines
+	static void getWindowLine(const unsigned int* columns, int xWidth, int radius, unsigned int* dst);
+
+private:
+	enum class Output
+	{
+		Sum,
+		Mean,
+		NonZeroMean
+	};
+
+	void filter(const int* radii, int count, Output output, void* const* dst) const;
+
+private:
+	const PixelSum& _pixelSum;
+	int _threads;
+};
+
+} // End integral
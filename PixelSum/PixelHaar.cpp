@@ -0,0 +1,285 @@
+#include "PixelHaar.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <utility>		// pair
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void combineLanes(const unsigned int* corners, const int* offsets, const int* indices, const int* weights, int count, int* dst)
+{
+#ifdef __SSE2__
+	combineLanesSSE(corners, offsets, indices, weights, count, dst);
+#else
+	for (int i = 0; i < count; ++i)
+	{
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			unsigned int sum = 0;
+
+			for (int t = offsets[i]; t < offsets[i + 1]; ++t)
+			{
+				sum += corners[indices[t] * 4 + lane] * unsigned(weights[t]);
+			}
+
+			dst[i * 4 + lane] = int(sum);
+		}
+	}
+#endif // __SSE2__
+}
+
+HaarFeatureSet::HaarFeatureSet(const PixelSum& pixelSum, const Feature* features, int count)
+	: _pixelSum(pixelSum)
+	, _rowMajor(pixelSum.getLayout() == PixelSum::Layout::RowMajor)
+	, _featureCount(count)
+	, _minX(0)
+	, _minY(0)
+	, _maxX(0)
+	, _maxY(0)
+{
+	assert(features != nullptr);
+	assert(count > 0);
+
+	int xWidth = _pixelSum.getWidth();
+
+	_features = new Feature[_featureCount];
+	memcpy(_features, features, _featureCount * sizeof(Feature));
+
+	// Corners of the features with coefficients. Merged per feature
+	std::vector<std::vector<std::pair<int, int>>> terms(_featureCount);
+
+	bool first = true;
+
+	for (int i = 0; i < _featureCount; ++i)
+	{
+		auto& feature = _features[i];
+		assert(feature.count > 0 && feature.count <= MaxRects);
+
+		for (int r = 0; r < feature.count; ++r)
+		{
+			auto& rect = feature.rects[r];
+
+			auto normalized = utils::Rect(rect.x0, rect.y0, rect.x1, rect.y1).normalized();
+			rect.x0 = normalized.x0;
+			rect.y0 = normalized.y0;
+			rect.x1 = normalized.x1;
+			rect.y1 = normalized.y1;
+
+			// A + B - C - D
+			const int cornerX[] = { rect.x1, rect.x0 - 1, rect.x1, rect.x0 - 1 };
+			const int cornerY[] = { rect.y1, rect.y0 - 1, rect.y0 - 1, rect.y1 };
+			const int sign[] = { 1, 1, -1, -1 };
+
+			for (int c = 0; c < 4; ++c)
+			{
+				terms[i].emplace_back(cornerX[c] + cornerY[c] * xWidth, sign[c] * rect.weight);
+			}
+
+			_minX = first ? rect.x0 - 1 : std::min(_minX, rect.x0 - 1);
+			_minY = first ? rect.y0 - 1 : std::min(_minY, rect.y0 - 1);
+			_maxX = first ? rect.x1 : std::max(_maxX, rect.x1);
+			_maxY = first ? rect.y1 : std::max(_maxY, rect.y1);
+
+			first = false;
+		}
+
+		// Merge coefficients of shared corners, drop the ones that cancel out
+		std::sort(terms[i].begin(), terms[i].end());
+
+		std::vector<std::pair<int, int>> merged;
+		for (const auto& term : terms[i])
+		{
+			if (!merged.empty() && merged.back().first == term.first)
+			{
+				merged.back().second += term.second;
+			}
+			else
+			{
+				merged.push_back(term);
+			}
+		}
+
+		merged.erase(std::remove_if(merged.begin(), merged.end(), [](const std::pair<int, int>& term) {
+			return term.second == 0;
+		}), merged.end());
+
+		terms[i].swap(merged);
+	}
+
+	// Distinct corners of the set
+	std::vector<int> corners;
+	for (const auto& featureTerms : terms)
+	{
+		for (const auto& term : featureTerms)
+		{
+			corners.push_back(term.first);
+		}
+	}
+
+	std::sort(corners.begin(), corners.end());
+	corners.erase(std::unique(corners.begin(), corners.end()), corners.end());
+
+	_cornerCount = int(corners.size());
+	_corners = new int[std::max(_cornerCount, 1)];
+	std::copy(corners.begin(), corners.end(), _corners);
+
+	// Terms by index of the corner
+	_termOffsets = new int[_featureCount + 1];
+	_termOffsets[0] = 0;
+
+	for (int i = 0; i < _featureCount; ++i)
+	{
+		_termOffsets[i + 1] = _termOffsets[i] + int(terms[i].size());
+	}
+
+	_termCorners = new int[std::max(_termOffsets[_featureCount], 1)];
+	_termWeights = new int[std::max(_termOffsets[_featureCount], 1)];
+
+	for (int i = 0; i < _featureCount; ++i)
+	{
+		int t = _termOffsets[i];
+
+		for (const auto& term : terms[i])
+		{
+			_termCorners[t] = int(std::lower_bound(corners.begin(), corners.end(), term.first) - corners.begin());
+			_termWeights[t] = term.second;
+			++t;
+		}
+	}
+}
+
+HaarFeatureSet::~HaarFeatureSet()
+{
+	delete[] _termWeights;
+	delete[] _termCorners;
+	delete[] _termOffsets;
+	delete[] _corners;
+	delete[] _features;
+}
+
+void HaarFeatureSet::evaluate(int x, int y, int* dst) const
+{
+	assert(dst != nullptr);
+
+	if (!isInside(x, y))
+	{
+		evaluateClamped(x, y, dst);
+		return;
+	}
+
+	const auto origin = _pixelSum.getSummedArea() + x + y * _pixelSum.getWidth();
+
+	for (int i = 0; i < _featureCount; ++i)
+	{
+		unsigned int sum = 0;
+
+		for (int t = _termOffsets[i]; t < _termOffsets[i + 1]; ++t)
+		{
+			sum += origin[_corners[_termCorners[t]]] * unsigned(_termWeights[t]);
+		}
+
+		dst[i] = int(sum);
+	}
+}
+
+void HaarFeatureSet::evaluate(const int* xs, const int* ys, int windows, int* dst) const
+{
+	assert(xs != nullptr && ys != nullptr && dst != nullptr);
+
+	const int lanes = 4;
+	const auto summedArea = _pixelSum.getSummedArea();
+
+	// Corners and values of 4 windows, lane after lane
+	std::vector<unsigned int> corners(_cornerCount * lanes);
+	std::vector<int> values(_featureCount * lanes);
+
+	int w = 0;
+
+	for (; w + lanes <= windows; w += lanes)
+	{
+		bool inside = true;
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			inside = inside && isInside(xs[w + lane], ys[w + lane]);
+		}
+
+		if (!inside)
+		{
+			for (int lane = 0; lane < lanes; ++lane)
+			{
+				evaluate(xs[w + lane], ys[w + lane], dst + size_t(w + lane) * _featureCount);
+			}
+
+			continue;
+		}
+
+		// Each distinct corner is loaded once per window
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			const auto origin = summedArea + xs[w + lane] + ys[w + lane] * _pixelSum.getWidth();
+
+			for (int c = 0; c < _cornerCount; ++c)
+			{
+				corners[c * lanes + lane] = origin[_corners[c]];
+			}
+		}
+
+		combineLanes(corners.data(), _termOffsets, _termCorners, _termWeights, _featureCount, values.data());
+
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			auto line = dst + size_t(w + lane) * _featureCount;
+
+			for (int i = 0; i < _featureCount; ++i)
+			{
+				line[i] = values[i * lanes + lane];
+			}
+		}
+	}
+
+	// Tail
+	for (; w < windows; ++w)
+	{
+		evaluate(xs[w], ys[w], dst + size_t(w) * _featureCount);
+	}
+}
+
+bool HaarFeatureSet::isInside(int x, int y) const
+{
+	// Corner offsets are valid for a row-major table only
+	return _rowMajor && x + _minX >= 0 && y + _minY >= 0 && x + _maxX < _pixelSum.getWidth() && y + _maxY < _pixelSum.getHeight();
+}
+
+void HaarFeatureSet::evaluateClamped(int x, int y, int* dst) const
+{
+	for (int i = 0; i < _featureCount; ++i)
+	{
+		const auto& feature = _features[i];
+
+		unsigned int sum = 0;
+
+		for (int r = 0; r < feature.count; ++r)
+		{
+			const auto& rect = feature.rects[r];
+
+			// Empty after clamping - no pixels
+			if (x + rect.x1 < 0 || y + rect.y1 < 0 || x + rect.x0 >= _pixelSum.getWidth() || y + rect.y0 >= _pixelSum.getHeight())
+			{
+				continue;
+			}
+
+			sum += _pixelSum.getPixelSum(x + rect.x0, y + rect.y0, x + rect.x1, y + rect.y1) * unsigned(rect.weight);
+		}
+
+		dst[i] = int(sum);
+	}
+}
+
+} // End integral
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * Compiled set of Haar-like features evaluated on the summed area table of integral::PixelSum.
+ * A feature is a weighted sum of up to 4 rectangles, coordinates are *inclusive* and
+ * relative to the origin (top left corner) of the detection window. Value of a feature
+ * for the window at (x, y) is
+ *
+ *   sum of weight * getPixelSum(x + x0, y + y0, x + x1, y + y1)
+ *
+ * The set is compiled for the row stride of the table: every rectangle becomes 4 corner
+ * offsets from the window origin, corners shared by rectangles and features are stored
+ * once and the coefficients of a feature are merged per corner (two adjacent rectangles
+ * of a two-rectangle feature need 6 corners, not 8). Evaluation loads every distinct
+ * corner once and combines them, values are exact while they fit int32.
+ *
+ * The tables are used in place, the PixelSum must outlive the set. Offsets of a tiled
+ * table depend on the window, so all windows of a tiled PixelSum and windows with corners
+ * outside of the buffer fall back to the clamped region queries.
+ * The batch evaluation processes 4 windows in the lanes of SSE registers.
+ */
+class PIXEL_SUM_API HaarFeatureSet
+{
+public:
+	static const int MaxRects = 4;
+
+	struct WeightedRect
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		int weight;
+	};
+
+	struct Feature
+	{
+		WeightedRect rects[MaxRects];
+		int count;
+	};
+
+public:
+	// Contrustors/Destructor
+	HaarFeatureSet(const PixelSum& pixelSum, const Feature* features, int count);
+	~HaarFeatureSet();
+	HaarFeatureSet(const HaarFeatureSet& other) = delete;
+
+	// Operators
+	HaarFeatureSet& operator=(const HaarFeatureSet& other) = delete;
+
+	// Methods
+
+	// All features of the window at (x, y), dst is getFeatureCount()
+	void evaluate(int x, int y, int* dst) const;
+
+	// Windows (xs[i], ys[i]), dst is windows * getFeatureCount(), window after window
+	void evaluate(const int* xs, const int* ys, int windows, int* dst) const;
+
+	// Inlines
+	int getFeatureCount() const
+	{
+		return _featureCount;
+	}
+
+	// Distinct corners of all features
+	int getCornerCount() const
+	{
+		return _cornerCount;
+	}
+
+private:
+	bool isInside(int x, int y) const;
+	void evaluateClamped(int x, int y, int* dst) const;
+
+private:
+	const PixelSum& _pixelSum;
+	bool _rowMajor;
+
+	Feature* _features;
+	int _featureCount;
+
+	// Distinct corner offsets, dx + dy * xWidth
+	int* _corners;
+	int _cornerCount;
+
+	// Terms of feature i are _termOffsets[i].._termOffsets[i + 1] - 1
+	int* _termOffsets;
+	int* _termCorners;
+	int* _termWeights;
+
+	// Bounds of the corners relative to the window origin
+	int _minX;
+	int _minY;
+	int _maxX;
+	int _maxY;
+};
+
+} // End integral
@@ -0,0 +1,241 @@
+#include "PixelHistogramIntegral.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void fillHistogramLine(const unsigned char* src, const unsigned short* prevLine, unsigned short* line, int xWidth, int bins, int binShift)
+{
+#ifdef __SSE2__
+	fillHistogramLineSSE(src, prevLine, line, xWidth, bins, binShift);
+#else
+	unsigned short rowCount[256] = {};
+
+	for (int x = 0; x < xWidth; ++x)
+	{
+		// H(x, y, b) = [bin(B(x, y)) == b] + H(x - 1, y, b) + H(x, y - 1, b)
+		++rowCount[src[x] >> binShift];
+
+		auto dst = line + x * bins;
+		auto prev = prevLine + x * bins;
+
+		for (int b = 0; b < bins; ++b)
+		{
+			dst[b] = rowCount[b] + (prevLine != nullptr ? prev[b] : 0);
+		}
+	}
+#endif // __SSE2__
+}
+
+void addBandBase(const unsigned int* base, const unsigned short* line, unsigned int* nextBase, int len)
+{
+#ifdef __SSE2__
+	addLineU32U16SSE(base, line, nextBase, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		nextBase[x] = base[x] + line[x];
+	}
+#endif // __SSE2__
+}
+
+PixelHistogram::PixelHistogram(const unsigned char* buffer, int xWidth, int yHeight, int bins)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _bands((yHeight + BandMask) >> BandShift)
+	, _bins(bins)
+	, _binShift(8)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // Same limits as integral::PixelSum
+	assert(xWidth * BandSize < 65536); // 16-bit counts inside of a band
+	assert(bins >= 8 && bins <= 256 && (bins & (bins - 1)) == 0);
+
+	for (int b = bins; b > 1; b >>= 1)
+	{
+		--_binShift;
+	}
+
+	allocateMemory();
+
+	int lineSize = _xWidth * _bins;
+
+	// The first band starts from zero
+	memset(_bandBase, 0, lineSize * sizeof(unsigned int));
+
+	for (int y = 0; y < _yHeight; ++y)
+	{
+		const auto src = buffer + y * _xWidth;
+
+		auto line = _bandArea + size_t(y) * lineSize;
+		const auto prevLine = (y & BandMask) != 0 ? line - lineSize : nullptr;
+
+		fillHistogramLine(src, prevLine, line, _xWidth, _bins, _binShift);
+
+		// Band is finished. Make base line of the next band
+		int band = y >> BandShift;
+		if ((y & BandMask) == BandMask && band + 1 < _bands)
+		{
+			auto base = _bandBase + size_t(band) * lineSize;
+			addBandBase(base, line, base + lineSize, lineSize);
+		}
+	}
+}
+
+PixelHistogram::~PixelHistogram()
+{
+	freeMemory();
+}
+
+PixelHistogram::PixelHistogram(const PixelHistogram& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _bands(other._bands)
+	, _bins(other._bins)
+	, _binShift(other._binShift)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_bandArea, other._bandArea, size_t(_xWidth) * _yHeight * _bins * sizeof(unsigned short));
+	memcpy(_bandBase, other._bandBase, size_t(_xWidth) * _bands * _bins * sizeof(unsigned int));
+}
+
+PixelHistogram::PixelHistogram(PixelHistogram&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _bands(other._bands)
+	, _bins(other._bins)
+	, _binShift(other._binShift)
+{
+	// Move
+	_bandArea = other._bandArea;
+	other._bandArea = nullptr;
+
+	_bandBase = other._bandBase;
+	other._bandBase = nullptr;
+}
+
+PixelHistogram& PixelHistogram::operator=(const PixelHistogram& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_bands = other._bands;
+	_bins = other._bins;
+	_binShift = other._binShift;
+
+	allocateMemory();
+
+	memcpy(_bandArea, other._bandArea, size_t(_xWidth) * _yHeight * _bins * sizeof(unsigned short));
+	memcpy(_bandBase, other._bandBase, size_t(_xWidth) * _bands * _bins * sizeof(unsigned int));
+
+	return *this;
+}
+
+PixelHistogram& PixelHistogram::operator=(PixelHistogram&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_bands = other._bands;
+	_bins = other._bins;
+	_binShift = other._binShift;
+
+	_bandArea = other._bandArea;
+	other._bandArea = nullptr;
+
+	_bandBase = other._bandBase;
+	other._bandBase = nullptr;
+
+	return *this;
+}
+
+void PixelHistogram::getHistogram(int x0, int y0, int x1, int y1, unsigned int* histogram) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minX = rect.x0;
+	int minY = rect.y0;
+	int maxX = rect.x1;
+	int maxY = rect.y1;
+
+	// Calculate. A + B - C - D for every bin
+	memset(histogram, 0, _bins * sizeof(unsigned int));
+
+	accumulateCorner(maxX, maxY, true, histogram);
+	accumulateCorner(minX - 1, minY - 1, true, histogram);
+	accumulateCorner(maxX, minY - 1, false, histogram);
+	accumulateCorner(minX - 1, maxY, false, histogram);
+}
+
+unsigned int PixelHistogram::getCountAbove(int x0, int y0, int x1, int y1, int bin) const
+{
+	assert(bin >= -1);
+
+	// Calculate
+	unsigned int histogram[256];
+	getHistogram(x0, y0, x1, y1, histogram);
+
+	// Result
+	unsigned int count = 0;
+	for (int b = std::max(bin + 1, 0); b < _bins; ++b)
+	{
+		count += histogram[b];
+	}
+
+	return count;
+}
+
+void PixelHistogram::accumulateCorner(int x, int y, bool add, unsigned int* histogram) const
+{
+	if (x < 0 || y < 0)
+	{
+		return;
+	}
+
+	// H(x, y) = Base(x, band(y)) + Band(x, y)
+	const auto base = _bandBase + (x + size_t(y >> BandShift) * _xWidth) * _bins;
+	const auto local = _bandArea + (x + size_t(y) * _xWidth) * _bins;
+
+	for (int b = 0; b < _bins; ++b)
+	{
+		unsigned int value = base[b] + local[b];
+		histogram[b] = add ? histogram[b] + value : histogram[b] - value;
+	}
+}
+
+void PixelHistogram::allocateMemory()
+{
+	_bandArea = new unsigned short[size_t(_xWidth) * _yHeight * _bins];
+	_bandBase = new unsigned int[size_t(_xWidth) * _bands * _bins];
+}
+
+void PixelHistogram::freeMemory()
+{
+	delete[] _bandBase;
+	delete[] _bandArea;
+}
+
+} // End integral
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Common.h"
+
+namespace integral {
+
+/**
+ * Integral histogram for providing fast per-region value distributions from an 8-bit pixel buffer.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation. See integral::PixelSum.
+ *
+ * The value range [0..255] is split into 'bins' equal bins (power of two, 8..256).
+ * One summed area table per bin is built, so any histogram query is O(bins).
+ *
+ * Tables are compact: the bins of a pixel are stored next to each other, and
+ * every table keeps 16-bit counts relative to the start of its band of
+ * 8 rows plus a 32-bit base line per band.
+ * Memory: xWidth * yHeight * bins * (sizeof(uint16) + sizeof(uint32) / 8)
+ */
+class PIXEL_SUM_API PixelHistogram
+{
+public:
+	static const int BandShift = 3;
+	static const int BandSize = 1 << BandShift;
+	static const int BandMask = BandSize - 1;
+
+public:
+	// Contrustors/Destructor
+	PixelHistogram(const unsigned char* buffer, int xWidth, int yHeight, int bins = 16);
+	~PixelHistogram();
+	PixelHistogram(const PixelHistogram& other);
+	PixelHistogram(PixelHistogram&& other);
+
+	// Operators
+	PixelHistogram& operator=(const PixelHistogram& other);
+	PixelHistogram& operator=(PixelHistogram&& other);
+
+	// Methods
+
+	// Writes 'bins' counts of the region to histogram
+	void getHistogram(int x0, int y0, int x1, int y1, unsigned int* histogram) const;
+
+	// Count of pixels in the bins above 'bin', values >= (bin + 1) * getBinWidth().
+	// Thresholds inside of a bin are not resolved by the tables, so the bin is the argument:
+	// pixels > T for T = (bin + 1) * getBinWidth() - 1. bin = -1 counts all pixels
+	unsigned int getCountAbove(int x0, int y0, int x1, int y1, int bin) const;
+
+	// Inlines
+	int getBins() const
+	{
+		return _bins;
+	}
+
+	int getBinWidth() const
+	{
+		return 256 / _bins;
+	}
+
+	int getBin(unsigned char value) const
+	{
+		return value >> _binShift;
+	}
+
+private:
+	void accumulateCorner(int x, int y, bool add, unsigned int* histogram) const;
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned short* _bandArea;
+	unsigned int* _bandBase;
+
+	int _xWidth;
+	int _yHeight;
+	int _bands;
+
+	int _bins;
+	int _binShift;
+};
+
+} // End integral
@@ -0,0 +1,250 @@
+#include "PixelHog.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <math.h>		// sqrt, cos, sin
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void gradientBinsLine(const unsigned char* left, const unsigned char* right, const unsigned char* above, const unsigned char* below,
+	const float* cosines, const float* sines, int boundaries, unsigned char* bins, unsigned short* magnitudes, int len)
+{
+#ifdef __SSE2__
+	gradientBinsSSE(left, right, above, below, cosines, sines, boundaries, bins, magnitudes, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		float gx = float(right[x]) - float(left[x]);
+		float gy = float(below[x]) - float(above[x]);
+
+		magnitudes[x] = (unsigned short)(sqrtf(gx * gx + gy * gy) + 0.5f);
+
+		// Opposite directions are the same orientation
+		if (gy < 0.0f || (gy == 0.0f && gx < 0.0f))
+		{
+			gx = -gx;
+			gy = -gy;
+		}
+
+		int bin = 0;
+		for (int k = 0; k < boundaries; ++k)
+		{
+			bin += cosines[k] * gy - sines[k] * gx > 0.0f ? 1 : 0;
+		}
+
+		bins[x] = (unsigned char)bin;
+	}
+#endif // __SSE2__
+}
+
+void sumLines(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	sumArraySSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] + src1[x];
+	}
+#endif // __SSE2__
+}
+
+// Interleaved summed area tables of the magnitudes per bin
+void fillHistogramTables(const unsigned char* buffer, unsigned int* summedArea, int xWidth, int yHeight, int binCount)
+{
+	// Boundaries between the bins, k * 180 / bins degrees
+	int boundaries = binCount - 1;
+
+	std::vector<float> cosines(std::max(boundaries, 1));
+	std::vector<float> sines(std::max(boundaries, 1));
+
+	const double pi = 3.14159265358979323846;
+	for (int k = 0; k < boundaries; ++k)
+	{
+		cosines[k] = float(cos(pi * (k + 1) / binCount));
+		sines[k] = float(sin(pi * (k + 1) / binCount));
+	}
+
+	std::vector<unsigned char> bins(xWidth);
+	std::vector<unsigned short> magnitudes(xWidth);
+	std::vector<unsigned int> rowSum(binCount);
+
+	int lineSize = xWidth * binCount;
+
+	for (int y = 0; y < yHeight; ++y)
+	{
+		const auto line = buffer + y * xWidth;
+		const auto above = buffer + std::max(y - 1, 0) * xWidth;
+		const auto below = buffer + std::min(y + 1, yHeight - 1) * xWidth;
+
+		// Borders are replicated
+		gradientBinsLine(line, line + std::min(1, xWidth - 1), above, below, cosines.data(), sines.data(), boundaries, bins.data(), magnitudes.data(), 1);
+
+		if (xWidth > 1)
+		{
+			gradientBinsLine(line, line + 2, above + 1, below + 1, cosines.data(), sines.data(), boundaries, bins.data() + 1, magnitudes.data() + 1, xWidth - 2);
+
+			int last = xWidth - 1;
+			gradientBinsLine(line + last - 1, line + last, above + last, below + last, cosines.data(), sines.data(), boundaries, bins.data() + last, magnitudes.data() + last, 1);
+		}
+
+		// Row sums per bin
+		auto tableLine = summedArea + y * lineSize;
+		std::fill(rowSum.begin(), rowSum.end(), 0);
+
+		for (int x = 0; x < xWidth; ++x)
+		{
+			rowSum[bins[x]] += magnitudes[x];
+			memcpy(tableLine + x * binCount, rowSum.data(), binCount * sizeof(unsigned int));
+		}
+
+		if (y > 0)
+		{
+			sumLines(tableLine, tableLine - lineSize, tableLine, lineSize);
+		}
+	}
+}
+
+OrientationHistogram::OrientationHistogram(const unsigned char* buffer, int xWidth, int yHeight, int bins)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _bins(bins)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // Same limits as integral::PixelSum
+	assert(bins > 0 && bins <= MaxBins);
+
+	allocateMemory();
+
+	fillHistogramTables(buffer, _summedArea, _xWidth, _yHeight, _bins);
+}
+
+OrientationHistogram::~OrientationHistogram()
+{
+	freeMemory();
+}
+
+OrientationHistogram::OrientationHistogram(const OrientationHistogram& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _bins(other._bins)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_summedArea, other._summedArea, getTableSize() * sizeof(unsigned int));
+}
+
+OrientationHistogram::OrientationHistogram(OrientationHistogram&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _bins(other._bins)
+{
+	// Move
+	_summedArea = other._summedArea;
+	other._summedArea = nullptr;
+}
+
+OrientationHistogram& OrientationHistogram::operator=(const OrientationHistogram& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_bins = other._bins;
+
+	allocateMemory();
+
+	memcpy(_summedArea, other._summedArea, getTableSize() * sizeof(unsigned int));
+
+	return *this;
+}
+
+OrientationHistogram& OrientationHistogram::operator=(OrientationHistogram&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_bins = other._bins;
+
+	_summedArea = other._summedArea;
+	other._summedArea = nullptr;
+
+	return *this;
+}
+
+void OrientationHistogram::getHistogram(int x0, int y0, int x1, int y1, unsigned int* histogram) const
+{
+	assert(histogram != nullptr);
+
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minX = rect.x0;
+	int minY = rect.y0;
+	int maxX = rect.x1;
+	int maxY = rect.y1;
+
+	// Calculate. A + B - C - D per bin
+	const auto A = _summedArea + (maxX + maxY * _xWidth) * _bins;
+	const auto B = (minX > 0 && minY > 0) ? _summedArea + ((minX - 1) + (minY - 1) * _xWidth) * _bins : nullptr;
+	const auto C = minY > 0 ? _summedArea + (maxX + (minY - 1) * _xWidth) * _bins : nullptr;
+	const auto D = minX > 0 ? _summedArea + ((minX - 1) + maxY * _xWidth) * _bins : nullptr;
+
+	for (int bin = 0; bin < _bins; ++bin)
+	{
+		histogram[bin] = A[bin] + (B ? B[bin] : 0) - (C ? C[bin] : 0) - (D ? D[bin] : 0);
+	}
+}
+
+void OrientationHistogram::getNormalizedHistogram(int x0, int y0, int x1, int y1, float* histogram) const
+{
+	assert(histogram != nullptr);
+
+	unsigned int sums[MaxBins];
+	getHistogram(x0, y0, x1, y1, sums);
+
+	double norm = 0.0;
+	for (int bin = 0; bin < _bins; ++bin)
+	{
+		norm += double(sums[bin]) * sums[bin];
+	}
+
+	double scale = norm > 0.0 ? 1.0 / sqrt(norm) : 0.0;
+
+	for (int bin = 0; bin < _bins; ++bin)
+	{
+		histogram[bin] = float(sums[bin] * scale);
+	}
+}
+
+void OrientationHistogram::allocateMemory()
+{
+	_summedArea = new unsigned int[getTableSize()];
+}
+
+void OrientationHistogram::freeMemory()
+{
+	delete[] _summedArea;
+}
+
+} // End integral
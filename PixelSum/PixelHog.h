@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Common.h"
+
+namespace integral {
+
+/**
+ * Integral orientation histograms for providing gradient histograms of regions of an 8-bit pixel buffer.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getHistogram(4,8,7,10,h) gets the histogram of a 4x3 region where top left
+ * corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ *
+ * Gradients are central differences with replicated borders. Orientation is unsigned,
+ * [0, 180) degrees split into 'bins' equal bins, every pixel votes its rounded gradient
+ * magnitude to one bin (no interpolation between bins). Gradients are computed by SSE,
+ * bins are found by comparisons with the bin boundaries, without atan2.
+ *
+ * One summed area table per bin, interleaved: a histogram is 4 runs of 'bins' values,
+ * O(bins) for any size of the region.
+ * Porikli. Integral histogram: a fast way to extract histograms in cartesian spaces. CVPR 2005
+ * Dalal, Triggs. Histograms of oriented gradients for human detection. CVPR 2005
+ *
+ * The tables are modular uint32 like the integral image, a histogram is exact while
+ * the sum of magnitudes of the region fits uint32 (regions up to ~3400x3400).
+ * Memory: xWidth * yHeight * bins * sizeof(uint32)
+ */
+class PIXEL_SUM_API OrientationHistogram
+{
+public:
+	static const int MaxBins = 32;
+
+public:
+	// Contrustors/Destructor
+	OrientationHistogram(const unsigned char* buffer, int xWidth, int yHeight, int bins = 9);
+	~OrientationHistogram();
+	OrientationHistogram(const OrientationHistogram& other);
+	OrientationHistogram(OrientationHistogram&& other);
+
+	// Operators
+	OrientationHistogram& operator=(const OrientationHistogram& other);
+	OrientationHistogram& operator=(OrientationHistogram&& other);
+
+	// Methods
+
+	// Sums of magnitudes per bin, histogram is getBins()
+	void getHistogram(int x0, int y0, int x1, int y1, unsigned int* histogram) const;
+
+	// L2-normalized histogram. Zero for regions without gradients
+	void getNormalizedHistogram(int x0, int y0, int x1, int y1, float* histogram) const;
+
+	// Inlines
+	int getBins() const
+	{
+		return _bins;
+	}
+
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	int getTableSize() const
+	{
+		return _xWidth * _yHeight * _bins;
+	}
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned int* _summedArea;
+
+	int _xWidth;
+	int _yHeight;
+	int _bins;
+};
+
+} // End integral
@@ -0,0 +1,355 @@
+#include "PixelMinMaxSparse.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace sparse {
+
+struct MinOperation
+{
+	static unsigned char identity()
+	{
+		return 255;
+	}
+
+	static unsigned char apply(unsigned char a, unsigned char b)
+	{
+		return std::min(a, b);
+	}
+
+	static void applyArray(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len)
+	{
+#ifdef __SSE2__
+		minArraySSE(a, b, dst, len);
+#else
+		for (int x = 0; x < len; ++x)
+		{
+			dst[x] = std::min(a[x], b[x]);
+		}
+#endif // __SSE2__
+	}
+
+	static unsigned char reduce(const unsigned char* data, int len)
+	{
+#ifdef __SSE2__
+		return minSSE(data, len);
+#else
+		return *std::min_element(data, data + len);
+#endif // __SSE2__
+	}
+};
+
+struct MaxOperation
+{
+	static unsigned char identity()
+	{
+		return 0;
+	}
+
+	static unsigned char apply(unsigned char a, unsigned char b)
+	{
+		return std::max(a, b);
+	}
+
+	static void applyArray(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len)
+	{
+#ifdef __SSE2__
+		maxArraySSE(a, b, dst, len);
+#else
+		for (int x = 0; x < len; ++x)
+		{
+			dst[x] = std::max(a[x], b[x]);
+		}
+#endif // __SSE2__
+	}
+
+	static unsigned char reduce(const unsigned char* data, int len)
+	{
+#ifdef __SSE2__
+		return maxSSE(data, len);
+#else
+		return *std::max_element(data, data + len);
+#endif // __SSE2__
+	}
+};
+
+template<class TOperation>
+void fillSparseTable(const unsigned char* buffer, unsigned char* table, int xWidth, int yHeight, int xBlocks, int yBlocks, int xLevels, int yLevels)
+{
+	const int blockSize = PixelMinMax::BlockSize;
+	const int levelSize = xBlocks * yBlocks;
+
+	// Level (0, 0). Blocks
+	std::vector<unsigned char> line(xWidth);
+
+	for (int by = 0; by < yBlocks; ++by)
+	{
+		int y0 = by * blockSize;
+		int y1 = std::min(y0 + blockSize, yHeight);
+
+		// Columns of the block row
+		memcpy(line.data(), buffer + y0 * xWidth, xWidth * sizeof(unsigned char));
+
+		for (int y = y0 + 1; y < y1; ++y)
+		{
+			TOperation::applyArray(line.data(), buffer + y * xWidth, line.data(), xWidth);
+		}
+
+		for (int bx = 0; bx < xBlocks; ++bx)
+		{
+			int x0 = bx * blockSize;
+			table[bx + by * xBlocks] = TOperation::reduce(line.data() + x0, std::min(blockSize, xWidth - x0));
+		}
+	}
+
+	// Levels (0, kx). T(kx, x) = op(T(kx - 1, x), T(kx - 1, x + 2^(kx - 1)))
+	for (int kx = 1; kx < xLevels; ++kx)
+	{
+		int half = 1 << (kx - 1);
+
+		const auto src = table + (kx - 1) * levelSize;
+		auto dst = table + kx * levelSize;
+
+		for (int by = 0; by < yBlocks; ++by)
+		{
+			const auto srcLine = src + by * xBlocks;
+			auto dstLine = dst + by * xBlocks;
+
+			TOperation::applyArray(srcLine, srcLine + half, dstLine, xBlocks - half);
+
+			// Tail crosses the border and is never queried
+			memcpy(dstLine + xBlocks - half, srcLine + xBlocks - half, half * sizeof(unsigned char));
+		}
+	}
+
+	// Levels (ky, kx). Lines of the level are contiguous
+	for (int ky = 1; ky < yLevels; ++ky)
+	{
+		int half = 1 << (ky - 1);
+		int len = (yBlocks - half) * xBlocks;
+
+		for (int kx = 0; kx < xLevels; ++kx)
+		{
+			const auto src = table + ((ky - 1) * xLevels + kx) * levelSize;
+			auto dst = table + (ky * xLevels + kx) * levelSize;
+
+			TOperation::applyArray(src, src + half * xBlocks, dst, len);
+			memcpy(dst + len, src + len, half * xBlocks * sizeof(unsigned char));
+		}
+	}
+}
+
+template<class TOperation>
+unsigned char scanRegion(const unsigned char* buffer, int xWidth, int x0, int y0, int x1, int y1, unsigned char result)
+{
+	if (x1 < x0)
+	{
+		return result;
+	}
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		result = TOperation::apply(result, TOperation::reduce(buffer + x0 + y * xWidth, x1 - x0 + 1));
+	}
+
+	return result;
+}
+
+PixelMinMax::PixelMinMax(const unsigned char* buffer, int xWidth, int yHeight)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _xBlocks((xWidth + BlockMask) >> BlockShift)
+	, _yBlocks((yHeight + BlockMask) >> BlockShift)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // Same limits as integral::PixelSum
+
+	_xLevels = utils::floorLog2(_xBlocks) + 1;
+	_yLevels = utils::floorLog2(_yBlocks) + 1;
+
+	allocateMemory();
+
+	// Copy
+	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(unsigned char));
+
+	fillSparseTable<MinOperation>(_buffer, _minTable, _xWidth, _yHeight, _xBlocks, _yBlocks, _xLevels, _yLevels);
+	fillSparseTable<MaxOperation>(_buffer, _maxTable, _xWidth, _yHeight, _xBlocks, _yBlocks, _xLevels, _yLevels);
+}
+
+PixelMinMax::~PixelMinMax()
+{
+	freeMemory();
+}
+
+PixelMinMax::PixelMinMax(const PixelMinMax& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _xBlocks(other._xBlocks)
+	, _yBlocks(other._yBlocks)
+	, _xLevels(other._xLevels)
+	, _yLevels(other._yLevels)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_minTable, other._minTable, getTableSize() * sizeof(unsigned char));
+	memcpy(_maxTable, other._maxTable, getTableSize() * sizeof(unsigned char));
+}
+
+PixelMinMax::PixelMinMax(PixelMinMax&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _xBlocks(other._xBlocks)
+	, _yBlocks(other._yBlocks)
+	, _xLevels(other._xLevels)
+	, _yLevels(other._yLevels)
+{
+	// Move
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_minTable = other._minTable;
+	other._minTable = nullptr;
+
+	_maxTable = other._maxTable;
+	other._maxTable = nullptr;
+}
+
+PixelMinMax& PixelMinMax::operator=(const PixelMinMax& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_xBlocks = other._xBlocks;
+	_yBlocks = other._yBlocks;
+	_xLevels = other._xLevels;
+	_yLevels = other._yLevels;
+
+	allocateMemory();
+
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_minTable, other._minTable, getTableSize() * sizeof(unsigned char));
+	memcpy(_maxTable, other._maxTable, getTableSize() * sizeof(unsigned char));
+
+	return *this;
+}
+
+PixelMinMax& PixelMinMax::operator=(PixelMinMax&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_xBlocks = other._xBlocks;
+	_yBlocks = other._yBlocks;
+	_xLevels = other._xLevels;
+	_yLevels = other._yLevels;
+
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_minTable = other._minTable;
+	other._minTable = nullptr;
+
+	_maxTable = other._maxTable;
+	other._maxTable = nullptr;
+
+	return *this;
+}
+
+unsigned char PixelMinMax::getMin(int x0, int y0, int x1, int y1) const
+{
+	return query<MinOperation>(_minTable, x0, y0, x1, y1);
+}
+
+unsigned char PixelMinMax::getMax(int x0, int y0, int x1, int y1) const
+{
+	return query<MaxOperation>(_maxTable, x0, y0, x1, y1);
+}
+
+template<class TOperation>
+unsigned char PixelMinMax::query(const unsigned char* table, int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minX = rect.x0;
+	int minY = rect.y0;
+	int maxX = rect.x1;
+	int maxY = rect.y1;
+
+	// Blocks fully covered by the region. The last block can be cut by the border
+	int bx0 = (minX + BlockMask) >> BlockShift;
+	int by0 = (minY + BlockMask) >> BlockShift;
+	int bx1 = (maxX == _xWidth - 1 ? _xBlocks : (maxX + 1) >> BlockShift) - 1;
+	int by1 = (maxY == _yHeight - 1 ? _yBlocks : (maxY + 1) >> BlockShift) - 1;
+
+	if (bx0 > bx1 || by0 > by1)
+	{
+		// Region is thinner than a block
+		return scanRegion<TOperation>(_buffer, _xWidth, minX, minY, maxX, maxY, TOperation::identity());
+	}
+
+	// Calculate. Four overlapping power of two ranges of blocks
+	int kx = utils::floorLog2(bx1 - bx0 + 1);
+	int ky = utils::floorLog2(by1 - by0 + 1);
+
+	const auto level = table + (ky * _xLevels + kx) * _xBlocks * _yBlocks;
+
+	int bx2 = bx1 - (1 << kx) + 1;
+	int by2 = by1 - (1 << ky) + 1;
+
+	unsigned char result = TOperation::apply(
+		TOperation::apply(level[bx0 + by0 * _xBlocks], level[bx2 + by0 * _xBlocks]),
+		TOperation::apply(level[bx0 + by2 * _xBlocks], level[bx2 + by2 * _xBlocks])
+	);
+
+	// Partially covered blocks on the border
+	int innerX0 = bx0 << BlockShift;
+	int innerY0 = by0 << BlockShift;
+	int innerX1 = std::min(((bx1 + 1) << BlockShift) - 1, _xWidth - 1);
+	int innerY1 = std::min(((by1 + 1) << BlockShift) - 1, _yHeight - 1);
+
+	result = scanRegion<TOperation>(_buffer, _xWidth, minX, minY, maxX, innerY0 - 1, result);
+	result = scanRegion<TOperation>(_buffer, _xWidth, minX, innerY1 + 1, maxX, maxY, result);
+	result = scanRegion<TOperation>(_buffer, _xWidth, minX, innerY0, innerX0 - 1, innerY1, result);
+	result = scanRegion<TOperation>(_buffer, _xWidth, innerX1 + 1, innerY0, maxX, innerY1, result);
+
+	return result;
+}
+
+void PixelMinMax::allocateMemory()
+{
+	_buffer = new unsigned char[_xWidth * _yHeight];
+	_minTable = new unsigned char[getTableSize()];
+	_maxTable = new unsigned char[getTableSize()];
+}
+
+void PixelMinMax::freeMemory()
+{
+	delete[] _maxTable;
+	delete[] _minTable;
+	delete[] _buffer;
+}
+
+} // End sparse
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Common.h"
+
+namespace sparse {
+
+/**
+ * Sparse table implementation for providing region minimum/maximum queries from an 8-bit pixel buffer.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getMax(4,8,7,10) gets the maximum of a 4x3 region where top left
+ * corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ *
+ * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * The buffer is split into 16x16 blocks and a 2D sparse table of block minimums
+ * and maximums is built. A query is four table lookups for the blocks covered by
+ * the region and a scan of the partially covered blocks on its border, strips of up to
+ * 15 pixels, so O((width + height) * 16). A region that covers no whole block, thinner
+ * than 16 pixels in either dimension, is scanned whole: a 15x4096 region reads all of
+ * its ~61k pixels, O(width * height).
+ * https://en.wikipedia.org/wiki/Range_minimum_query
+ *
+ * Memory: xWidth * yHeight * sizeof(uint8) * (1 + 2 * xLevels * yLevels / 256),
+ * where levels = log2(size / 16) + 1
+ */
+class PIXEL_SUM_API PixelMinMax
+{
+public:
+	static const int BlockShift = 4;
+	static const int BlockSize = 1 << BlockShift;
+	static const int BlockMask = BlockSize - 1;
+
+public:
+	// Contrustors/Destructor
+	PixelMinMax(const unsigned char* buffer, int xWidth, int yHeight);
+	~PixelMinMax();
+	PixelMinMax(const PixelMinMax& other);
+	PixelMinMax(PixelMinMax&& other);
+
+	// Operators
+	PixelMinMax& operator=(const PixelMinMax& other);
+	PixelMinMax& operator=(PixelMinMax&& other);
+
+	// Methods
+	unsigned char getMin(int x0, int y0, int x1, int y1) const;
+	unsigned char getMax(int x0, int y0, int x1, int y1) const;
+
+private:
+	template<class TOperation>
+	unsigned char query(const unsigned char* table, int x0, int y0, int x1, int y1) const;
+
+	int getTableSize() const
+	{
+		return _xBlocks * _yBlocks * _xLevels * _yLevels;
+	}
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned char* _buffer;
+	unsigned char* _minTable;
+	unsigned char* _maxTable;
+
+	int _xWidth;
+	int _yHeight;
+
+	int _xBlocks;
+	int _yBlocks;
+	int _xLevels;
+	int _yLevels;
+};
+
+} // End sparse
@@ -0,0 +1,336 @@
+#include "PixelQuantileWavelet.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <math.h>		// ceil
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace wavelet {
+
+void extractBits(const unsigned char* data, int len, int bit, unsigned long long* bits)
+{
+#ifdef __SSE2__
+	extractBitsSSE(data, len, bit, bits);
+#else
+	memset(bits, 0, ((len + 63) / 64) * sizeof(unsigned long long));
+
+	for (int x = 0; x < len; ++x)
+	{
+		bits[x / 64] |= (unsigned long long)((data[x] >> bit) & 1) << (x % 64);
+	}
+#endif // __SSE2__
+}
+
+// Ranges of the sequence for rows of a region
+struct RowRanges
+{
+	std::vector<int> begin;
+	std::vector<int> end;
+
+	std::vector<unsigned int> beginOnes;
+	std::vector<unsigned int> endOnes;
+
+	RowRanges(const utils::Rect& rect, int xWidth)
+		: begin(rect.getHeight())
+		, end(rect.getHeight())
+		, beginOnes(rect.getHeight())
+		, endOnes(rect.getHeight())
+	{
+		for (int j = 0; j < rect.getHeight(); ++j)
+		{
+			begin[j] = rect.x0 + (rect.y0 + j) * xWidth;
+			end[j] = begin[j] + rect.getWidth();
+		}
+	}
+
+	int size() const
+	{
+		return int(begin.size());
+	}
+};
+
+PixelQuantile::PixelQuantile(const unsigned char* buffer, int xWidth, int yHeight)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _words((xWidth * yHeight + 63) / 64)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // Same limits as integral::PixelSum
+
+	allocateMemory();
+
+	int len = _xWidth * _yHeight;
+
+	std::vector<unsigned char> current(buffer, buffer + len);
+	std::vector<unsigned char> next(len);
+
+	// Levels from the most significant bit
+	for (int level = 0; level < Levels; ++level)
+	{
+		int bit = Levels - 1 - level;
+
+		auto bits = _bits + level * _words;
+		auto ranks = _ranks + level * (_words + 1);
+
+		extractBits(current.data(), len, bit, bits);
+
+		// Rank directory. Count of ones before the word
+		unsigned int count = 0;
+		for (int word = 0; word < _words; ++word)
+		{
+			ranks[word] = count;
+			count += utils::popCount64(bits[word]);
+		}
+
+		ranks[_words] = count;
+		_zeros[level] = len - int(count);
+
+		// Stable partition for the next level. Zeros then ones
+		if (level + 1 < Levels)
+		{
+			auto zeroPtr = next.data();
+			auto onePtr = next.data() + _zeros[level];
+
+			for (int i = 0; i < len; ++i)
+			{
+				unsigned char value = current[i];
+
+				if ((value >> bit) & 1)
+				{
+					*onePtr++ = value;
+				}
+				else
+				{
+					*zeroPtr++ = value;
+				}
+			}
+
+			current.swap(next);
+		}
+	}
+}
+
+PixelQuantile::~PixelQuantile()
+{
+	freeMemory();
+}
+
+PixelQuantile::PixelQuantile(const PixelQuantile& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _words(other._words)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_bits, other._bits, Levels * _words * sizeof(unsigned long long));
+	memcpy(_ranks, other._ranks, Levels * (_words + 1) * sizeof(unsigned int));
+	memcpy(_zeros, other._zeros, sizeof(_zeros));
+}
+
+PixelQuantile::PixelQuantile(PixelQuantile&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _words(other._words)
+{
+	// Move
+	_bits = other._bits;
+	other._bits = nullptr;
+
+	_ranks = other._ranks;
+	other._ranks = nullptr;
+
+	memcpy(_zeros, other._zeros, sizeof(_zeros));
+}
+
+PixelQuantile& PixelQuantile::operator=(const PixelQuantile& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_words = other._words;
+
+	allocateMemory();
+
+	memcpy(_bits, other._bits, Levels * _words * sizeof(unsigned long long));
+	memcpy(_ranks, other._ranks, Levels * (_words + 1) * sizeof(unsigned int));
+	memcpy(_zeros, other._zeros, sizeof(_zeros));
+
+	return *this;
+}
+
+PixelQuantile& PixelQuantile::operator=(PixelQuantile&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_words = other._words;
+
+	_bits = other._bits;
+	other._bits = nullptr;
+
+	_ranks = other._ranks;
+	other._ranks = nullptr;
+
+	memcpy(_zeros, other._zeros, sizeof(_zeros));
+
+	return *this;
+}
+
+int PixelQuantile::getRank(int x0, int y0, int x1, int y1, unsigned char value) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	RowRanges ranges(rect, _xWidth);
+
+	// Calculate. Follow the bits of value and count the ranges that go to zeros with one bits
+	int count = 0;
+
+	for (int level = 0; level < Levels; ++level)
+	{
+		bool one = ((value >> (Levels - 1 - level)) & 1) != 0;
+
+		for (int j = 0; j < ranges.size(); ++j)
+		{
+			unsigned int beginOnes = rankOne(level, ranges.begin[j]);
+			unsigned int endOnes = rankOne(level, ranges.end[j]);
+
+			if (one)
+			{
+				count += (ranges.end[j] - int(endOnes)) - (ranges.begin[j] - int(beginOnes));
+
+				ranges.begin[j] = _zeros[level] + int(beginOnes);
+				ranges.end[j] = _zeros[level] + int(endOnes);
+			}
+			else
+			{
+				ranges.begin[j] -= int(beginOnes);
+				ranges.end[j] -= int(endOnes);
+			}
+		}
+	}
+
+	return count;
+}
+
+unsigned char PixelQuantile::getQuantile(int x0, int y0, int x1, int y1, int k) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	assert(k >= 0 && k < rect.getWidth() * rect.getHeight());
+
+	RowRanges ranges(rect, _xWidth);
+
+	// Calculate. Go to zeros while k is less than count of zeros
+	unsigned char value = 0;
+
+	for (int level = 0; level < Levels; ++level)
+	{
+		int zeros = 0;
+
+		for (int j = 0; j < ranges.size(); ++j)
+		{
+			ranges.beginOnes[j] = rankOne(level, ranges.begin[j]);
+			ranges.endOnes[j] = rankOne(level, ranges.end[j]);
+
+			zeros += (ranges.end[j] - int(ranges.endOnes[j])) - (ranges.begin[j] - int(ranges.beginOnes[j]));
+		}
+
+		bool one = k >= zeros;
+		if (one)
+		{
+			k -= zeros;
+			value |= 1 << (Levels - 1 - level);
+		}
+
+		for (int j = 0; j < ranges.size(); ++j)
+		{
+			if (one)
+			{
+				ranges.begin[j] = _zeros[level] + int(ranges.beginOnes[j]);
+				ranges.end[j] = _zeros[level] + int(ranges.endOnes[j]);
+			}
+			else
+			{
+				ranges.begin[j] -= int(ranges.beginOnes[j]);
+				ranges.end[j] -= int(ranges.endOnes[j]);
+			}
+		}
+	}
+
+	return value;
+}
+
+unsigned char PixelQuantile::getPercentile(int x0, int y0, int x1, int y1, double percentile) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int count = rect.getWidth() * rect.getHeight();
+
+	// Nearest rank
+	int k = utils::clamp(int(ceil(percentile * count)) - 1, 0, count - 1);
+
+	return getQuantile(x0, y0, x1, y1, k);
+}
+
+unsigned char PixelQuantile::getMedian(int x0, int y0, int x1, int y1) const
+{
+	return getPercentile(x0, y0, x1, y1, 0.5);
+}
+
+unsigned int PixelQuantile::rankOne(int level, int index) const
+{
+	const auto bits = _bits + level * _words;
+	const auto ranks = _ranks + level * (_words + 1);
+
+	int word = index >> 6;
+	int offset = index & 63;
+
+	unsigned int count = ranks[word];
+	if (offset != 0)
+	{
+		count += utils::popCount64(bits[word] & ((1ULL << offset) - 1));
+	}
+
+	return count;
+}
+
+void PixelQuantile::allocateMemory()
+{
+	_bits = new unsigned long long[Levels * _words];
+	_ranks = new unsigned int[Levels * (_words + 1)];
+}
+
+void PixelQuantile::freeMemory()
+{
+	delete[] _ranks;
+	delete[] _bits;
+}
+
+} // End wavelet
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Common.h"
+
+namespace wavelet {
+
+/**
+ * Wavelet matrix implementation for providing region rank and quantile queries from an 8-bit pixel buffer.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getMedian(4,8,7,10) gets the median of a 4x3 region where top left
+ * corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ *
+ * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * The buffer is stored as a row-major sequence in 8 bit levels with rank directories.
+ * A region is a range of the sequence per row, so a query is O(8 * height)
+ * rank operations and does not depend on the width of the region.
+ * https://en.wikipedia.org/wiki/Wavelet_Tree
+ *
+ * Memory: xWidth * yHeight * 8 * (1 + sizeof(uint32) / 8) bits
+ */
+class PIXEL_SUM_API PixelQuantile
+{
+public:
+	static const int Levels = 8;
+
+public:
+	// Contrustors/Destructor
+	PixelQuantile(const unsigned char* buffer, int xWidth, int yHeight);
+	~PixelQuantile();
+	PixelQuantile(const PixelQuantile& other);
+	PixelQuantile(PixelQuantile&& other);
+
+	// Operators
+	PixelQuantile& operator=(const PixelQuantile& other);
+	PixelQuantile& operator=(PixelQuantile&& other);
+
+	// Methods
+
+	// Count of pixels < value
+	int getRank(int x0, int y0, int x1, int y1, unsigned char value) const;
+
+	// k-th smallest value, k in [0, count - 1]
+	unsigned char getQuantile(int x0, int y0, int x1, int y1, int k) const;
+
+	// Nearest rank percentile, percentile in [0, 1]
+	unsigned char getPercentile(int x0, int y0, int x1, int y1, double percentile) const;
+	unsigned char getMedian(int x0, int y0, int x1, int y1) const;
+
+private:
+	unsigned int rankOne(int level, int index) const;
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned long long* _bits;
+	unsigned int* _ranks;
+	int _zeros[Levels];
+
+	int _xWidth;
+	int _yHeight;
+	int _words;
+};
+
+} // End wavelet
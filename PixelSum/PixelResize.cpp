@@ -0,0 +1,128 @@
+#include "PixelResize.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "PixelBoxFilter.h"
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void scaleRoundLine(const unsigned int* src, const float* scales, float scale, unsigned char* dst, int len)
+{
+#ifdef __SSE2__
+	convertScaleRoundU32SSE(src, scales, scale, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = (unsigned char)std::min(float(src[x]) * scales[x] * scale + 0.5f, 255.0f);
+	}
+#endif // __SSE2__
+}
+
+// Source ranges [first, last] of the output pixels along one axis
+void fillAreaBounds(int srcLength, int dstLength, int* first, int* last)
+{
+	for (int i = 0; i < dstLength; ++i)
+	{
+		first[i] = int((long long)i * srcLength / dstLength);
+		last[i] = std::max(first[i], int((long long)(i + 1) * srcLength / dstLength) - 1);
+	}
+}
+
+AreaResize::AreaResize(const PixelSum& pixelSum, int threads)
+	: _pixelSum(pixelSum)
+	, _threads(threads)
+{
+}
+
+void AreaResize::resize(int dstWidth, int dstHeight, unsigned char* dst) const
+{
+	assert(dst != nullptr);
+	assert(dstWidth > 0 && dstHeight > 0);
+
+	int xWidth = _pixelSum.getWidth();
+	int yHeight = _pixelSum.getHeight();
+
+	// Column bounds. Once for all lines
+	std::vector<int> x0(dstWidth);
+	std::vector<int> x1(dstWidth);
+	std::vector<float> invWidths(dstWidth);
+
+	fillAreaBounds(xWidth, dstWidth, x0.data(), x1.data());
+
+	for (int i = 0; i < dstWidth; ++i)
+	{
+		invWidths[i] = float(1.0 / (x1[i] - x0[i] + 1));
+	}
+
+	// Row bounds
+	std::vector<int> y0(dstHeight);
+	std::vector<int> y1(dstHeight);
+
+	fillAreaBounds(yHeight, dstHeight, y0.data(), y1.data());
+
+	utils::parallelFor(dstHeight, _threads, [&](int begin, int end) {
+		// Band is shifted by one, band[0] = 0 is the column before the buffer
+		std::vector<unsigned int> band(xWidth + 1, 0);
+		std::vector<unsigned int> top(xWidth);
+		std::vector<unsigned int> sums(dstWidth);
+
+		for (int j = begin; j < end; ++j)
+		{
+			// Columns of the band. SA(x, y1) - SA(x, y0 - 1)
+			_pixelSum.getSummedAreaLine(y1[j], band.data() + 1, nullptr);
+
+			if (y0[j] > 0)
+			{
+				_pixelSum.getSummedAreaLine(y0[j] - 1, top.data(), nullptr);
+				BoxFilter::getBandLine(band.data() + 1, top.data(), band.data() + 1, xWidth);
+			}
+
+			for (int i = 0; i < dstWidth; ++i)
+			{
+				sums[i] = band[x1[i] + 1] - band[x0[i]];
+			}
+
+			float invHeight = float(1.0 / (y1[j] - y0[j] + 1));
+			scaleRoundLine(sums.data(), invWidths.data(), invHeight, dst + size_t(j) * dstWidth, dstWidth);
+		}
+	});
+}
+
+void AreaResize::getMipmapChain(int levels, unsigned char* const* dst) const
+{
+	assert(dst != nullptr);
+	assert(levels > 0 && levels <= getMipmapLevels());
+
+	// Level 0
+	memcpy(dst[0], _pixelSum.getBuffer(), _pixelSum.getWidth() * _pixelSum.getHeight() * sizeof(unsigned char));
+
+	// Every level from the source tables
+	for (int level = 1; level < levels; ++level)
+	{
+		resize(getMipmapWidth(level), getMipmapHeight(level), dst[level]);
+	}
+}
+
+int AreaResize::getMipmapLevels() const
+{
+	return utils::floorLog2(unsigned(std::max(_pixelSum.getWidth(), _pixelSum.getHeight()))) + 1;
+}
+
+int AreaResize::getMipmapWidth(int level) const
+{
+	return std::max(1, _pixelSum.getWidth() >> level);
+}
+
+int AreaResize::getMipmapHeight(int level) const
+{
+	return std::max(1, _pixelSum.getHeight() >> level);
+}
+
+} // End integral
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * Area-averaging resize of a whole image from the summed area tables of integral::PixelSum.
+ * Output pixel (i, j) of a dstWidth x dstHeight image is the rounded average of the source region
+ *
+ *   x0 = i * xWidth / dstWidth, x1 = max(x0, (i + 1) * xWidth / dstWidth - 1)
+ *   y0 = j * yHeight / dstHeight, y1 = max(y0, (j + 1) * yHeight / dstHeight - 1)
+ *
+ * so the regions partition the source for any (not only integer) downscale factor.
+ * Upscaling repeats the source pixels.
+ *
+ * Region bounds are computed once per output row and column. An output line is
+ * four table lookups per pixel: the difference of two table lines is taken by SSE
+ * and then sampled at the column bounds. Lines are split between threads.
+ *
+ * The mipmap chain is built from the same tables, level k is
+ * max(1, xWidth >> k) x max(1, yHeight >> k) and is averaged from the source,
+ * not from level k - 1, so there is no error accumulated through the levels.
+ */
+class PIXEL_SUM_API AreaResize
+{
+public:
+	// Contrustors/Destructor
+	AreaResize(const PixelSum& pixelSum, int threads = 0);	// threads <= 0 - one per hardware thread
+
+	// Methods
+
+	// dst is dstWidth * dstHeight
+	void resize(int dstWidth, int dstHeight, unsigned char* dst) const;
+
+	// Levels 0..levels - 1, dst[k] is getMipmapWidth(k) * getMipmapHeight(k). Level 0 is a copy of the source
+	void getMipmapChain(int levels, unsigned char* const* dst) const;
+
+	// Levels down to 1x1
+	int getMipmapLevels() const;
+	int getMipmapWidth(int level) const;
+	int getMipmapHeight(int level) const;
+
+private:
+	const PixelSum& _pixelSum;
+	int _threads;
+};
+
+} // End integral
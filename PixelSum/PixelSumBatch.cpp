@@ -0,0 +1,154 @@
+#include "PixelSumBatch.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+// One line of a single table, as in integral::PixelSum. prevSums and prevCounts are nullptr for the first line
+void fillPatchLine(const unsigned char* src, const unsigned int* prevSums, const unsigned int* prevCounts, unsigned int* sums, unsigned int* counts, int len)
+{
+#ifdef __SSE2__
+	summedAreaLineSSE(src, prevSums, prevCounts, sums, counts, len);
+#else
+	unsigned int rowSum = 0;
+	unsigned int rowCount = 0;
+
+	for (int x = 0; x < len; ++x)
+	{
+		rowSum += src[x];
+		rowCount += src[x] != 0 ? 1 : 0;
+
+		sums[x] = rowSum + (prevSums != nullptr ? prevSums[x] : 0);
+		counts[x] = rowCount + (prevCounts != nullptr ? prevCounts[x] : 0);
+	}
+#endif // __SSE2__
+}
+
+PixelSumView::PixelSumView(const unsigned int* summedArea, const unsigned int* summedNonZeroArea, int xWidth, int yHeight)
+	: _summedArea(summedArea)
+	, _summedNonZeroArea(summedNonZeroArea)
+	, _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+}
+
+unsigned int PixelSumView::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	return regionValue(_summedArea, x0, y0, x1, y1);
+}
+
+double PixelSumView::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+
+	// Result
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+
+	return double(sum) / double(width * height);
+}
+
+int PixelSumView::getNonZeroCount(int x0, int y0, int x1, int y1) const
+{
+	return int(regionValue(_summedNonZeroArea, x0, y0, x1, y1));
+}
+
+double PixelSumView::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	int count = getNonZeroCount(x0, y0, x1, y1);
+
+	// Result
+	return count != 0 ? double(sum) / double(count) : 0.0;
+}
+
+unsigned int PixelSumView::regionValue(const unsigned int* table, int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minX = rect.x0;
+	int minY = rect.y0;
+	int maxX = rect.x1;
+	int maxY = rect.y1;
+
+	// Calculate
+	unsigned int B = (minX > 0 && minY > 0) ? table[(minX - 1) + (minY - 1) * _xWidth] : 0;
+	unsigned int C = minY > 0 ? table[maxX + (minY - 1) * _xWidth] : 0;
+
+	unsigned int A = table[maxX + maxY * _xWidth];
+	unsigned int D = minX > 0 ? table[(minX - 1) + maxY * _xWidth] : 0;
+
+	// https://en.wikipedia.org/wiki/Summed-area_table
+	return A + B - C - D;
+}
+
+PixelSumBatch::PixelSumBatch(const unsigned char* const* patches, int count, int xWidth, int yHeight, int threads)
+	: _count(count)
+	, _threads(threads)
+	, _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+	assert(patches != nullptr);
+	assert(count > 0);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // Same limits as integral::PixelSum
+
+	// One arena, sums and then counts
+	_arena = new unsigned int[size_t(_count) * getTableSize() * 2];
+	_summedNonZeroArea = _arena + size_t(_count) * getTableSize();
+
+	rebuild(patches);
+}
+
+PixelSumBatch::~PixelSumBatch()
+{
+	delete[] _arena;
+}
+
+void PixelSumBatch::rebuild(const unsigned char* const* patches)
+{
+	assert(patches != nullptr);
+
+	utils::parallelFor(_count, _threads, [&](int begin, int end) {
+		for (int index = begin; index < end; ++index)
+		{
+			fillPatch(patches[index], index);
+		}
+	});
+}
+
+PixelSumView PixelSumBatch::getView(int index) const
+{
+	assert(index >= 0 && index < _count);
+
+	size_t offset = size_t(index) * getTableSize();
+	return PixelSumView(_arena + offset, _summedNonZeroArea + offset, _xWidth, _yHeight);
+}
+
+void PixelSumBatch::fillPatch(const unsigned char* patch, int index)
+{
+	auto sums = _arena + size_t(index) * getTableSize();
+	auto counts = _summedNonZeroArea + size_t(index) * getTableSize();
+
+	fillPatchLine(patch, nullptr, nullptr, sums, counts, _xWidth);
+
+	for (int y = 1; y < _yHeight; ++y)
+	{
+		int offset = y * _xWidth;
+		fillPatchLine(patch + offset, sums + offset - _xWidth, counts + offset - _xWidth, sums + offset, counts + offset, _xWidth);
+	}
+}
+
+} // End integral
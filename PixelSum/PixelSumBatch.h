@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Common.h"
+
+namespace integral {
+
+/**
+ * Read-only view of one summed area table of PixelSumBatch, same queries as integral::PixelSum.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the patch by the implementation.
+ *
+ * SA(x, y) of the patch is at x + y * xWidth, as in integral::PixelSum.
+ * A view is two pointers and the sizes, it is valid while the batch is alive.
+ */
+class PIXEL_SUM_API PixelSumView
+{
+public:
+	// Contrustors/Destructor
+	PixelSumView(const unsigned int* summedArea, const unsigned int* summedNonZeroArea, int xWidth, int yHeight);
+
+	// Methods
+	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	double getPixelAverage(int x0, int y0, int x1, int y1) const;
+
+	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
+	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	unsigned int regionValue(const unsigned int* table, int x0, int y0, int x1, int y1) const;
+
+private:
+	const unsigned int* _summedArea;
+	const unsigned int* _summedNonZeroArea;
+
+	int _xWidth;
+	int _yHeight;
+};
+
+/**
+ * Summed area tables of many equally sized patches, built in one pass.
+ * Every table is built by the line kernel of integral::PixelSum straight into its place in
+ * one arena, without the per-patch allocations and the copy of the pixels. Patches are
+ * split between threads, rebuild reuses the arena.
+ *
+ * All tables are in one arena: pixel (x, y) of patch i is at (i * yHeight + y) * xWidth + x,
+ * sums first, then the non-zero counts.
+ *
+ * Memory: count * xWidth * yHeight * sizeof(uint32) * 2, no copy of the pixels
+ */
+class PIXEL_SUM_API PixelSumBatch
+{
+public:
+	// Contrustors/Destructor
+	PixelSumBatch(const unsigned char* const* patches, int count, int xWidth, int yHeight, int threads = 0);	// threads <= 0 - one per hardware thread
+	~PixelSumBatch();
+	PixelSumBatch(const PixelSumBatch& other) = delete;
+
+	// Operators
+	PixelSumBatch& operator=(const PixelSumBatch& other) = delete;
+
+	// Methods
+
+	// Tables of the next 'count' patches of the same size in the same arena, views stay valid
+	void rebuild(const unsigned char* const* patches);
+
+	PixelSumView getView(int index) const;
+
+	// Inlines
+	int getCount() const
+	{
+		return _count;
+	}
+
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	int getTableSize() const
+	{
+		return _xWidth * _yHeight;
+	}
+
+	void fillPatch(const unsigned char* patch, int index);
+
+private:
+	unsigned int* _arena;
+	unsigned int* _summedNonZeroArea;	// Second half of the arena
+
+	int _count;
+	int _threads;
+
+	int _xWidth;
+	int _yHeight;
+};
+
+} // End integral
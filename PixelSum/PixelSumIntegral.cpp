@@ -3,7 +3,9 @@
 #include <string.h>		// memcpy
 #include <stdlib.h>		// malloc, free, rand
 #include <assert.h>
+#include <math.h>		// sqrt, ceil, floor
 #include <algorithm>	// min, max, clamp
+#include <vector>
 
 #include "Utils.h"
 
@@ -11,62 +13,523 @@
 
 namespace integral {
 
-void fillSummedArea(const unsigned char* buffer, unsigned int* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight)
+// One line of the tables. prevSum and prevZeroSum are nullptr for the first line
+template<class TPixel, class TSum>
+void fillSummedAreaLine(const TPixel* src, const TSum* prevSum, const unsigned int* prevZeroSum, TSum* sum, unsigned int* zeroSum, int len)
+{
+	TSum sumLine = 0;
+	unsigned int zeroSumLine = 0;
+
+	for (int x = 0; x < len; ++x)
+	{
+		auto value = src[x];
+
+		// SA(x, y) = B(x, y) + SA(x - 1, y) + SA(x, y - 1)
+		sumLine += value;
+		zeroSumLine += (value != 0 ? 1 : 0);
+
+		sum[x] = sumLine + (prevSum != nullptr ? prevSum[x] : 0);
+		zeroSum[x] = zeroSumLine + (prevZeroSum != nullptr ? prevZeroSum[x] : 0);
+	}
+}
+
+#ifdef __SSE2__
+void fillSummedAreaLine(const unsigned char* src, const unsigned int* prevSum, const unsigned int* prevZeroSum, unsigned int* sum, unsigned int* zeroSum, int len)
+{
+	summedAreaLineSSE(src, prevSum, prevZeroSum, sum, zeroSum, len);
+}
+
+void fillSummedAreaLine(const unsigned short* src, const unsigned long long* prevSum, const unsigned int* prevZeroSum, unsigned long long* sum, unsigned int* zeroSum, int len)
+{
+	summedAreaLineSSE(src, prevSum, prevZeroSum, sum, zeroSum, len);
+}
+
+void fillSummedAreaLine(const float* src, const double* prevSum, const unsigned int* prevZeroSum, double* sum, unsigned int* zeroSum, int len)
+{
+	summedAreaLineSSE(src, prevSum, prevZeroSum, sum, zeroSum, len);
+}
+#endif // __SSE2__
+
+// Lines of the buffer are requested once and in order, so a source can convert them on the fly
+template<class TLineSource, class TSum>
+void fillSummedArea(TLineSource lineSource, TSum* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight)
 {
 	// First line
+	fillSummedAreaLine(lineSource(0), static_cast<const TSum*>(nullptr), nullptr, summedArea, summedNonZeroArea, xWidth);
+
+	// Others
+	for (int y = 1; y < yHeight; ++y)
+	{
+		const auto prevSum = summedArea + (y - 1) * xWidth;
+		const auto prevZeroSum = summedNonZeroArea + (y - 1) * xWidth;
+
+		fillSummedAreaLine(lineSource(y), prevSum, prevZeroSum, summedArea + y * xWidth, summedNonZeroArea + y * xWidth, xWidth);
+	}
+}
+
+template<class TLineSource, class TSum>
+void fillSummedAreaTiled(TLineSource lineSource, TSum* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight, int xTiles)
+{
+	const int tileShift = PixelSumBase::TileShift;
+	const int tileMask = PixelSumBase::TileMask;
+	const int tileSize = PixelSumBase::TileSize;
+
+	// Current line of the tables. SA(x, y - 1) before the update
+	std::vector<TSum> sumLine(xWidth, 0);
+	std::vector<unsigned int> zeroSumLine(xWidth, 0);
+
+	for (int y = 0; y < yHeight; ++y)
 	{
-		unsigned int sumLine = 0;
-		unsigned int zeroSumLine = 0;
+		const auto src = lineSource(y);
+
+		TSum rowSum = 0;
+		unsigned int rowZeroSum = 0;
 
 		for (int x = 0; x < xWidth; ++x)
 		{
-			unsigned char value = buffer[x];
+			auto value = src[x];
+
+			// SA(x, y) = B(x, y) + SA(x - 1, y) + SA(x, y - 1)
+			rowSum += value;
+			rowZeroSum += (value != 0 ? 1 : 0);
+
+			sumLine[x] += rowSum;
+			zeroSumLine[x] += rowZeroSum;
+		}
 
-			// SA(x, y) = B(x, y) + SA(x - 1, y)
-			sumLine += value;
-			zeroSumLine += (value > 0 ? 1 : 0);
+		// Scatter the line to the tiles. Each tile row is contiguous
+		int tileOffset = (y & tileMask) << tileShift;
+		int tileRow = (y >> tileShift) * xTiles;
 
-			summedArea[x] = sumLine;
-			summedNonZeroArea[x] = zeroSumLine;
+		for (int tileX = 0; tileX < xTiles; ++tileX)
+		{
+			int x = tileX << tileShift;
+			int count = std::min(tileSize, xWidth - x);
+			int offset = ((tileX + tileRow) << (tileShift * 2)) + tileOffset;
+
+			memcpy(summedArea + offset, sumLine.data() + x, count * sizeof(TSum));
+			memcpy(summedNonZeroArea + offset, zeroSumLine.data() + x, count * sizeof(unsigned int));
 		}
 	}
+}
 
-	// Others
-	for (int y = 1; y < yHeight; ++y)
+inline unsigned char weightedLuma(unsigned char c0, unsigned char c1, unsigned char c2, short w0, short w1, short w2)
+{
+	return (unsigned char)((w0 * c0 + w1 * c1 + w2 * c2 + 128) >> 8);
+}
+
+inline unsigned short weightedLuma(unsigned short c0, unsigned short c1, unsigned short c2, short w0, short w1, short w2)
+{
+	return (unsigned short)((w0 * unsigned(c0) + w1 * unsigned(c1) + w2 * unsigned(c2) + 128) >> 8);
+}
+
+inline float weightedLuma(float c0, float c1, float c2, short w0, short w1, short w2)
+{
+	return (w0 * c0 + w1 * c1 + w2 * c2) * (1.0f / 256.0f);
+}
+
+template<class TPixel>
+void lumaPlanarLine(const TPixel* src0, const TPixel* src1, const TPixel* src2, short w0, short w1, short w2, TPixel* dst, int len)
+{
+	for (int x = 0; x < len; ++x)
 	{
-		const auto src = buffer + y * xWidth;
+		dst[x] = weightedLuma(src0[x], src1[x], src2[x], w0, w1, w2);
+	}
+}
 
-		const auto prevSum = summedArea + (y - 1) * xWidth;
-		auto sum = summedArea + y * xWidth;
+template<class TPixel>
+void lumaInterleavedLine(const TPixel* src, int channels, short w0, short w1, short w2, TPixel* dst, int len)
+{
+	for (int x = 0; x < len; ++x)
+	{
+		const auto pixel = src + x * channels;
+		dst[x] = weightedLuma(pixel[0], pixel[1], pixel[2], w0, w1, w2);
+	}
+}
 
-		const auto prevZeroSum = summedNonZeroArea + (y - 1) * xWidth;
-		auto zeroSum = summedNonZeroArea + y * xWidth;
+#ifdef __SSE2__
+void lumaPlanarLine(const unsigned char* src0, const unsigned char* src1, const unsigned char* src2, short w0, short w1, short w2, unsigned char* dst, int len)
+{
+	lumaPlanarSSE(src0, src1, src2, w0, w1, w2, dst, len);
+}
 
-		unsigned int sumLine = 0;
-		unsigned int zeroSumLine = 0;
+void lumaInterleavedLine(const unsigned char* src, int channels, short w0, short w1, short w2, unsigned char* dst, int len)
+{
+	lumaInterleavedSSE(src, channels, w0, w1, w2, dst, len);
+}
+#endif // __SSE2__
 
-		// Set line's values
-		for (int x = 0; x < xWidth; ++x)
+// Luma of a line of a multi-channel buffer. BT.601 weights in 8-bit fixed point
+template<class TPixel>
+void convertLumaLine(const TPixel* buffer, PixelSumBase::Format format, int xWidth, int yHeight, int y, TPixel* dst)
+{
+	const short R = 77;
+	const short G = 150;
+	const short B = 29;
+
+	if (format == PixelSumBase::Format::PlanarRGB)
+	{
+		int planeSize = xWidth * yHeight;
+
+		const auto src0 = buffer + y * xWidth;
+		const auto src1 = src0 + planeSize;
+		const auto src2 = src1 + planeSize;
+
+		lumaPlanarLine(src0, src1, src2, R, G, B, dst, xWidth);
+		return;
+	}
+
+	bool bgr = format == PixelSumBase::Format::BGR || format == PixelSumBase::Format::BGRA;
+	int channels = format == PixelSumBase::Format::RGBA || format == PixelSumBase::Format::BGRA ? 4 : 3;
+
+	short w0 = bgr ? B : R;
+	short w2 = bgr ? R : B;
+
+	lumaInterleavedLine(buffer + y * xWidth * channels, channels, w0, G, w2, dst, xWidth);
+}
+
+template<class TLineSource, class TSum>
+void fillTables(TLineSource lineSource, TSum* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight, PixelSumBase::Layout layout, int xTiles)
+{
+	if (layout == PixelSumBase::Layout::Tiled)
+	{
+		fillSummedAreaTiled(lineSource, summedArea, summedNonZeroArea, xWidth, yHeight, xTiles);
+	}
+	else
+	{
+		fillSummedArea(lineSource, summedArea, summedNonZeroArea, xWidth, yHeight);
+	}
+}
+
+// dst = src0 - src1. Modular for the integer tables
+template<class TSum>
+void differenceLine(const TSum* src0, const TSum* src1, TSum* dst, int len)
+{
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] - src1[x];
+	}
+}
+
+void differenceLine(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	subtractArraySSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] - src1[x];
+	}
+#endif // __SSE2__
+}
+
+// Spans of the pixel centers of line y inside of a polygon or on its border, merged and added to 'spans'
+void fillPolygonLine(const int* xs, const int* ys, int count, int y, std::vector<double>& crossings, std::vector<PixelSumBase::Span>& line, std::vector<PixelSumBase::Span>& spans)
+{
+	crossings.clear();
+	line.clear();
+
+	for (int i = 0; i < count; ++i)
+	{
+		int j = i + 1 < count ? i + 1 : 0;
+
+		long long xa = xs[i], ya = ys[i];
+		long long xb = xs[j], yb = ys[j];
+
+		// Horizontal edge is a border span
+		if (ya == yb)
 		{
-			unsigned char value = src[x];
+			if (ya == y)
+			{
+				line.push_back({ y, int(std::min(xa, xb)), int(std::max(xa, xb)) });
+			}
 
-			// SA(x, y) = B(x, y) + SA(x - 1, y) + SA(x, y - 1)
-			unsigned int currentSumValue = value + sumLine;
-			unsigned int currentZeroSumValue = zeroSum[x] = (value > 0 ? 1 : 0) + zeroSumLine;
+			continue;
+		}
 
-			sum[x] = currentSumValue + prevSum[x];
-			zeroSum[x] = currentZeroSumValue + prevZeroSum[x];
+		if (ya > yb)
+		{
+			std::swap(xa, xb);
+			std::swap(ya, yb);
+		}
+
+		if (y < ya || y > yb)
+		{
+			continue;
+		}
+
+		// x = xa + (y - ya) * (xb - xa) / (yb - ya). A border pixel if x is integer
+		long long num = xa * (yb - ya) + (y - ya) * (xb - xa);
+		long long den = yb - ya;
+
+		if (num % den == 0)
+		{
+			line.push_back({ y, int(num / den), int(num / den) });
+		}
 
-			// Save 
-			sumLine = currentSumValue;
-			zeroSumLine = currentZeroSumValue;
+		// Half-open edges, so a vertex is crossed once
+		if (y < yb)
+		{
+			crossings.push_back(double(num) / double(den));
 		}
 	}
+
+	// Even-odd inner spans
+	std::sort(crossings.begin(), crossings.end());
+
+	for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+	{
+		int x0 = int(ceil(crossings[k]));
+		int x1 = int(floor(crossings[k + 1]));
+
+		if (x0 <= x1)
+		{
+			line.push_back({ y, x0, x1 });
+		}
+	}
+
+	// Merge overlapping spans, a pixel is counted once
+	std::sort(line.begin(), line.end(), [](const PixelSumBase::Span& a, const PixelSumBase::Span& b) {
+		return a.x0 < b.x0;
+	});
+
+	for (const auto& span : line)
+	{
+		if (!spans.empty() && spans.back().y == y && span.x0 <= spans.back().x1 + 1)
+		{
+			spans.back().x1 = std::max(spans.back().x1, span.x1);
+		}
+		else
+		{
+			spans.push_back(span);
+		}
+	}
+}
+
+// Spans of the lines of a polygon inside of the buffer
+void fillPolygonSpans(const int* xs, const int* ys, int count, int yHeight, std::vector<PixelSumBase::Span>& spans)
+{
+	int minY = std::max(*std::min_element(ys, ys + count), 0);
+	int maxY = std::min(*std::max_element(ys, ys + count), yHeight - 1);
+
+	std::vector<double> crossings;
+	std::vector<PixelSumBase::Span> line;
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		fillPolygonLine(xs, ys, count, y, crossings, line, spans);
+	}
+}
+
+// Integer square root of radius^2 - dy^2, half width of line dy of a disc
+long long getDiscHalfWidth(long long radiusSquare, long long dy)
+{
+	long long rest = radiusSquare - dy * dy;
+
+	long long halfWidth = (long long)sqrt(double(rest));
+	while (halfWidth * halfWidth > rest)
+	{
+		--halfWidth;
+	}
+
+	while ((halfWidth + 1) * (halfWidth + 1) <= rest)
+	{
+		++halfWidth;
+	}
+
+	return halfWidth;
 }
 
-PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
+// Spans of the pixel centers with (x - cx)^2 + (y - cy)^2 <= radius^2, clamped to the buffer
+void fillDiscSpans(int cx, int cy, int radius, int xWidth, int yHeight, std::vector<PixelSumBase::Span>& spans)
+{
+	long long radiusSquare = (long long)radius * radius;
+
+	long long minY = std::max((long long)cy - radius, 0LL);
+	long long maxY = std::min((long long)cy + radius, (long long)yHeight - 1);
+
+	for (long long y = minY; y <= maxY; ++y)
+	{
+		long long halfWidth = getDiscHalfWidth(radiusSquare, y - cy);
+
+		long long x0 = std::max(cx - halfWidth, 0LL);
+		long long x1 = std::min(cx + halfWidth, (long long)xWidth - 1);
+
+		if (x0 <= x1)
+		{
+			spans.push_back({ int(y), int(x0), int(x1) });
+		}
+	}
+}
+
+// Pixel count of the spans
+long long getSpansArea(const std::vector<PixelSumBase::Span>& spans)
+{
+	long long area = 0;
+	for (const auto& span : spans)
+	{
+		area += span.x1 - span.x0 + 1;
+	}
+
+	return area;
+}
+
+// Unclamped pixel count of a polygon, line by line without keeping the spans
+long long getPolygonArea(const int* xs, const int* ys, int count)
+{
+	long long minY = *std::min_element(ys, ys + count);
+	long long maxY = *std::max_element(ys, ys + count);
+
+	std::vector<double> crossings;
+	std::vector<PixelSumBase::Span> line;
+	std::vector<PixelSumBase::Span> spans;
+
+	long long area = 0;
+
+	for (long long y = minY; y <= maxY; ++y)
+	{
+		spans.clear();
+		fillPolygonLine(xs, ys, count, int(y), crossings, line, spans);
+
+		area += getSpansArea(spans);
+	}
+
+	return area;
+}
+
+// Unclamped pixel count of a disc, lines above and below the center are the same
+long long getDiscArea(int radius)
+{
+	long long radiusSquare = (long long)radius * radius;
+	long long area = 2 * getDiscHalfWidth(radiusSquare, 0) + 1;
+
+	for (long long dy = 1; dy <= radius; ++dy)
+	{
+		area += 2 * (2 * getDiscHalfWidth(radiusSquare, dy) + 1);
+	}
+
+	return area;
+}
+
+// Regions are ordered by cells of a 64x64 grid over the buffer
+const int HilbertShift = 6;
+const int HilbertSide = 1 << HilbertShift;
+
+// Regions evaluated ahead of their corner loads
+const int PrefetchDistance = 8;
+
+// Clamped region and its position in the batch
+struct OrderedRegion
+{
+	PixelSumBase::Region rect;
+	int index;
+};
+
+// Distance of every cell (x, y), at x + y * HilbertSide, along the Hilbert curve
+std::vector<unsigned short> makeHilbertKeys()
+{
+	std::vector<unsigned short> keys(HilbertSide * HilbertSide);
+
+	for (int i = 0; i < HilbertSide * HilbertSide; ++i)
+	{
+		int x = i % HilbertSide;
+		int y = i / HilbertSide;
+		int key = 0;
+
+		for (int s = HilbertSide / 2; s > 0; s /= 2)
+		{
+			int rx = (x & s) != 0 ? 1 : 0;
+			int ry = (y & s) != 0 ? 1 : 0;
+
+			key += s * s * ((3 * rx) ^ ry);
+
+			// Rotate the quadrant
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = HilbertSide - 1 - x;
+					y = HilbertSide - 1 - y;
+				}
+
+				std::swap(x, y);
+			}
+		}
+
+		keys[i] = (unsigned short)key;
+	}
+
+	return keys;
+}
+
+// RSAT of the columns outside of the buffer. The triangle is cut by the border
+// the same way as the triangle with the bottom at the border column
+template<class TSum>
+TSum tiltedValue(const TSum* tiltedArea, int xWidth, int tiltedHeight, int x, int y)
+{
+	if (x < 0)
+	{
+		y += x;
+		x = 0;
+	}
+	else if (x >= xWidth)
+	{
+		y -= x - (xWidth - 1);
+		x = xWidth - 1;
+	}
+
+	if (y < 0)
+	{
+		return 0;
+	}
+
+	// Below the extra rows triangles cover the whole buffer
+	y = std::min(y, tiltedHeight - 1);
+
+	return tiltedArea[x + y * xWidth];
+}
+
+template<class TPixel, class TSum>
+void fillTiltedArea(const TPixel* buffer, TSum* tiltedArea, int xWidth, int yHeight, int tiltedHeight)
+{
+	for (int y = 0; y < tiltedHeight; ++y)
+	{
+		const auto src = y < yHeight ? buffer + y * xWidth : nullptr;
+		const auto prevSrc = y >= 1 && y - 1 < yHeight ? buffer + (y - 1) * xWidth : nullptr;
+
+		auto tilted = tiltedArea + y * xWidth;
+
+		for (int x = 0; x < xWidth; ++x)
+		{
+			TSum value =
+				TSum(src != nullptr ? src[x] : TPixel(0)) +
+				TSum(prevSrc != nullptr ? prevSrc[x] : TPixel(0));
+
+			// RSAT(x, y) = RSAT(x - 1, y - 1) + RSAT(x + 1, y - 1) - RSAT(x, y - 2) + B(x, y) + B(x, y - 1)
+			if (y >= 2 && x >= 1 && x + 1 < xWidth)
+			{
+				const auto prevTilted = tilted - xWidth;
+				tilted[x] = value + prevTilted[x - 1] + prevTilted[x + 1] - prevTilted[x - xWidth];
+			}
+			else
+			{
+				tilted[x] = value
+					+ tiltedValue(tiltedArea, xWidth, tiltedHeight, x - 1, y - 1)
+					+ tiltedValue(tiltedArea, xWidth, tiltedHeight, x + 1, y - 1)
+					- tiltedValue(tiltedArea, xWidth, tiltedHeight, x, y - 2);
+			}
+		}
+	}
+}
+
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight, Layout layout, bool tilted)
 	: _xWidth(xWidth)
 	, _yHeight(yHeight)
+	, _layout(layout)
+	, _xTiles((xWidth + TileMask) >> TileShift)
+	, _yTiles((yHeight + TileMask) >> TileShift)
+	, _tiltedHeight(tilted ? yHeight + xWidth - 1 : 0)
 {
 	assert(buffer != nullptr);
 	assert(xWidth > 0 && yHeight > 0);
@@ -75,32 +538,86 @@ PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
 	allocateMemory();
 
 	// Copy
-	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(TPixel));
+
+	auto lineSource = [buffer, xWidth](int y) {
+		return buffer + y * xWidth;
+	};
+
+	fillTables(lineSource, _summedArea, _summedNonZeroArea, _xWidth, _yHeight, _layout, _xTiles);
+
+	if (hasTilted())
+	{
+		fillTiltedArea(buffer, _tiltedArea, _xWidth, _yHeight, _tiltedHeight);
+	}
+}
+
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const TPixel* buffer, Format format, int xWidth, int yHeight, Layout layout, bool tilted)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _layout(layout)
+	, _xTiles((xWidth + TileMask) >> TileShift)
+	, _yTiles((yHeight + TileMask) >> TileShift)
+	, _tiltedHeight(tilted ? yHeight + xWidth - 1 : 0)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
+
+	allocateMemory();
 
-	// TODO. Use SSE2 and more and to optimize fillSummedArea
-	fillSummedArea(buffer, _summedArea, _summedNonZeroArea, _xWidth, yHeight);
+	// Convert a line to the luma buffer right before it is summed
+	auto lineSource = [this, buffer, format](int y) {
+		auto dst = _buffer + y * _xWidth;
+		convertLumaLine(buffer, format, _xWidth, _yHeight, y, dst);
+		return const_cast<const TPixel*>(dst);
+	};
+
+	fillTables(lineSource, _summedArea, _summedNonZeroArea, _xWidth, _yHeight, _layout, _xTiles);
+
+	if (hasTilted())
+	{
+		fillTiltedArea(_buffer, _tiltedArea, _xWidth, _yHeight, _tiltedHeight);
+	}
 }
 
-PixelSum::~PixelSum()
+template<class TPixel>
+BasicPixelSum<TPixel>::~BasicPixelSum()
 {
 	freeMemory();
 }
 
-PixelSum::PixelSum(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const BasicPixelSum& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
+	, _layout(other._layout)
+	, _xTiles(other._xTiles)
+	, _yTiles(other._yTiles)
+	, _tiltedHeight(other._tiltedHeight)
 {
 	allocateMemory();
 
 	// Copy data
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
-	memcpy(_summedArea, other._summedArea, _xWidth * _yHeight * sizeof(unsigned int));
-	memcpy(_summedNonZeroArea, other._summedNonZeroArea, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
+	memcpy(_summedArea, other._summedArea, getTableSize() * sizeof(Sum));
+	memcpy(_summedNonZeroArea, other._summedNonZeroArea, getTableSize() * sizeof(unsigned int));
+
+	if (hasTilted())
+	{
+		memcpy(_tiltedArea, other._tiltedArea, getTiltedTableSize() * sizeof(Sum));
+	}
 }
 
-PixelSum::PixelSum(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(BasicPixelSum&& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
+	, _layout(other._layout)
+	, _xTiles(other._xTiles)
+	, _yTiles(other._yTiles)
+	, _tiltedHeight(other._tiltedHeight)
 {
 	// Move
 	_buffer = other._buffer;
@@ -111,9 +628,13 @@ PixelSum::PixelSum(PixelSum&& other)
 
 	_summedNonZeroArea = other._summedNonZeroArea;
 	other._summedNonZeroArea = nullptr;
+
+	_tiltedArea = other._tiltedArea;
+	other._tiltedArea = nullptr;
 }
 
-PixelSum& PixelSum::operator=(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(const BasicPixelSum& other)
 {
 	assert(&other != this);
 
@@ -123,17 +644,27 @@ PixelSum& PixelSum::operator=(const PixelSum& other)
 	// copy
 	_xWidth = other._xWidth;
 	_yHeight = other._yHeight;
+	_layout = other._layout;
+	_xTiles = other._xTiles;
+	_yTiles = other._yTiles;
+	_tiltedHeight = other._tiltedHeight;
 
 	allocateMemory();
 
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
-	memcpy(_summedArea, other._summedArea, _xWidth * _yHeight * sizeof(unsigned int));
-	memcpy(_summedNonZeroArea, other._summedNonZeroArea, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
+	memcpy(_summedArea, other._summedArea, getTableSize() * sizeof(Sum));
+	memcpy(_summedNonZeroArea, other._summedNonZeroArea, getTableSize() * sizeof(unsigned int));
+
+	if (hasTilted())
+	{
+		memcpy(_tiltedArea, other._tiltedArea, getTiltedTableSize() * sizeof(Sum));
+	}
 
 	return *this;
 }
 
-PixelSum& PixelSum::operator=(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(BasicPixelSum&& other)
 {
 	assert(&other != this);
 
@@ -143,6 +674,10 @@ PixelSum& PixelSum::operator=(PixelSum&& other)
 	// Move
 	_xWidth = other._xWidth;
 	_yHeight = other._yHeight;
+	_layout = other._layout;
+	_xTiles = other._xTiles;
+	_yTiles = other._yTiles;
+	_tiltedHeight = other._tiltedHeight;
 
 	_buffer = other._buffer;
 	other._buffer = nullptr;
@@ -153,10 +688,162 @@ PixelSum& PixelSum::operator=(PixelSum&& other)
 	_summedNonZeroArea = other._summedNonZeroArea;
 	other._summedNonZeroArea = nullptr;
 
+	_tiltedArea = other._tiltedArea;
+	other._tiltedArea = nullptr;
+
 	return *this;
 }
 
-unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	return withTableIndex([&](auto index) {
+		return regionValue(_summedArea, index, x0, y0, x1, y1);
+	});
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	Sum sum = getPixelSum(x0, y0, x1, y1);
+
+	// Result
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+
+	return double(sum) / double(width * height);
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getNonZeroCount(int x0, int y0, int x1, int y1) const
+{
+	return int(withTableIndex([&](auto index) {
+		return regionValue(_summedNonZeroArea, index, x0, y0, x1, y1);
+	}));
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	Sum sum = getPixelSum(x0, y0, x1, y1);
+	unsigned int count = getNonZeroCount(x0, y0, x1, y1);
+
+	// Result
+	return count > 0 ? double(sum) / double(count) : 0.0;
+}
+
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getPolygonSum(const int* xs, const int* ys, int count) const
+{
+	assert(xs != nullptr && ys != nullptr && count > 0);
+
+	std::vector<Span> spans;
+	fillPolygonSpans(xs, ys, count, _yHeight, spans);
+
+	return getSpansSum(_summedArea, spans.data(), int(spans.size()));
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getPolygonAverage(const int* xs, const int* ys, int count) const
+{
+	assert(xs != nullptr && ys != nullptr && count > 0);
+
+	std::vector<Span> spans;
+	fillPolygonSpans(xs, ys, count, _yHeight, spans);
+
+	// Calculate
+	Sum sum = getSpansSum(_summedArea, spans.data(), int(spans.size()));
+	long long area = getPolygonArea(xs, ys, count);
+
+	// Result
+	return area > 0 ? double(sum) / double(area) : 0.0;
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getPolygonNonZeroCount(const int* xs, const int* ys, int count) const
+{
+	assert(xs != nullptr && ys != nullptr && count > 0);
+
+	std::vector<Span> spans;
+	fillPolygonSpans(xs, ys, count, _yHeight, spans);
+
+	return int(getSpansSum(_summedNonZeroArea, spans.data(), int(spans.size())));
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getPolygonNonZeroAverage(const int* xs, const int* ys, int count) const
+{
+	assert(xs != nullptr && ys != nullptr && count > 0);
+
+	std::vector<Span> spans;
+	fillPolygonSpans(xs, ys, count, _yHeight, spans);
+
+	// Calculate
+	Sum sum = getSpansSum(_summedArea, spans.data(), int(spans.size()));
+	unsigned int nonZeroCount = getSpansSum(_summedNonZeroArea, spans.data(), int(spans.size()));
+
+	// Result
+	return nonZeroCount > 0 ? double(sum) / double(nonZeroCount) : 0.0;
+}
+
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getDiscSum(int cx, int cy, int radius) const
+{
+	assert(radius >= 0);
+
+	std::vector<Span> spans;
+	fillDiscSpans(cx, cy, radius, _xWidth, _yHeight, spans);
+
+	return getSpansSum(_summedArea, spans.data(), int(spans.size()));
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getDiscAverage(int cx, int cy, int radius) const
+{
+	assert(radius >= 0);
+
+	std::vector<Span> spans;
+	fillDiscSpans(cx, cy, radius, _xWidth, _yHeight, spans);
+
+	// Calculate
+	Sum sum = getSpansSum(_summedArea, spans.data(), int(spans.size()));
+
+	// Result
+	return double(sum) / double(getDiscArea(radius));
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getDiscNonZeroCount(int cx, int cy, int radius) const
+{
+	assert(radius >= 0);
+
+	std::vector<Span> spans;
+	fillDiscSpans(cx, cy, radius, _xWidth, _yHeight, spans);
+
+	return int(getSpansSum(_summedNonZeroArea, spans.data(), int(spans.size())));
+}
+
+template<class TPixel>
+double BasicPixelSum<TPixel>::getDiscNonZeroAverage(int cx, int cy, int radius) const
+{
+	assert(radius >= 0);
+
+	std::vector<Span> spans;
+	fillDiscSpans(cx, cy, radius, _xWidth, _yHeight, spans);
+
+	// Calculate
+	Sum sum = getSpansSum(_summedArea, spans.data(), int(spans.size()));
+	unsigned int nonZeroCount = getSpansSum(_summedNonZeroArea, spans.data(), int(spans.size()));
+
+	// Result
+	return nonZeroCount > 0 ? double(sum) / double(nonZeroCount) : 0.0;
+}
+
+template<class TPixel>
+template<class TTable, class TIndex>
+TTable BasicPixelSum<TPixel>::regionValue(const TTable* table, TIndex index, int x0, int y0, int x1, int y1) const
 {
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1)
@@ -169,74 +856,337 @@ unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
 	int maxY = rect.y1;
 
 	// Calculate
-	unsigned int B = (minX > 0 && minY > 0) ? _summedArea[(minX - 1) + (minY - 1) * _xWidth] : 0;
-	unsigned int C = minY > 0 ? _summedArea[maxX + (minY - 1) * _xWidth] : 0;
+	TTable B = (minX > 0 && minY > 0) ? table[index(minX - 1, minY - 1)] : 0;
+	TTable C = minY > 0 ? table[index(maxX, minY - 1)] : 0;
 
-	unsigned int A = _summedArea[maxX + maxY * _xWidth];
-	unsigned int D = minX > 0 ? _summedArea[(minX - 1) + maxY * _xWidth] : 0;
+	TTable A = table[index(maxX, maxY)];
+	TTable D = minX > 0 ? table[index(minX - 1, maxY)] : 0;
 
 	// https://en.wikipedia.org/wiki/Summed-area_table
 	return A + B - C - D;
 }
 
-double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+template<class TTable>
+TTable BasicPixelSum<TPixel>::getSpansSum(const TTable* table, const Span* spans, int count) const
 {
-	// Calculate
-	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	return withTableIndex([&](auto index) {
+		TTable sum = 0;
 
-	// Result
-	int width = std::abs(x1 - x0) + 1;
-	int height = std::abs(y1 - y0) + 1;
+		for (int i = 0; i < count; ++i)
+		{
+			int y = spans[i].y;
+			int x0 = std::max(spans[i].x0, 0);
+			int x1 = std::min(spans[i].x1, _xWidth - 1);
 
-	return double(sum) / double(width * height);
+			if (y < 0 || y >= _yHeight || x0 > x1)
+			{
+				continue;
+			}
+
+			// Row of the span is a difference of two lines of the table
+			TTable bottom = table[index(x1, y)] - (x0 > 0 ? table[index(x0 - 1, y)] : 0);
+			TTable top = y > 0 ? table[index(x1, y - 1)] - (x0 > 0 ? table[index(x0 - 1, y - 1)] : 0) : 0;
+
+			sum += bottom - top;
+		}
+
+		return sum;
+	});
 }
 
-int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+void BasicPixelSum<TPixel>::getPixelSums(const Region* regions, int count, Sum* sums) const
 {
+	batchValues(_summedArea, regions, count, sums);
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::getNonZeroCounts(const Region* regions, int count, unsigned int* counts) const
+{
+	batchValues(_summedNonZeroArea, regions, count, counts);
+}
+
+template<class TPixel>
+template<class TTable>
+void BasicPixelSum<TPixel>::batchValues(const TTable* table, const Region* regions, int count, TTable* values) const
+{
+	assert(count >= 0);
+	assert(count == 0 || (regions != nullptr && values != nullptr));
+
+	static const std::vector<unsigned short> hilbertKeys = makeHilbertKeys();
+
+	// Prepare. Cells of 2^cellShift pixels cover the buffer with the grid
+	int cellShift = 0;
+	while (((std::max(_xWidth, _yHeight) - 1) >> cellShift) >= HilbertSide)
+	{
+		++cellShift;
+	}
+
+	auto clamped = [&](const Region& region) {
+		auto rect = utils::Rect(region.x0, region.y0, region.x1, region.y1)
+			.normalized()
+			.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+		return Region{ rect.x0, rect.y0, rect.x1, rect.y1 };
+	};
+
+	// Counting sort by the keys of the centers
+	std::vector<unsigned short> keys(count);
+	std::vector<int> offsets(HilbertSide * HilbertSide + 1, 0);
+
+	for (int i = 0; i < count; ++i)
+	{
+		auto rect = clamped(regions[i]);
+
+		int x = (rect.x0 + rect.x1) >> (cellShift + 1);
+		int y = (rect.y0 + rect.y1) >> (cellShift + 1);
+
+		keys[i] = hilbertKeys[x + y * HilbertSide];
+		++offsets[keys[i] + 1];
+	}
+
+	for (int key = 0; key < HilbertSide * HilbertSide; ++key)
+	{
+		offsets[key + 1] += offsets[key];
+	}
+
+	std::vector<OrderedRegion> ordered(count);
+	for (int i = 0; i < count; ++i)
+	{
+		ordered[offsets[keys[i]]++] = { clamped(regions[i]), i };
+	}
+
+	// Calculate in the order of the curve, corners of the next regions are loaded meanwhile.
+	// Results in the order of the regions
+	withTableIndex([&](auto index) {
+		for (int i = 0; i < count; ++i)
+		{
+			if (i + PrefetchDistance < count)
+			{
+				const auto& next = ordered[i + PrefetchDistance].rect;
+
+				int left = std::max(next.x0 - 1, 0);
+				int top = std::max(next.y0 - 1, 0);
+
+				utils::prefetch(table + index(left, top));
+				utils::prefetch(table + index(next.x1, top));
+				utils::prefetch(table + index(left, next.y1));
+				utils::prefetch(table + index(next.x1, next.y1));
+			}
+
+			int minX = ordered[i].rect.x0;
+			int minY = ordered[i].rect.y0;
+			int maxX = ordered[i].rect.x1;
+			int maxY = ordered[i].rect.y1;
+
+			TTable B = (minX > 0 && minY > 0) ? table[index(minX - 1, minY - 1)] : 0;
+			TTable C = minY > 0 ? table[index(maxX, minY - 1)] : 0;
+
+			TTable A = table[index(maxX, maxY)];
+			TTable D = minX > 0 ? table[index(minX - 1, maxY)] : 0;
+
+			values[ordered[i].index] = A + B - C - D;
+		}
+	});
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::getSummedAreaLine(int y, Sum* sumLine, unsigned int* nonZeroLine) const
+{
+	assert(y >= 0 && y < _yHeight);
+
+	// Row-major is a single part, tiled is a part per tile
+	int step = _layout == Layout::Tiled ? 1 << TileShift : _xWidth;
+
+	for (int x = 0; x < _xWidth; x += step)
+	{
+		int count = std::min(step, _xWidth - x);
+		int offset = tableIndex(x, y);
+
+		if (sumLine != nullptr)
+		{
+			memcpy(sumLine + x, _summedArea + offset, count * sizeof(Sum));
+		}
+
+		if (nonZeroLine != nullptr)
+		{
+			memcpy(nonZeroLine + x, _summedNonZeroArea + offset, count * sizeof(unsigned int));
+		}
+	}
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getRowProfile(int x0, int y0, int x1, int y1, Sum* profile) const
+{
+	return rowProfile(_summedArea, x0, y0, x1, y1, profile);
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getColumnProfile(int x0, int y0, int x1, int y1, Sum* profile) const
+{
+	return columnProfile(_summedArea, x0, y0, x1, y1, profile);
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getRowNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const
+{
+	return rowProfile(_summedNonZeroArea, x0, y0, x1, y1, profile);
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getColumnNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const
+{
+	return columnProfile(_summedNonZeroArea, x0, y0, x1, y1, profile);
+}
+
+template<class TPixel>
+template<class TTable>
+int BasicPixelSum<TPixel>::rowProfile(const TTable* table, int x0, int y0, int x1, int y1, TTable* profile) const
+{
+	assert(profile != nullptr);
+
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1)
 		.normalized()
 		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
 
-	int minX = rect.x0;
-	int minY = rect.y0;
-	int maxX = rect.x1;
-	int maxY = rect.y1;
+	int len = rect.getHeight();
 
-	// Calculate
-	unsigned int B = (minX > 0 && minY > 0) ? _summedNonZeroArea[(minX - 1) + (minY - 1) * _xWidth] : 0;
-	unsigned int C = minY > 0 ? _summedNonZeroArea[maxX + (minY - 1) * _xWidth] : 0;
+	// Sums of the rows of the region up to y, band[i] = SA(x1, y) - SA(x0 - 1, y), y = y0 - 1 + i
+	std::vector<TTable> band(len + 1);
 
-	unsigned int A = _summedNonZeroArea[maxX + maxY * _xWidth];
-	unsigned int D = minX > 0 ? _summedNonZeroArea[(minX - 1) + maxY * _xWidth] : 0;
+	withTableIndex([&](auto index) {
+		for (int i = 0; i <= len; ++i)
+		{
+			int y = rect.y0 - 1 + i;
+			if (y < 0)
+			{
+				band[i] = 0;
+				continue;
+			}
 
-	// https://en.wikipedia.org/wiki/Summed-area_table
-	return A + B - C - D;
+			band[i] = table[index(rect.x1, y)] - (rect.x0 > 0 ? table[index(rect.x0 - 1, y)] : 0);
+		}
+	});
+
+	// Calculate. Differences of adjacent rows
+	differenceLine(band.data() + 1, band.data(), profile, len);
+
+	return len;
 }
 
-double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+template<class TTable>
+int BasicPixelSum<TPixel>::columnProfile(const TTable* table, int x0, int y0, int x1, int y1, TTable* profile) const
 {
-	// Calculate
-	unsigned int sum = getPixelSum(x0, y0, x1, y1);
-	unsigned int count = getNonZeroCount(x0, y0, x1, y1);
+	assert(profile != nullptr);
 
-	// Result
-	return count > 0 ? double(sum) / double(count) : 0.0;
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int len = rect.getWidth();
+
+	// Sums of the columns of the region up to x, band[i] = SA(x, y1) - SA(x, y0 - 1), x = x0 - 1 + i
+	std::vector<TTable> band(len + 1);
+
+	band[0] = 0;
+	if (rect.x0 > 0)
+	{
+		band[0] = table[tableIndex(rect.x0 - 1, rect.y1)] - (rect.y0 > 0 ? table[tableIndex(rect.x0 - 1, rect.y0 - 1)] : 0);
+	}
+
+	// Lines of the tables are contiguous up to the end of a tile
+	for (int x = rect.x0; x <= rect.x1; )
+	{
+		int count = rect.x1 - x + 1;
+		if (_layout == Layout::Tiled)
+		{
+			count = std::min(count, (1 << TileShift) - (x & TileMask));
+		}
+
+		const auto bottom = table + tableIndex(x, rect.y1);
+		auto dst = band.data() + 1 + (x - rect.x0);
+
+		if (rect.y0 > 0)
+		{
+			differenceLine(bottom, table + tableIndex(x, rect.y0 - 1), dst, count);
+		}
+		else
+		{
+			memcpy(dst, bottom, count * sizeof(TTable));
+		}
+
+		x += count;
+	}
+
+	// Calculate. Differences of adjacent columns
+	differenceLine(band.data() + 1, band.data(), profile, len);
+
+	return len;
+}
+
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getTiltedPixelSum(int x, int y, int width, int height) const
+{
+	assert(hasTilted());
+	assert(width >= 0 && height >= 0);
+
+	// Corners: top, right, left, bottom
+	Sum A = tiltedAt(x, y);
+	Sum B = tiltedAt(x + width, y + width);
+	Sum C = tiltedAt(x - height, y + height);
+	Sum D = tiltedAt(x + width - height, y + width + height);
+
+	return A + D - B - C;
 }
 
-void PixelSum::allocateMemory()
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::tiltedAt(int x, int y) const
+{
+	return tiltedValue(_tiltedArea, _xWidth, _tiltedHeight, x, y);
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getTiltedTableSize() const
+{
+	return _xWidth * _tiltedHeight;
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getTableSize() const
+{
+	if (_layout == Layout::Tiled)
+	{
+		return (_xTiles * _yTiles) << (TileShift * 2);
+	}
+
+	return _xWidth * _yHeight;
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::allocateMemory()
 {
 	// TODO. Use PixelSum allocator and to cache mem blocks. to Optimization 30-40% at 4k
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	_summedArea = new unsigned int[_xWidth * _yHeight];
-	_summedNonZeroArea = new unsigned int[_xWidth * _yHeight];
+	_buffer = new TPixel[_xWidth * _yHeight];
+	_summedArea = new Sum[getTableSize()];
+	_summedNonZeroArea = new unsigned int[getTableSize()];
+	_tiltedArea = _tiltedHeight > 0 ? new Sum[getTiltedTableSize()] : nullptr;
 }
 
-void PixelSum::freeMemory()
+template<class TPixel>
+void BasicPixelSum<TPixel>::freeMemory()
 {
+	delete[] _tiltedArea;
 	delete[] _summedNonZeroArea;
 	delete[] _summedArea;
 	delete[] _buffer;
 }
 
+template class BasicPixelSum<unsigned char>;
+template class BasicPixelSum<unsigned short>;
+template class BasicPixelSum<float>;
+
 } // End integral
\ No newline at end of file
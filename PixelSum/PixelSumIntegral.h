@@ -1,11 +1,55 @@
 #pragma once
 
 #include "Common.h"
+#include "PixelTraits.h"
 
 namespace integral {
 
+// Layouts and formats shared by all pixel types
+class PixelSumBase
+{
+public:
+	// Summed area tables memory layout
+	enum class Layout
+	{
+		RowMajor,
+		Tiled
+	};
+
+	// Multi-channel buffer formats. Alpha is ignored
+	enum class Format
+	{
+		RGB,
+		RGBA,
+		BGR,
+		BGRA,
+		PlanarRGB	// Three planes of xWidth * yHeight
+	};
+
+	// Pixels x0..x1 of line y of a shape
+	struct Span
+	{
+		int y;
+		int x0;
+		int x1;
+	};
+
+	// Query of a batch, same coordinates as getPixelSum
+	struct Region
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+	};
+
+	static const int TileShift = 5;
+	static const int TileSize = 1 << TileShift;
+	static const int TileMask = TileSize - 1;
+};
+
  /**
- * Integral image implementation for providing fast region queries from an 8-bit pixel buffer.
+ * Integral image implementation for providing fast region queries from a pixel buffer.
  * Note: all coordinates are *inclusive* and clamped internally to the borders
  * of the buffer by the implementation.
  *
@@ -21,39 +65,216 @@ namespace integral {
  * https://en.wikipedia.org/wiki/Summed-area_table
  *
  * Long preparation and takes more memory.
- * Memory: xWidth * yHeight * (sizeof(uint8) + sizeof(uint32) * 2)
+ * Memory: xWidth * yHeight * (sizeof(Pixel) + sizeof(Sum) + sizeof(uint32))
+ *
+ * Pixels are uint8, uint16 or float. Sums are uint32, uint64 or double, see utils::PixelTraits.
+ * Integer tables are exact, a query is a modular A + B - C - D. Float tables are summed
+ * in double, the error of a query grows with the sum of the whole table (~1e-16 of it),
+ * not with the size of the region.
+ *
+ * Tables are row-major by default. With Layout::Tiled they are split into
+ * 32x32 tiles (one 4 KiB page per tile) so the corners of small and clustered
+ * rectangles share pages and cache lines. Width and height of the tables are
+ * padded up to a multiple of the tile size. The layout is chosen once per query,
+ * row-major corners are not indexed through the tiles.
+ *
+ * Optionally a rotated summed area table (RSAT) is built for 45 degrees tilted
+ * rectangles. See getTiltedPixelSum. It is always row-major and has xWidth - 1
+ * extra rows below the buffer for triangles that cross the bottom border.
+ * Memory: xWidth * (yHeight + xWidth - 1) * sizeof(Sum)
+ * Lienhart, Maydt. An extended set of Haar-like features for rapid object detection. ICIP 2002
+ *
+ * Multi-channel buffers are converted to luma, Y = (77 R + 150 G + 29 B + 128) >> 8,
+ * line by line while the tables are built, without a temporary buffer.
+ *
+ * Batch queries are evaluated in the Hilbert order of the region centers on a 64x64 grid over
+ * the buffer, so nearby regions load their corners one after another while the lines and pages
+ * are still cached, and the corners of the next regions are prefetched. Results are in the
+ * order of the regions. Memory: 24 bytes per region of a batch
  */
-class PIXEL_SUM_API PixelSum
+template<class TPixel>
+class PIXEL_SUM_API BasicPixelSum : public PixelSumBase
 {
+public:
+	typedef TPixel Pixel;
+	typedef typename utils::PixelTraits<TPixel>::Sum Sum;
+
 public:
 	// Contrustors/Destructor
-	PixelSum(const unsigned char* buffer, int xWidth, int yHeight);
-	~PixelSum();
-	PixelSum(const PixelSum& other);
-	PixelSum(PixelSum&& other);
+	BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight, Layout layout = Layout::RowMajor, bool tilted = false);
+	BasicPixelSum(const TPixel* buffer, Format format, int xWidth, int yHeight, Layout layout = Layout::RowMajor, bool tilted = false);
+	~BasicPixelSum();
+	BasicPixelSum(const BasicPixelSum& other);
+	BasicPixelSum(BasicPixelSum&& other);
 
 	// Operators
-	PixelSum& operator=(const PixelSum& other);
-	PixelSum& operator=(PixelSum&& other);
+	BasicPixelSum& operator=(const BasicPixelSum& other);
+	BasicPixelSum& operator=(BasicPixelSum&& other);
 
 	// Methods
-	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	Sum getPixelSum(int x0, int y0, int x1, int y1) const;
 	double getPixelAverage(int x0, int y0, int x1, int y1) const;
 
 	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
 	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
 
+	// Sum of a 45 degrees tilted rectangle. Top corner is (x, y), width goes down-right,
+	// height goes down-left. It covers 2 * width * height pixels under the corner,
+	// pixels outside of the buffer are zero. Requires tilted tables
+	Sum getTiltedPixelSum(int x, int y, int width, int height) const;
+
+	// Polygon and disc regions. A pixel is inside if its center is inside of the shape or on the border,
+	// polygons can be concave or self-intersecting (even-odd rule). The lines of the shape inside of
+	// the buffer are split into spans, a span is O(1), so a query is O(lines * vertices) for polygons
+	// and O(lines) for discs. Pixels outside of the buffer are ignored, averages are divided by the
+	// unclamped pixel count, which walks all lines of the shape without reading the tables
+	Sum getPolygonSum(const int* xs, const int* ys, int count) const;
+	double getPolygonAverage(const int* xs, const int* ys, int count) const;
+	int getPolygonNonZeroCount(const int* xs, const int* ys, int count) const;
+	double getPolygonNonZeroAverage(const int* xs, const int* ys, int count) const;
+
+	Sum getDiscSum(int cx, int cy, int radius) const;
+	double getDiscAverage(int cx, int cy, int radius) const;
+	int getDiscNonZeroCount(int cx, int cy, int radius) const;
+	double getDiscNonZeroAverage(int cx, int cy, int radius) const;
+
+	// Same as getPixelSum (getNonZeroCount) of every region, in the same order
+	void getPixelSums(const Region* regions, int count, Sum* sums) const;
+	void getNonZeroCounts(const Region* regions, int count, unsigned int* counts) const;
+
+	// Line y of the summed area tables, SA(0..xWidth - 1, y). Either destination can be nullptr
+	void getSummedAreaLine(int y, Sum* sumLine, unsigned int* nonZeroLine) const;
+
+	// Sums (counts) of the rows or the columns of the clamped region, top to bottom or left to right.
+	// Return the length of the profile, the height or the width of the region
+	int getRowProfile(int x0, int y0, int x1, int y1, Sum* profile) const;
+	int getColumnProfile(int x0, int y0, int x1, int y1, Sum* profile) const;
+
+	int getRowNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const;
+	int getColumnNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const;
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+	const TPixel* getBuffer() const
+	{
+		return _buffer;
+	}
+
+	// Raw table, indexed as SA(x, y) = x + y * xWidth for Layout::RowMajor only. A Tiled
+	// table is padded to whole tiles, use the region queries or getSummedAreaLine instead
+	const Sum* getSummedArea() const
+	{
+		return _summedArea;
+	}
+
+	Layout getLayout() const
+	{
+		return _layout;
+	}
+
+	bool hasTilted() const
+	{
+		return _tiltedArea != nullptr;
+	}
+
 private:
+	// Offsets of SA(x, y) in the tables of each layout
+	struct RowMajorIndex
+	{
+		int xWidth;
+
+		int operator()(int x, int y) const
+		{
+			return x + y * xWidth;
+		}
+	};
+
+	struct TiledIndex
+	{
+		int xTiles;
+
+		int operator()(int x, int y) const
+		{
+			int tile = (x >> TileShift) + (y >> TileShift) * xTiles;
+			return (tile << (TileShift * 2)) + ((y & TileMask) << TileShift) + (x & TileMask);
+		}
+	};
+
+	int tableIndex(int x, int y) const
+	{
+		return _layout == Layout::RowMajor ? RowMajorIndex{ _xWidth }(x, y) : TiledIndex{ _xTiles }(x, y);
+	}
+
+	// Calls func(index) with the index of the layout. The layout is chosen once per query,
+	// batch or shape, so the corner lookups of row-major tables are plain x + y * xWidth
+	template<class TFunction>
+	auto withTableIndex(TFunction func) const
+	{
+		if (_layout == Layout::RowMajor)
+		{
+			return func(RowMajorIndex{ _xWidth });
+		}
+
+		return func(TiledIndex{ _xTiles });
+	}
+
+	// A + B - C - D of the clamped region
+	template<class TTable, class TIndex>
+	TTable regionValue(const TTable* table, TIndex index, int x0, int y0, int x1, int y1) const;
+
+	int getTableSize() const;
+	int getTiltedTableSize() const;
+
+	Sum tiltedAt(int x, int y) const;
+
+	// Sum of the spans clamped to the buffer
+	template<class TTable>
+	TTable getSpansSum(const TTable* table, const Span* spans, int count) const;
+
+	// Batch of the sums or of the non-zero counts
+	template<class TTable>
+	void batchValues(const TTable* table, const Region* regions, int count, TTable* values) const;
+
+	// Profiles of the sums or of the non-zero counts
+	template<class TTable>
+	int rowProfile(const TTable* table, int x0, int y0, int x1, int y1, TTable* profile) const;
+	template<class TTable>
+	int columnProfile(const TTable* table, int x0, int y0, int x1, int y1, TTable* profile) const;
+
 	void allocateMemory();
 	void freeMemory();
 
 private:
-	unsigned char* _buffer;
-	unsigned int* _summedArea;
+	TPixel* _buffer;
+	Sum* _summedArea;
 	unsigned int* _summedNonZeroArea;
+	Sum* _tiltedArea;
 
 	int _xWidth;
 	int _yHeight;
+
+	Layout _layout;
+	int _xTiles;
+	int _yTiles;
+	int _tiltedHeight;
 };
 
+typedef BasicPixelSum<unsigned char> PixelSum;
+typedef BasicPixelSum<unsigned short> PixelSum16;
+typedef BasicPixelSum<float> PixelSumFloat;
+
+// Instantiated in the library
+extern template class BasicPixelSum<unsigned char>;
+extern template class BasicPixelSum<unsigned short>;
+extern template class BasicPixelSum<float>;
+
 } // End integral
\ No newline at end of file
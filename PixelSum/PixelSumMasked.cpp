@@ -0,0 +1,223 @@
+#include "PixelSumMasked.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace masked {
+
+void maskedRowSums(const unsigned char* src, const unsigned char* mask, unsigned int* rowSum, unsigned int* rowCount, int len)
+{
+#ifdef __SSE2__
+	maskedRowSumsSSE(src, mask, rowSum, rowCount, len);
+#else
+	unsigned int sum = 0;
+	unsigned int count = 0;
+
+	for (int x = 0; x < len; ++x)
+	{
+		bool masked = mask[x] != 0;
+
+		sum += masked ? src[x] : 0;
+		count += masked ? 1 : 0;
+
+		rowSum[x] = sum;
+		rowCount[x] = count;
+	}
+#endif // __SSE2__
+}
+
+void addLine(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	sumArraySSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] + src1[x];
+	}
+#endif // __SSE2__
+}
+
+// SA(x, y) = rowSum(x, y) + SA(x, y - 1) for both tables in one pass
+void fillMaskedTables(const unsigned char* buffer, const unsigned char* mask, unsigned int* summedArea, unsigned int* summedMaskArea, int xWidth, int yHeight)
+{
+	for (int y = 0; y < yHeight; ++y)
+	{
+		int offset = y * xWidth;
+
+		auto sum = summedArea + offset;
+		auto count = summedMaskArea + offset;
+
+		maskedRowSums(buffer + offset, mask + offset, sum, count, xWidth);
+
+		if (y > 0)
+		{
+			addLine(sum, sum - xWidth, sum, xWidth);
+			addLine(count, count - xWidth, count, xWidth);
+		}
+	}
+}
+
+PixelSum::PixelSum(const unsigned char* buffer, const unsigned char* mask, int xWidth, int yHeight)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
+
+	allocateMemory();
+
+	// Copy
+	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(unsigned char));
+
+	setMask(mask);
+}
+
+PixelSum::~PixelSum()
+{
+	freeMemory();
+}
+
+PixelSum::PixelSum(const PixelSum& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_summedArea, other._summedArea, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_summedMaskArea, other._summedMaskArea, _xWidth * _yHeight * sizeof(unsigned int));
+}
+
+PixelSum::PixelSum(PixelSum&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+{
+	// Move
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_summedArea = other._summedArea;
+	other._summedArea = nullptr;
+
+	_summedMaskArea = other._summedMaskArea;
+	other._summedMaskArea = nullptr;
+}
+
+PixelSum& PixelSum::operator=(const PixelSum& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+
+	allocateMemory();
+
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_summedArea, other._summedArea, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_summedMaskArea, other._summedMaskArea, _xWidth * _yHeight * sizeof(unsigned int));
+
+	return *this;
+}
+
+PixelSum& PixelSum::operator=(PixelSum&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_summedArea = other._summedArea;
+	other._summedArea = nullptr;
+
+	_summedMaskArea = other._summedMaskArea;
+	other._summedMaskArea = nullptr;
+
+	return *this;
+}
+
+void PixelSum::setMask(const unsigned char* mask)
+{
+	assert(mask != nullptr);
+
+	fillMaskedTables(_buffer, mask, _summedArea, _summedMaskArea, _xWidth, _yHeight);
+}
+
+unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	return regionValue(_summedArea, x0, y0, x1, y1);
+}
+
+int PixelSum::getMaskCount(int x0, int y0, int x1, int y1) const
+{
+	return int(regionValue(_summedMaskArea, x0, y0, x1, y1));
+}
+
+double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	int count = getMaskCount(x0, y0, x1, y1);
+
+	// Result
+	return count > 0 ? double(sum) / double(count) : 0.0;
+}
+
+unsigned int PixelSum::regionValue(const unsigned int* table, int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minX = rect.x0;
+	int minY = rect.y0;
+	int maxX = rect.x1;
+	int maxY = rect.y1;
+
+	// Calculate
+	unsigned int B = (minX > 0 && minY > 0) ? table[(minX - 1) + (minY - 1) * _xWidth] : 0;
+	unsigned int C = minY > 0 ? table[maxX + (minY - 1) * _xWidth] : 0;
+
+	unsigned int A = table[maxX + maxY * _xWidth];
+	unsigned int D = minX > 0 ? table[(minX - 1) + maxY * _xWidth] : 0;
+
+	// https://en.wikipedia.org/wiki/Summed-area_table
+	return A + B - C - D;
+}
+
+void PixelSum::allocateMemory()
+{
+	_buffer = new unsigned char[_xWidth * _yHeight];
+	_summedArea = new unsigned int[_xWidth * _yHeight];
+	_summedMaskArea = new unsigned int[_xWidth * _yHeight];
+}
+
+void PixelSum::freeMemory()
+{
+	delete[] _summedMaskArea;
+	delete[] _summedArea;
+	delete[] _buffer;
+}
+
+} // End masked
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Common.h"
+
+namespace masked {
+
+/**
+ * Integral image implementation for providing region queries of an 8-bit pixel buffer under a mask.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getPixelSum(4,8,7,10) gets the sum of the pixels of a 4x3 region where
+ * mask != 0, top left corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ * If the resulting region after clamping is empty, the return value for all
+ * functions should be 0.
+ *
+ * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * O(1) solution is made. Two summed area tables: of the pixels under the mask and of the
+ * count of the mask pixels. Both are built in one pass over the buffer and the mask,
+ * a line is masked and prefix summed by SSE. The buffer is copied once, setMask rebuilds
+ * only the tables, so a mask is swapped without a copy of the image.
+ *
+ * Memory: xWidth * yHeight * (sizeof(uint8) + sizeof(uint32) * 2)
+ */
+class PIXEL_SUM_API PixelSum
+{
+public:
+	// Contrustors/Destructor
+	PixelSum(const unsigned char* buffer, const unsigned char* mask, int xWidth, int yHeight);
+	~PixelSum();
+	PixelSum(const PixelSum& other);
+	PixelSum(PixelSum&& other);
+
+	// Operators
+	PixelSum& operator=(const PixelSum& other);
+	PixelSum& operator=(PixelSum&& other);
+
+	// Methods
+	void setMask(const unsigned char* mask);
+
+	// Sum of the pixels where mask != 0
+	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+
+	// Count of the pixels where mask != 0
+	int getMaskCount(int x0, int y0, int x1, int y1) const;
+
+	// Average of the pixels where mask != 0. Zero if there are none
+	double getPixelAverage(int x0, int y0, int x1, int y1) const;
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	unsigned int regionValue(const unsigned int* table, int x0, int y0, int x1, int y1) const;
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned char* _buffer;
+	unsigned int* _summedArea;
+	unsigned int* _summedMaskArea;
+
+	int _xWidth;
+	int _yHeight;
+};
+
+} // End masked
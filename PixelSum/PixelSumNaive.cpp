@@ -9,7 +9,8 @@
 
 namespace naive {
 
-PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight)
 	: _xWidth(xWidth)
 	, _yHeight(yHeight)
 {
@@ -18,25 +19,28 @@ PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
 	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
 
 	// Copy
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(TPixel));
 }
 
-PixelSum::~PixelSum()
+template<class TPixel>
+BasicPixelSum<TPixel>::~BasicPixelSum()
 {
 	delete[] _buffer;
 }
 
-PixelSum::PixelSum(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const BasicPixelSum& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
 {
 	// Copy
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
 }
 
-PixelSum::PixelSum(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(BasicPixelSum&& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
 {
@@ -45,7 +49,8 @@ PixelSum::PixelSum(PixelSum&& other)
 	other._buffer = nullptr;
 }
 
-PixelSum& PixelSum::operator=(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(const BasicPixelSum& other)
 {
 	assert(&other != this);
 
@@ -56,13 +61,14 @@ PixelSum& PixelSum::operator=(const PixelSum& other)
 	_xWidth = other._xWidth;
 	_yHeight = other._yHeight;
 
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
 
 	return *this;
 }
 
-PixelSum& PixelSum::operator=(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(BasicPixelSum&& other)
 {
 	assert(&other != this);
 
@@ -79,13 +85,14 @@ PixelSum& PixelSum::operator=(PixelSum&& other)
 	return *this;
 }
 
-unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getPixelSum(int x0, int y0, int x1, int y1) const
 {
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1).normalized();
 
 	// Calculate
-	unsigned int sum = 0;
+	Sum sum = 0;
 
 	for (int y = rect.y0; y <= rect.y1; ++y)
 	for (int x = rect.x0; x <= rect.x1; ++x)
@@ -97,10 +104,11 @@ unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
 	return sum;
 }
 
-double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+double BasicPixelSum<TPixel>::getPixelAverage(int x0, int y0, int x1, int y1) const
 {
 	// Calculate
-	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	Sum sum = getPixelSum(x0, y0, x1, y1);
 
 	// Result
 	int width = std::abs(x1 - x0) + 1;
@@ -109,7 +117,8 @@ double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
 	return double(sum) / double(width * height);
 }
 
-int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+int BasicPixelSum<TPixel>::getNonZeroCount(int x0, int y0, int x1, int y1) const
 {
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1).normalized();
@@ -120,7 +129,7 @@ int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
 	for (int y = rect.y0; y <= rect.y1; ++y)
 	for (int x = rect.x0; x <= rect.x1; ++x)
 	{
-		unsigned char value = at(x, y);
+		TPixel value = at(x, y);
 		count += value != 0 ? 1 : 0;
 	}
 
@@ -128,19 +137,20 @@ int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
 	return count;
 }
 
-double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+double BasicPixelSum<TPixel>::getNonZeroAverage(int x0, int y0, int x1, int y1) const
 {
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1).normalized();
 
 	// Calculate
-	unsigned int sum = 0;
+	Sum sum = 0;
 	unsigned int count = 0;
 	
 	for (int y = rect.y0; y <= rect.y1; ++y)
 	for (int x = rect.x0; x <= rect.x1; ++x)
 	{
-		unsigned char value = at(x, y);
+		TPixel value = at(x, y);
 
 		sum += value;
 		count += value != 0 ? 1 : 0;
@@ -150,5 +160,8 @@ double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
 	return count !=0 ? double(sum) / double(count) : 0.0;
 }
 
+template class BasicPixelSum<unsigned char>;
+template class BasicPixelSum<unsigned short>;
+template class BasicPixelSum<float>;
 
 } // End v0
\ No newline at end of file
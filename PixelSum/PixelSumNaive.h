@@ -1,11 +1,12 @@
 #pragma once
 
 #include "Common.h"
+#include "PixelTraits.h"
 
 namespace naive {
 
 /**
- * Naive implementation for providing region queries from an 8-bit pixel buffer.
+ * Naive implementation for providing region queries from a pixel buffer.
  * Note: all coordinates are *inclusive* and clamped internally to the borders
  * of the buffer by the implementation.
  *
@@ -16,22 +17,29 @@ namespace naive {
  * functions should be 0.
  *
  * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * Pixels are uint8, uint16 or float. Sums are uint32, uint64 or double, see utils::PixelTraits.
  */
-class PIXEL_SUM_API PixelSum
+template<class TPixel>
+class PIXEL_SUM_API BasicPixelSum
 {
+public:
+	typedef TPixel Pixel;
+	typedef typename utils::PixelTraits<TPixel>::Sum Sum;
+
 public:
 	// Contrustors/Destructor
-	PixelSum(const unsigned char* buffer, int xWidth, int yHeight);
-	~PixelSum();
-	PixelSum(const PixelSum& other);
-	PixelSum(PixelSum&& other);
+	BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight);
+	~BasicPixelSum();
+	BasicPixelSum(const BasicPixelSum& other);
+	BasicPixelSum(BasicPixelSum&& other);
 
 	// Operators
-	PixelSum& operator=(const PixelSum& other);
-	PixelSum& operator=(PixelSum&& other);
+	BasicPixelSum& operator=(const BasicPixelSum& other);
+	BasicPixelSum& operator=(BasicPixelSum&& other);
 
 	// Methods
-	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	Sum getPixelSum(int x0, int y0, int x1, int y1) const;
 	double getPixelAverage(int x0, int y0, int x1, int y1) const;
 
 	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
@@ -47,15 +55,24 @@ public:
 			y < _yHeight;
 	}
 
-	unsigned char at(int x, int y) const
+	TPixel at(int x, int y) const
 	{
-		return inBound(x, y) ? _buffer[x + y * _xWidth] : 0;
+		return inBound(x, y) ? _buffer[x + y * _xWidth] : TPixel(0);
 	}
 
 private:
-	unsigned char* _buffer;
+	TPixel* _buffer;
 	int _xWidth;
 	int _yHeight;
 };
 
+typedef BasicPixelSum<unsigned char> PixelSum;
+typedef BasicPixelSum<unsigned short> PixelSum16;
+typedef BasicPixelSum<float> PixelSumFloat;
+
+// Instantiated in the library
+extern template class BasicPixelSum<unsigned char>;
+extern template class BasicPixelSum<unsigned short>;
+extern template class BasicPixelSum<float>;
+
 } // End v0
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdlib.h>		// malloc, free, rand
 #include <assert.h>
 #include <algorithm>	// min, max, clamp
+#include <atomic>
 
 #include "Utils.h"
 
@@ -11,43 +12,216 @@
 
 namespace naivev2 {
 
-PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
+// dst += src
+template<class TPixel, class TSum>
+void accumulateLine(const TPixel* src, TSum* dst, int len)
+{
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] += src[x];
+	}
+}
+
+void accumulateLine(const unsigned char* src, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	multiplyAddU8SSE(src, 1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] += src[x];
+	}
+#endif // __SSE2__
+}
+
+// dst += src != 0 ? 1 : 0
+template<class TPixel>
+void accumulateNonZeroLine(const TPixel* src, unsigned int* dst, int len)
+{
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] += src[x] != 0 ? 1 : 0;
+	}
+}
+
+void accumulateNonZeroLine(const unsigned char* src, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	addNonZeroU8SSE(src, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] += src[x] != 0 ? 1 : 0;
+	}
+#endif // __SSE2__
+}
+
+// Sums of all pixel types fit 64 bits
+inline unsigned long long toBits(unsigned int sum) { return sum; }
+inline unsigned long long toBits(unsigned long long sum) { return sum; }
+inline unsigned long long toBits(double sum) { unsigned long long bits; memcpy(&bits, &sum, sizeof(bits)); return bits; }
+
+inline void fromBits(unsigned long long bits, unsigned int& sum) { sum = (unsigned int)bits; }
+inline void fromBits(unsigned long long bits, unsigned long long& sum) { sum = bits; }
+inline void fromBits(unsigned long long bits, double& sum) { memcpy(&sum, &bits, sizeof(sum)); }
+
+struct QueryCache
+{
+	// Seqlock, odd while written. Fields are relaxed atomics, ordered by the version
+	struct Slot
+	{
+		std::atomic<unsigned int> version;
+		std::atomic<unsigned int> generation;
+
+		std::atomic<int> x0;
+		std::atomic<int> y0;
+		std::atomic<int> x1;
+		std::atomic<int> y1;
+
+		std::atomic<unsigned long long> sum;
+		std::atomic<unsigned int> count;
+	};
+
+	Slot* slots;
+	int size;
+
+	// Slots of older generations are empty
+	std::atomic<unsigned int> generation;
+
+	mutable std::atomic<long long> hits;
+	mutable std::atomic<long long> misses;
+
+	explicit QueryCache(int entries)
+		: size(1)
+		, generation(1)
+		, hits(0)
+		, misses(0)
+	{
+		while (size < entries)
+		{
+			size *= 2;
+		}
+
+		slots = new Slot[size];
+		for (int i = 0; i < size; ++i)
+		{
+			slots[i].version.store(0, std::memory_order_relaxed);
+			slots[i].generation.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	~QueryCache()
+	{
+		delete[] slots;
+	}
+
+	Slot& getSlot(int x0, int y0, int x1, int y1) const
+	{
+		unsigned int hash = unsigned(x0) * 0x9E3779B1u ^ unsigned(y0) * 0x85EBCA77u ^ unsigned(x1) * 0xC2B2AE3Du ^ unsigned(y1) * 0x27D4EB2Fu;
+		hash ^= hash >> 15;
+
+		return slots[hash & (size - 1)];
+	}
+
+	bool find(int x0, int y0, int x1, int y1, unsigned long long& sum, unsigned int& count) const
+	{
+		auto& slot = getSlot(x0, y0, x1, y1);
+
+		unsigned int version = slot.version.load(std::memory_order_acquire);
+		bool found = (version & 1) == 0
+			&& slot.generation.load(std::memory_order_relaxed) == generation.load(std::memory_order_relaxed)
+			&& slot.x0.load(std::memory_order_relaxed) == x0
+			&& slot.y0.load(std::memory_order_relaxed) == y0
+			&& slot.x1.load(std::memory_order_relaxed) == x1
+			&& slot.y1.load(std::memory_order_relaxed) == y1;
+
+		sum = slot.sum.load(std::memory_order_relaxed);
+		count = slot.count.load(std::memory_order_relaxed);
+
+		// Not written meanwhile
+		std::atomic_thread_fence(std::memory_order_acquire);
+		found = found && slot.version.load(std::memory_order_relaxed) == version;
+
+		(found ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+		return found;
+	}
+
+	// 'scanGeneration' is loaded before the scan, a result of an invalidated generation stays empty
+	void insert(unsigned int scanGeneration, int x0, int y0, int x1, int y1, unsigned long long sum, unsigned int count)
+	{
+		auto& slot = getSlot(x0, y0, x1, y1);
+
+		// Skip the slot if another writer has it
+		unsigned int version = slot.version.load(std::memory_order_relaxed);
+		if ((version & 1) != 0 || !slot.version.compare_exchange_strong(version, version + 1, std::memory_order_acquire))
+		{
+			return;
+		}
+
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot.generation.store(scanGeneration, std::memory_order_relaxed);
+		slot.x0.store(x0, std::memory_order_relaxed);
+		slot.y0.store(y0, std::memory_order_relaxed);
+		slot.x1.store(x1, std::memory_order_relaxed);
+		slot.y1.store(y1, std::memory_order_relaxed);
+		slot.sum.store(sum, std::memory_order_relaxed);
+		slot.count.store(count, std::memory_order_relaxed);
+
+		slot.version.store(version + 2, std::memory_order_release);
+	}
+};
+
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight)
 	: _xWidth(xWidth)
 	, _yHeight(yHeight)
+	, _cache(nullptr)
 {
 	assert(buffer != nullptr);
 	assert(xWidth > 0 && yHeight > 0);
 	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
 
 	// TODO. Use PixelSum allocator and to cache mem blocks
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	memcpy(_buffer, buffer, xWidth * yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, buffer, xWidth * yHeight * sizeof(TPixel));
 }
 
-PixelSum::~PixelSum()
+template<class TPixel>
+BasicPixelSum<TPixel>::~BasicPixelSum()
 {
 	delete[] _buffer;
+	delete _cache;
 }
 
-PixelSum::PixelSum(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(const BasicPixelSum& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
+	, _cache(nullptr)
 {
 	// Copy
-	_buffer = new unsigned char[_xWidth * _yHeight];
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
+
+	setCacheSize(other.getCacheSize());
 }
 
-PixelSum::PixelSum(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>::BasicPixelSum(BasicPixelSum&& other)
 	: _xWidth(other._xWidth)
 	, _yHeight(other._yHeight)
 {
 	// Move
 	_buffer = other._buffer;
 	other._buffer = nullptr;
+
+	_cache = other._cache;
+	other._cache = nullptr;
 }
 
-PixelSum& PixelSum::operator=(const PixelSum& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(const BasicPixelSum& other)
 {
 	assert(&other != this);
 
@@ -58,13 +232,16 @@ PixelSum& PixelSum::operator=(const PixelSum& other)
 	_xWidth = other._xWidth;
 	_yHeight = other._yHeight;
 
-	_buffer = (unsigned char*)malloc(_xWidth * _yHeight * sizeof(unsigned char));
-	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	_buffer = new TPixel[_xWidth * _yHeight];
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(TPixel));
+
+	setCacheSize(other.getCacheSize());
 
 	return *this;
 }
 
-PixelSum& PixelSum::operator=(PixelSum&& other)
+template<class TPixel>
+BasicPixelSum<TPixel>& BasicPixelSum<TPixel>::operator=(BasicPixelSum&& other)
 {
 	assert(&other != this);
 
@@ -78,11 +255,25 @@ PixelSum& PixelSum::operator=(PixelSum&& other)
 	_buffer = other._buffer;
 	other._buffer = nullptr;
 
+	delete _cache;
+	_cache = other._cache;
+	other._cache = nullptr;
+
 	return *this;
 }
 
-unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+typename BasicPixelSum<TPixel>::Sum BasicPixelSum<TPixel>::getPixelSum(int x0, int y0, int x1, int y1) const
 {
+	if (_cache != nullptr)
+	{
+		Sum sum;
+		unsigned int count;
+		getSumAndCount(x0, y0, x1, y1, sum, count);
+
+		return sum;
+	}
+
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1)
 		.normalized()
@@ -91,7 +282,7 @@ unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
 	int rectWidth = rect.getWidth();
 
 	// Calculate
-	int sum = 0;
+	Sum sum = 0;
 
 	for (int y = rect.y0; y <= rect.y1; ++y)
 	{
@@ -111,10 +302,11 @@ unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
 	return sum;
 }
 
-double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+double BasicPixelSum<TPixel>::getPixelAverage(int x0, int y0, int x1, int y1) const
 {
 	// Calculate
-	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	Sum sum = getPixelSum(x0, y0, x1, y1);
 
 	// Result
 	int width = std::abs(x1 - x0) + 1;
@@ -123,8 +315,18 @@ double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
 	return double(sum) / double(width * height);
 }
 
-int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+int BasicPixelSum<TPixel>::getNonZeroCount(int x0, int y0, int x1, int y1) const
 {
+	if (_cache != nullptr)
+	{
+		Sum sum;
+		unsigned int count;
+		getSumAndCount(x0, y0, x1, y1, sum, count);
+
+		return count;
+	}
+
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1)
 		.normalized()
@@ -145,7 +347,7 @@ int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
 #else
 		for (int x = rect.x0; x <= rect.x1; ++x)
 		{
-			unsigned char value = _buffer[x + y * _xWidth];
+			TPixel value = _buffer[x + y * _xWidth];
 			count += value != 0 ? 1 : 0;
 		}
 #endif // __AVX2__
@@ -154,8 +356,23 @@ int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
 	return count;
 }
 
-double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+template<class TPixel>
+double BasicPixelSum<TPixel>::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	Sum sum;
+	unsigned int count;
+	getSumAndCount(x0, y0, x1, y1, sum, count);
+
+	// Result
+	return count != 0 ? double(sum) / double(count) : 0.0;
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getRowProfile(int x0, int y0, int x1, int y1, Sum* profile) const
 {
+	assert(profile != nullptr);
+
 	// Prepare
 	auto rect = utils::Rect(x0, y0, x1, y1)
 		.normalized()
@@ -164,8 +381,162 @@ double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
 	int rectWidth = rect.getWidth();
 
 	// Calculate
-	unsigned int sum = 0;
-	unsigned int count = 0;
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		auto ptr = _buffer + rect.x0 + y * _xWidth;
+
+#ifdef __SSE2__
+		profile[y - rect.y0] = sumSSE(ptr, rectWidth);
+#else
+		Sum sum = 0;
+		for (int x = 0; x < rectWidth; ++x)
+		{
+			sum += ptr[x];
+		}
+
+		profile[y - rect.y0] = sum;
+#endif // __SSE2__
+	}
+
+	return rect.getHeight();
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getColumnProfile(int x0, int y0, int x1, int y1, Sum* profile) const
+{
+	assert(profile != nullptr);
+
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int rectWidth = rect.getWidth();
+
+	// Calculate
+	std::fill(profile, profile + rectWidth, Sum(0));
+
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		accumulateLine(_buffer + rect.x0 + y * _xWidth, profile, rectWidth);
+	}
+
+	return rectWidth;
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getRowNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const
+{
+	assert(profile != nullptr);
+
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int rectWidth = rect.getWidth();
+
+	// Calculate
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		auto ptr = _buffer + rect.x0 + y * _xWidth;
+
+#ifdef __SSE2__
+		profile[y - rect.y0] = countNonZeroSSE(ptr, rectWidth);
+#else
+		unsigned int count = 0;
+		for (int x = 0; x < rectWidth; ++x)
+		{
+			count += ptr[x] != 0 ? 1 : 0;
+		}
+
+		profile[y - rect.y0] = count;
+#endif // __SSE2__
+	}
+
+	return rect.getHeight();
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getColumnNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const
+{
+	assert(profile != nullptr);
+
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int rectWidth = rect.getWidth();
+
+	// Calculate
+	std::fill(profile, profile + rectWidth, 0u);
+
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		accumulateNonZeroLine(_buffer + rect.x0 + y * _xWidth, profile, rectWidth);
+	}
+
+	return rectWidth;
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::setCacheSize(int entries)
+{
+	assert(entries >= 0);
+
+	delete _cache;
+	_cache = entries > 0 ? new QueryCache(entries) : nullptr;
+}
+
+template<class TPixel>
+int BasicPixelSum<TPixel>::getCacheSize() const
+{
+	return _cache != nullptr ? _cache->size : 0;
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::invalidateCache()
+{
+	if (_cache != nullptr)
+	{
+		_cache->generation.fetch_add(1, std::memory_order_release);
+	}
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::getCacheCounters(long long& hits, long long& misses) const
+{
+	hits = _cache != nullptr ? _cache->hits.load(std::memory_order_relaxed) : 0;
+	misses = _cache != nullptr ? _cache->misses.load(std::memory_order_relaxed) : 0;
+}
+
+template<class TPixel>
+void BasicPixelSum<TPixel>::getSumAndCount(int x0, int y0, int x1, int y1, Sum& sum, unsigned int& count) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int rectWidth = rect.getWidth();
+
+	// Cached. The generation of the scan is taken before it
+	unsigned int generation = _cache != nullptr ? _cache->generation.load(std::memory_order_acquire) : 0;
+
+	if (_cache != nullptr)
+	{
+		unsigned long long bits;
+		if (_cache->find(rect.x0, rect.y0, rect.x1, rect.y1, bits, count))
+		{
+			fromBits(bits, sum);
+			return;
+		}
+	}
+
+	// Calculate
+	sum = 0;
+	count = 0;
 
 	for (int y = rect.y0; y <= rect.y1; ++y)
 	{
@@ -173,11 +544,16 @@ double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
 		int offset = rect.x0 + y * _xWidth;
 		auto ptr = _buffer + offset;
 
-		sumAndCountNonZeroSSE(ptr, rectWidth, sum, count);
+		Sum lineSum;
+		unsigned int lineCount;
+		sumAndCountNonZeroSSE(ptr, rectWidth, lineSum, lineCount);
+
+		sum += lineSum;
+		count += lineCount;
 #else
 		for (int x = rect.x0; x <= rect.x1; ++x)
 		{
-			unsigned char value = _buffer[x + y * _xWidth];
+			TPixel value = _buffer[x + y * _xWidth];
 
 			sum += value;
 			count += value != 0 ? 1 : 0;
@@ -185,8 +561,14 @@ double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
 #endif // __AVX2__
 	}
 
-	// Result
-	return count != 0 ? double(sum) / double(count) : 0.0;
+	if (_cache != nullptr)
+	{
+		_cache->insert(generation, rect.x0, rect.y0, rect.x1, rect.y1, toBits(sum), count);
+	}
 }
 
+template class BasicPixelSum<unsigned char>;
+template class BasicPixelSum<unsigned short>;
+template class BasicPixelSum<float>;
+
 } // End naivev2
\ No newline at end of file
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "Common.h"
+#include "PixelTraits.h"
 
 namespace naivev2 {
 
+// Results of the scans, defined in the implementation
+struct QueryCache;
+
 /**
- * Optimized naive implementation for providing region queries from an 8-bit pixel buffer.
+ * Optimized naive implementation for providing region queries from a pixel buffer.
  * Note: all coordinates are *inclusive* and clamped internally to the borders
  * of the buffer by the implementation.
  *
@@ -16,31 +20,93 @@ namespace naivev2 {
  * functions should be 0.
  *
  * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * Pixels are uint8, uint16 or float. Sums are uint32, uint64 or double, see utils::PixelTraits.
+ * Rows are scanned by SSE kernels for every pixel type.
+ *
+ * Optional query cache, setCacheSize. Sum and non-zero count of a region are scanned together
+ * and kept in a direct-mapped table keyed by the normalized, clamped region, so repeated regions
+ * and the averages after the sum or the count are not scanned again. Slots are seqlocks of
+ * atomics: readers never wait, a writer skips a slot being written. Concurrent queries are safe.
  */
-class PIXEL_SUM_API PixelSum
+template<class TPixel>
+class PIXEL_SUM_API BasicPixelSum
 {
+public:
+	typedef TPixel Pixel;
+	typedef typename utils::PixelTraits<TPixel>::Sum Sum;
+
 public:
 	// Contrustors/Destructor
-	PixelSum(const unsigned char* buffer, int xWidth, int yHeight);
-	~PixelSum();
-	PixelSum(const PixelSum& other);
-	PixelSum(PixelSum&& other);
+	BasicPixelSum(const TPixel* buffer, int xWidth, int yHeight);
+	~BasicPixelSum();
+	BasicPixelSum(const BasicPixelSum& other);
+	BasicPixelSum(BasicPixelSum&& other);
 
 	// Operators
-	PixelSum& operator=(const PixelSum& other);
-	PixelSum& operator=(PixelSum&& other);
+	BasicPixelSum& operator=(const BasicPixelSum& other);
+	BasicPixelSum& operator=(BasicPixelSum&& other);
 
 	// Methods
-	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	Sum getPixelSum(int x0, int y0, int x1, int y1) const;
 	double getPixelAverage(int x0, int y0, int x1, int y1) const;
 
 	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
 	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
 
+	// Sums (counts) of the rows or the columns of the clamped region, top to bottom or left to right.
+	// Rows are scanned by SSE, columns are accumulated row by row. Return the length of the profile
+	int getRowProfile(int x0, int y0, int x1, int y1, Sum* profile) const;
+	int getColumnProfile(int x0, int y0, int x1, int y1, Sum* profile) const;
+
+	int getRowNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const;
+	int getColumnNonZeroProfile(int x0, int y0, int x1, int y1, unsigned int* profile) const;
+
+	// Query cache. entries are rounded up to a power of two, 0 - no cache (default).
+	// Not thread-safe with the queries, a copy gets a cache of the same size
+	void setCacheSize(int entries);
+	int getCacheSize() const;
+
+	// Drops all results in O(1)
+	void invalidateCache();
+
+	void getCacheCounters(long long& hits, long long& misses) const;
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+	const TPixel* getBuffer() const
+	{
+		return _buffer;
+	}
+
+private:
+	// Sum and non-zero count of the clamped region, from the cache if there is one
+	void getSumAndCount(int x0, int y0, int x1, int y1, Sum& sum, unsigned int& count) const;
+
 private:
-	unsigned char* _buffer;
+	TPixel* _buffer;
 	int _xWidth;
 	int _yHeight;
+
+	QueryCache* _cache;
 };
 
+typedef BasicPixelSum<unsigned char> PixelSum;
+typedef BasicPixelSum<unsigned short> PixelSum16;
+typedef BasicPixelSum<float> PixelSumFloat;
+
+// Instantiated in the library
+extern template class BasicPixelSum<unsigned char>;
+extern template class BasicPixelSum<unsigned short>;
+extern template class BasicPixelSum<float>;
+
 } // End naivev2
\ No newline at end of file
@@ -0,0 +1,545 @@
+#include "PixelSumPyramid.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace pyramid {
+
+void blockSums4x4(const unsigned char* src, int stride, int lines, unsigned int* sums, unsigned int* counts, int len)
+{
+#ifdef __SSE2__
+	blockSums4x4SSE(src, stride, lines, sums, counts, len);
+#else
+	for (int x = 0; x < len; x += 4)
+	{
+		unsigned int sum = 0;
+		unsigned int count = 0;
+
+		for (int y = 0; y < lines; ++y)
+		for (int i = x; i < std::min(x + 4, len); ++i)
+		{
+			unsigned char value = src[i + y * stride];
+
+			sum += value;
+			count += value != 0 ? 1 : 0;
+		}
+
+		sums[x / 4] = sum;
+		counts[x / 4] = count;
+	}
+#endif // __SSE2__
+}
+
+void sumAndCountLine(const unsigned char* src, int len, unsigned int& sum, unsigned int& count)
+{
+#ifdef __SSE2__
+	unsigned int lineSum;
+	unsigned int lineCount;
+	sumAndCountNonZeroSSE(src, len, lineSum, lineCount);
+
+	sum += lineSum;
+	count += lineCount;
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		sum += src[x];
+		count += src[x] != 0 ? 1 : 0;
+	}
+#endif // __SSE2__
+}
+
+// Estimate of the covered part of a block and the largest distance to the possible values.
+// value is in [0, maxValue * area]
+void estimateBlock(double blockValue, double maxValue, double area, double covered, PixelSum::Estimate& estimate)
+{
+	double value = blockValue * covered / area;
+
+	double lower = std::max(0.0, blockValue - maxValue * (area - covered));
+	double upper = std::min(blockValue, maxValue * covered);
+
+	estimate.value += value;
+	estimate.error += std::max(upper - value, value - lower);
+}
+
+PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
+
+	allocateMemory();
+
+	// Copy
+	memcpy(_buffer, buffer, _xWidth * _yHeight * sizeof(unsigned char));
+
+	fillLevels();
+}
+
+PixelSum::~PixelSum()
+{
+	freeMemory();
+}
+
+PixelSum::PixelSum(const PixelSum& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_blockSums, other._blockSums, getLevelsSize() * sizeof(unsigned int));
+	memcpy(_blockCounts, other._blockCounts, getLevelsSize() * sizeof(unsigned int));
+}
+
+PixelSum::PixelSum(PixelSum&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _topLevel(other._topLevel)
+{
+	// Move
+	memcpy(_levelOffsets, other._levelOffsets, sizeof(_levelOffsets));
+
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_blockSums = other._blockSums;
+	other._blockSums = nullptr;
+
+	_blockCounts = other._blockCounts;
+	other._blockCounts = nullptr;
+}
+
+PixelSum& PixelSum::operator=(const PixelSum& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+
+	allocateMemory();
+
+	memcpy(_buffer, other._buffer, _xWidth * _yHeight * sizeof(unsigned char));
+	memcpy(_blockSums, other._blockSums, getLevelsSize() * sizeof(unsigned int));
+	memcpy(_blockCounts, other._blockCounts, getLevelsSize() * sizeof(unsigned int));
+
+	return *this;
+}
+
+PixelSum& PixelSum::operator=(PixelSum&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_topLevel = other._topLevel;
+
+	memcpy(_levelOffsets, other._levelOffsets, sizeof(_levelOffsets));
+
+	_buffer = other._buffer;
+	other._buffer = nullptr;
+
+	_blockSums = other._blockSums;
+	other._blockSums = nullptr;
+
+	_blockCounts = other._blockCounts;
+	other._blockCounts = nullptr;
+
+	return *this;
+}
+
+unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	unsigned int sum = 0;
+	unsigned int count = 0;
+	getTotals(rect.x0, rect.y0, rect.x1, rect.y1, sum, count);
+
+	return sum;
+}
+
+double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+
+	// Result
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+
+	return double(sum) / double(width * height);
+}
+
+int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	unsigned int sum = 0;
+	unsigned int count = 0;
+	getTotals(rect.x0, rect.y0, rect.x1, rect.y1, sum, count);
+
+	return int(count);
+}
+
+double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	unsigned int sum = 0;
+	unsigned int count = 0;
+	getTotals(rect.x0, rect.y0, rect.x1, rect.y1, sum, count);
+
+	// Result
+	return count != 0 ? double(sum) / double(count) : 0.0;
+}
+
+PixelSum::Estimate PixelSum::getPixelSumEstimate(int x0, int y0, int x1, int y1, double tolerance) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	Estimate sum;
+	Estimate count;
+	estimateWithin(rect.x0, rect.y0, rect.x1, rect.y1, tolerance, true, sum, count);
+
+	return sum;
+}
+
+PixelSum::Estimate PixelSum::getPixelAverageEstimate(int x0, int y0, int x1, int y1, double tolerance) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Same area as getPixelAverage
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+	double area = double(width * height);
+
+	// Calculate
+	Estimate sum;
+	Estimate count;
+	estimateWithin(rect.x0, rect.y0, rect.x1, rect.y1, tolerance * area, true, sum, count);
+
+	// Result
+	Estimate average;
+	average.value = sum.value / area;
+	average.error = sum.error / area;
+
+	return average;
+}
+
+PixelSum::Estimate PixelSum::getNonZeroCountEstimate(int x0, int y0, int x1, int y1, double tolerance) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	Estimate sum;
+	Estimate count;
+	estimateWithin(rect.x0, rect.y0, rect.x1, rect.y1, tolerance, false, sum, count);
+
+	return count;
+}
+
+void PixelSum::fillLevels()
+{
+	// Level MinLevel from the buffer, 4 lines per line of blocks
+	int blockSize = 1 << MinLevel;
+	int levelWidth = getLevelWidth(MinLevel);
+
+	for (int by = 0; by < getLevelHeight(MinLevel); ++by)
+	{
+		int y = by * blockSize;
+		int lines = std::min(blockSize, _yHeight - y);
+
+		int offset = _levelOffsets[MinLevel] + by * levelWidth;
+		blockSums4x4(_buffer + y * _xWidth, _xWidth, lines, _blockSums + offset, _blockCounts + offset, _xWidth);
+	}
+
+	// 2x2 reductions
+	for (int level = MinLevel + 1; level <= _topLevel; ++level)
+	{
+		int srcWidth = getLevelWidth(level - 1);
+		int srcHeight = getLevelHeight(level - 1);
+		int dstWidth = getLevelWidth(level);
+		int dstHeight = getLevelHeight(level);
+
+		const auto srcSums = _blockSums + _levelOffsets[level - 1];
+		const auto srcCounts = _blockCounts + _levelOffsets[level - 1];
+		auto dstSums = _blockSums + _levelOffsets[level];
+		auto dstCounts = _blockCounts + _levelOffsets[level];
+
+		for (int by = 0; by < dstHeight; ++by)
+		for (int bx = 0; bx < dstWidth; ++bx)
+		{
+			unsigned int sum = 0;
+			unsigned int count = 0;
+
+			for (int y = by * 2; y < std::min(by * 2 + 2, srcHeight); ++y)
+			for (int x = bx * 2; x < std::min(bx * 2 + 2, srcWidth); ++x)
+			{
+				sum += srcSums[x + y * srcWidth];
+				count += srcCounts[x + y * srcWidth];
+			}
+
+			dstSums[bx + by * dstWidth] = sum;
+			dstCounts[bx + by * dstWidth] = count;
+		}
+	}
+}
+
+void PixelSum::addBlocks(int level, int bx0, int by0, int bx1, int by1, unsigned int& sum, unsigned int& count) const
+{
+	if (bx0 > bx1 || by0 > by1)
+	{
+		return;
+	}
+
+	// Full blocks of the next level inside
+	int cx0 = (bx0 + 1) >> 1;
+	int cy0 = (by0 + 1) >> 1;
+	int cx1 = ((bx1 + 1) >> 1) - 1;
+	int cy1 = ((by1 + 1) >> 1) - 1;
+
+	bool inner = level < _topLevel && cx0 <= cx1 && cy0 <= cy1;
+	if (inner)
+	{
+		addBlocks(level + 1, cx0, cy0, cx1, cy1, sum, count);
+	}
+
+	// Ring around them, or all blocks
+	int levelWidth = getLevelWidth(level);
+	const auto sums = _blockSums + _levelOffsets[level];
+	const auto counts = _blockCounts + _levelOffsets[level];
+
+	for (int by = by0; by <= by1; ++by)
+	{
+		bool ring = inner && by >= cy0 * 2 && by <= cy1 * 2 + 1;
+
+		for (int bx = bx0; bx <= bx1; ++bx)
+		{
+			if (ring && bx == cx0 * 2)
+			{
+				bx = cx1 * 2 + 1;
+				continue;
+			}
+
+			sum += sums[bx + by * levelWidth];
+			count += counts[bx + by * levelWidth];
+		}
+	}
+}
+
+void PixelSum::getCoveredBlocks(int level, int x0, int y0, int x1, int y1, int& bx0, int& by0, int& bx1, int& by1) const
+{
+	int blockSize = 1 << level;
+
+	bx0 = (x0 + blockSize - 1) >> level;
+	by0 = (y0 + blockSize - 1) >> level;
+	bx1 = x1 == _xWidth - 1 ? x1 >> level : ((x1 + 1) >> level) - 1;
+	by1 = y1 == _yHeight - 1 ? y1 >> level : ((y1 + 1) >> level) - 1;
+}
+
+long long PixelSum::getPartialPixels(int level, int x0, int y0, int x1, int y1) const
+{
+	int blockSize = 1 << level;
+
+	int bx0, by0, bx1, by1;
+	getCoveredBlocks(level, x0, y0, x1, y1, bx0, by0, bx1, by1);
+
+	long long area = (long long)(x1 - x0 + 1) * (y1 - y0 + 1);
+
+	if (bx0 > bx1 || by0 > by1)
+	{
+		return area;
+	}
+
+	// Full blocks lie inside of the region
+	long long fullWidth = std::min((bx1 + 1) * blockSize, _xWidth) - bx0 * blockSize;
+	long long fullHeight = std::min((by1 + 1) * blockSize, _yHeight) - by0 * blockSize;
+
+	return area - fullWidth * fullHeight;
+}
+
+void PixelSum::estimate(int level, int x0, int y0, int x1, int y1, Estimate& sum, Estimate& count) const
+{
+	int blockSize = 1 << level;
+
+	// Blocks touched
+	int px0 = x0 >> level;
+	int py0 = y0 >> level;
+	int px1 = x1 >> level;
+	int py1 = y1 >> level;
+
+	int bx0, by0, bx1, by1;
+	getCoveredBlocks(level, x0, y0, x1, y1, bx0, by0, bx1, by1);
+
+	unsigned int fullSum = 0;
+	unsigned int fullCount = 0;
+	addBlocks(level, bx0, by0, bx1, by1, fullSum, fullCount);
+
+	sum.value = fullSum;
+	sum.error = 0.0;
+	count.value = fullCount;
+	count.error = 0.0;
+
+	// Partial blocks
+	int levelWidth = getLevelWidth(level);
+	const auto sums = _blockSums + _levelOffsets[level];
+	const auto counts = _blockCounts + _levelOffsets[level];
+
+	for (int by = py0; by <= py1; ++by)
+	{
+		int blockY0 = by * blockSize;
+		int blockY1 = std::min(blockY0 + blockSize, _yHeight) - 1;
+		int coveredHeight = std::min(y1, blockY1) - std::max(y0, blockY0) + 1;
+
+		bool inside = by >= by0 && by <= by1 && bx0 <= bx1;
+
+		for (int bx = px0; bx <= px1; ++bx)
+		{
+			if (inside && bx == bx0)
+			{
+				bx = bx1;
+				continue;
+			}
+
+			int blockX0 = bx * blockSize;
+			int blockX1 = std::min(blockX0 + blockSize, _xWidth) - 1;
+			int coveredWidth = std::min(x1, blockX1) - std::max(x0, blockX0) + 1;
+
+			double area = double((blockX1 - blockX0 + 1) * (blockY1 - blockY0 + 1));
+			double covered = double(coveredWidth * coveredHeight);
+
+			estimateBlock(sums[bx + by * levelWidth], 255.0, area, covered, sum);
+			estimateBlock(counts[bx + by * levelWidth], 1.0, area, covered, count);
+		}
+	}
+}
+
+void PixelSum::getTotals(int x0, int y0, int x1, int y1, unsigned int& sum, unsigned int& count) const
+{
+	int blockSize = 1 << MinLevel;
+
+	int bx0, by0, bx1, by1;
+	getCoveredBlocks(MinLevel, x0, y0, x1, y1, bx0, by0, bx1, by1);
+
+	bool inner = bx0 <= bx1 && by0 <= by1;
+	if (inner)
+	{
+		addBlocks(MinLevel, bx0, by0, bx1, by1, sum, count);
+	}
+
+	// Pixels of the blocks
+	int innerX0 = bx0 * blockSize;
+	int innerY0 = by0 * blockSize;
+	int innerX1 = std::min((bx1 + 1) * blockSize, _xWidth) - 1;
+	int innerY1 = std::min((by1 + 1) * blockSize, _yHeight) - 1;
+
+	// Border from the buffer
+	for (int y = y0; y <= y1; ++y)
+	{
+		auto line = _buffer + y * _xWidth;
+
+		if (inner && y >= innerY0 && y <= innerY1)
+		{
+			sumAndCountLine(line + x0, innerX0 - x0, sum, count);
+			sumAndCountLine(line + innerX1 + 1, x1 - innerX1, sum, count);
+		}
+		else
+		{
+			sumAndCountLine(line + x0, x1 - x0 + 1, sum, count);
+		}
+	}
+}
+
+void PixelSum::estimateWithin(int x0, int y0, int x1, int y1, double tolerance, bool useSum, Estimate& sum, Estimate& count) const
+{
+	double maxValue = useSum ? 255.0 : 1.0;
+
+	// Partial pixels only shrink on finer levels, so no level fits if the finest does not
+	if (maxValue * double(getPartialPixels(MinLevel, x0, y0, x1, y1)) <= tolerance)
+	{
+		// Coarsest level within the tolerance by the bound of the error, before any table reads
+		int level = _topLevel;
+		while (maxValue * double(getPartialPixels(level, x0, y0, x1, y1)) > tolerance)
+		{
+			--level;
+		}
+
+		estimate(level, x0, y0, x1, y1, sum, count);
+		return;
+	}
+
+	// Exact
+	unsigned int exactSum = 0;
+	unsigned int exactCount = 0;
+	getTotals(x0, y0, x1, y1, exactSum, exactCount);
+
+	sum.value = exactSum;
+	sum.error = 0.0;
+	count.value = exactCount;
+	count.error = 0.0;
+}
+
+void PixelSum::allocateMemory()
+{
+	// Levels MinLevel..top, the top level is one block
+	_topLevel = MinLevel;
+	_levelOffsets[MinLevel] = 0;
+
+	while (getLevelWidth(_topLevel) > 1 || getLevelHeight(_topLevel) > 1)
+	{
+		_levelOffsets[_topLevel + 1] = _levelOffsets[_topLevel] + getLevelWidth(_topLevel) * getLevelHeight(_topLevel);
+		++_topLevel;
+	}
+
+	_buffer = new unsigned char[_xWidth * _yHeight];
+	_blockSums = new unsigned int[getLevelsSize()];
+	_blockCounts = new unsigned int[getLevelsSize()];
+}
+
+void PixelSum::freeMemory()
+{
+	delete[] _blockCounts;
+	delete[] _blockSums;
+	delete[] _buffer;
+}
+
+} // End pyramid
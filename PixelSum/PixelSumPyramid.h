@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Common.h"
+
+namespace pyramid {
+
+/**
+ * Multi-resolution block sums for providing approximate region queries with error bounds.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getPixelSum(4,8,7,10) gets the sum of a 4x3 region where top left
+ * corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ * If the resulting region after clamping is empty, the return value for all
+ * functions should be 0.
+ *
+ * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * Level k holds the sums and non-zero counts of 2^k x 2^k blocks, k = MinLevel..getTopLevel(),
+ * the top level is one block. Level MinLevel is built from the buffer by SSE, every next
+ * level is a 2x2 reduction of the previous one. Blocks at the right and bottom borders are clipped.
+ *
+ * A region is split into the blocks it covers fully and a border of blocks it covers
+ * partially. Full blocks are summed as a quadtree: the coarsest blocks inside of the region
+ * and a ring of finer blocks around them, O(perimeter / 2^k) blocks for level k.
+ *
+ * Estimates: a partial block contributes blockSum * covered / blockArea. The true contribution
+ * lies between max(0, blockSum - 255 * uncovered) and min(blockSum, 255 * covered), the
+ * reported error is the sum of the largest distances of the estimates to these limits,
+ * so |estimate - exact| <= error always holds. The error of a level is at most 255 (1 for
+ * counts) * pixels of the region in partial blocks, which is known from the region alone.
+ * The coarsest level with this bound <= tolerance is estimated once, the exact value with
+ * error 0 is returned if there is none, so an estimate never costs more than an exact query.
+ *
+ * Exact queries: full blocks of level MinLevel and the border of < 2^MinLevel pixels
+ * summed from the buffer by SSE.
+ *
+ * Memory: xWidth * yHeight * (sizeof(uint8) + sizeof(uint32) * 2 / 12), ~1.7 bytes per pixel
+ * (integral::PixelSum takes 9)
+ */
+class PIXEL_SUM_API PixelSum
+{
+public:
+	// Blocks of level MinLevel are 4x4
+	static const int MinLevel = 2;
+	static const int MaxLevels = 32;
+
+	// Exact value is in [value - error, value + error]
+	struct Estimate
+	{
+		double value;
+		double error;
+	};
+
+public:
+	// Contrustors/Destructor
+	PixelSum(const unsigned char* buffer, int xWidth, int yHeight);
+	~PixelSum();
+	PixelSum(const PixelSum& other);
+	PixelSum(PixelSum&& other);
+
+	// Operators
+	PixelSum& operator=(const PixelSum& other);
+	PixelSum& operator=(PixelSum&& other);
+
+	// Methods
+	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	double getPixelAverage(int x0, int y0, int x1, int y1) const;
+
+	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
+	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
+
+	// Approximate queries. error <= tolerance, the tolerance is in the units of the value
+	Estimate getPixelSumEstimate(int x0, int y0, int x1, int y1, double tolerance) const;
+	Estimate getPixelAverageEstimate(int x0, int y0, int x1, int y1, double tolerance) const;
+	Estimate getNonZeroCountEstimate(int x0, int y0, int x1, int y1, double tolerance) const;
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+	int getTopLevel() const
+	{
+		return _topLevel;
+	}
+
+private:
+	int getLevelWidth(int level) const
+	{
+		return (_xWidth + (1 << level) - 1) >> level;
+	}
+
+	int getLevelHeight(int level) const
+	{
+		return (_yHeight + (1 << level) - 1) >> level;
+	}
+
+	int getLevelsSize() const
+	{
+		return _levelOffsets[_topLevel] + 1;
+	}
+
+	void fillLevels();
+
+	// Full blocks bx0..bx1, by0..by1 of the clamped region at a level, clipped blocks at the borders included
+	void getCoveredBlocks(int level, int x0, int y0, int x1, int y1, int& bx0, int& by0, int& bx1, int& by1) const;
+
+	// Pixels of the clamped region in partial blocks of a level
+	long long getPartialPixels(int level, int x0, int y0, int x1, int y1) const;
+
+	// Sums of full blocks bx0..bx1, by0..by1 of a level
+	void addBlocks(int level, int bx0, int by0, int bx1, int by1, unsigned int& sum, unsigned int& count) const;
+
+	// Estimates of the clamped region at a level
+	void estimate(int level, int x0, int y0, int x1, int y1, Estimate& sum, Estimate& count) const;
+
+	// Exact sum and count of the clamped region
+	void getTotals(int x0, int y0, int x1, int y1, unsigned int& sum, unsigned int& count) const;
+
+	// Estimates of the coarsest level within the tolerance, 'useSum' selects the value compared
+	void estimateWithin(int x0, int y0, int x1, int y1, double tolerance, bool useSum, Estimate& sum, Estimate& count) const;
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned char* _buffer;
+	unsigned int* _blockSums;
+	unsigned int* _blockCounts;
+
+	int _xWidth;
+	int _yHeight;
+
+	int _topLevel;
+	int _levelOffsets[MaxLevels];	// Offsets of levels MinLevel..top in the block arrays
+};
+
+} // End pyramid
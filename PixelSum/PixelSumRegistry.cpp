@@ -0,0 +1,340 @@
+#include "PixelSumRegistry.h"
+
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "PixelSumIntegral.h"
+#include "PixelSumNaiveV2.h"
+
+namespace integral {
+
+struct PixelSumRegistry::State
+{
+	struct Entry
+	{
+		std::shared_ptr<const naivev2::PixelSum> pixels;
+		std::shared_ptr<const PixelSum> table;
+
+		std::list<int>::iterator lruPosition;	// Valid with a table
+		bool queued = false;
+	};
+
+	mutable std::mutex mutex;
+	std::condition_variable queueChanged;
+
+	std::unordered_map<int, Entry> entries;
+	std::list<int> lru;		// Images with tables, the most recent first
+	size_t usedBytes = 0;
+
+	Counters counters = {};
+
+	// Rebuilds
+	std::deque<int> queue;
+	int building = 0;
+	bool stop = false;
+	std::thread worker;
+
+	// Frees the tables of the least recent images but 'keepId' until 'bytes' more fit the budget
+	void evict(size_t budgetBytes, size_t bytes, int keepId)
+	{
+		auto position = lru.end();
+
+		while (usedBytes + bytes > budgetBytes && position != lru.begin())
+		{
+			--position;
+			if (*position == keepId)
+			{
+				continue;
+			}
+
+			auto& entry = entries[*position];
+			usedBytes -= PixelSumRegistry::getTableBytes(entry.pixels->getWidth(), entry.pixels->getHeight());
+			entry.table.reset();
+
+			position = lru.erase(position);
+			++counters.evictions;
+		}
+	}
+
+	void dropTable(Entry& entry)
+	{
+		if (entry.table)
+		{
+			usedBytes -= PixelSumRegistry::getTableBytes(entry.pixels->getWidth(), entry.pixels->getHeight());
+			entry.table.reset();
+
+			lru.erase(entry.lruPosition);
+		}
+	}
+};
+
+PixelSumRegistry::PixelSumRegistry(size_t budgetBytes, bool asyncRebuild)
+	: _budgetBytes(budgetBytes)
+	, _asyncRebuild(asyncRebuild)
+	, _state(new State())
+{
+	if (_asyncRebuild)
+	{
+		_state->worker = std::thread(&PixelSumRegistry::runWorker, this);
+	}
+}
+
+PixelSumRegistry::~PixelSumRegistry()
+{
+	if (_asyncRebuild)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_state->mutex);
+			_state->stop = true;
+		}
+
+		_state->queueChanged.notify_all();
+		_state->worker.join();
+	}
+
+	delete _state;
+}
+
+void PixelSumRegistry::add(int id, const unsigned char* buffer, int xWidth, int yHeight)
+{
+	// Copy outside of the lock
+	auto pixels = std::make_shared<const naivev2::PixelSum>(buffer, xWidth, yHeight);
+
+	std::lock_guard<std::mutex> lock(_state->mutex);
+
+	auto& entry = _state->entries[id];
+	_state->dropTable(entry);
+
+	entry.pixels = pixels;
+}
+
+void PixelSumRegistry::remove(int id)
+{
+	std::lock_guard<std::mutex> lock(_state->mutex);
+
+	auto found = _state->entries.find(id);
+	if (found != _state->entries.end())
+	{
+		_state->dropTable(found->second);
+		_state->entries.erase(found);
+	}
+}
+
+bool PixelSumRegistry::contains(int id) const
+{
+	std::lock_guard<std::mutex> lock(_state->mutex);
+	return _state->entries.count(id) != 0;
+}
+
+bool PixelSumRegistry::isResident(int id) const
+{
+	std::lock_guard<std::mutex> lock(_state->mutex);
+
+	auto found = _state->entries.find(id);
+	return found != _state->entries.end() && found->second.table != nullptr;
+}
+
+unsigned int PixelSumRegistry::getPixelSum(int id, int x0, int y0, int x1, int y1)
+{
+	return (unsigned int)query(id, Query::Sum, x0, y0, x1, y1);
+}
+
+double PixelSumRegistry::getPixelAverage(int id, int x0, int y0, int x1, int y1)
+{
+	return query(id, Query::Average, x0, y0, x1, y1);
+}
+
+int PixelSumRegistry::getNonZeroCount(int id, int x0, int y0, int x1, int y1)
+{
+	return int(query(id, Query::NonZeroCount, x0, y0, x1, y1));
+}
+
+double PixelSumRegistry::getNonZeroAverage(int id, int x0, int y0, int x1, int y1)
+{
+	return query(id, Query::NonZeroAverage, x0, y0, x1, y1);
+}
+
+PixelSumRegistry::Counters PixelSumRegistry::getCounters() const
+{
+	std::lock_guard<std::mutex> lock(_state->mutex);
+	return _state->counters;
+}
+
+size_t PixelSumRegistry::getUsedBytes() const
+{
+	std::lock_guard<std::mutex> lock(_state->mutex);
+	return _state->usedBytes;
+}
+
+void PixelSumRegistry::waitRebuilds()
+{
+	std::unique_lock<std::mutex> lock(_state->mutex);
+
+	_state->queueChanged.wait(lock, [&]() {
+		return _state->queue.empty() && _state->building == 0;
+	});
+}
+
+double PixelSumRegistry::query(int id, Query type, int x0, int y0, int x1, int y1)
+{
+	std::shared_ptr<const PixelSum> table;
+	std::shared_ptr<const naivev2::PixelSum> pixels;
+
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+
+		auto found = _state->entries.find(id);
+		assert(found != _state->entries.end());
+
+		auto& entry = found->second;
+
+		if (entry.table)
+		{
+			++_state->counters.hits;
+
+			// Most recent
+			_state->lru.splice(_state->lru.begin(), _state->lru, entry.lruPosition);
+			table = entry.table;
+		}
+		else
+		{
+			++_state->counters.misses;
+
+			pixels = entry.pixels;
+
+			if (_asyncRebuild)
+			{
+				++_state->counters.fallbacks;
+
+				if (!entry.queued)
+				{
+					entry.queued = true;
+					_state->queue.push_back(id);
+					_state->queueChanged.notify_all();
+				}
+			}
+		}
+	}
+
+	if (!table && !_asyncRebuild)
+	{
+		// Synchronous rebuild. The miss is answered by the new table, it is not counted again.
+		// The pixels are scanned only if the table is evicted or the image removed meanwhile
+		rebuild(id);
+
+		std::lock_guard<std::mutex> lock(_state->mutex);
+
+		auto found = _state->entries.find(id);
+		if (found != _state->entries.end() && found->second.pixels == pixels)
+		{
+			table = found->second.table;
+		}
+	}
+
+	// Queries outside of the lock, the pointers keep the data alive.
+	// Sums and counts are exact in double
+	auto run = [&](const auto& pixelSum) -> double {
+		switch (type)
+		{
+		case Query::Sum:
+			return pixelSum.getPixelSum(x0, y0, x1, y1);
+		case Query::Average:
+			return pixelSum.getPixelAverage(x0, y0, x1, y1);
+		case Query::NonZeroCount:
+			return pixelSum.getNonZeroCount(x0, y0, x1, y1);
+		default:
+			return pixelSum.getNonZeroAverage(x0, y0, x1, y1);
+		}
+	};
+
+	return table ? run(*table) : run(*pixels);
+}
+
+void PixelSumRegistry::rebuild(int id)
+{
+	std::shared_ptr<const naivev2::PixelSum> pixels;
+
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+
+		auto found = _state->entries.find(id);
+		if (found == _state->entries.end() || found->second.table)
+		{
+			return;
+		}
+
+		pixels = found->second.pixels;
+	}
+
+	// Build outside of the lock
+	auto startTime = std::chrono::high_resolution_clock::now();
+	auto table = std::make_shared<const PixelSum>(pixels->getBuffer(), pixels->getWidth(), pixels->getHeight());
+	auto finisTime = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(_state->mutex);
+
+	++_state->counters.rebuilds;
+	_state->counters.rebuildMks += std::chrono::duration_cast<std::chrono::microseconds>(finisTime - startTime).count();
+
+	// Removed, replaced or built by another query meanwhile
+	auto found = _state->entries.find(id);
+	if (found == _state->entries.end() || found->second.pixels != pixels || found->second.table)
+	{
+		return;
+	}
+
+	size_t bytes = getTableBytes(pixels->getWidth(), pixels->getHeight());
+	_state->evict(_budgetBytes, bytes, id);
+
+	auto& entry = found->second;
+	entry.table = table;
+
+	_state->lru.push_front(id);
+	entry.lruPosition = _state->lru.begin();
+	_state->usedBytes += bytes;
+}
+
+void PixelSumRegistry::runWorker()
+{
+	std::unique_lock<std::mutex> lock(_state->mutex);
+
+	while (true)
+	{
+		_state->queueChanged.wait(lock, [&]() {
+			return _state->stop || !_state->queue.empty();
+		});
+
+		if (_state->stop)
+		{
+			return;
+		}
+
+		int id = _state->queue.front();
+		_state->queue.pop_front();
+		++_state->building;
+
+		lock.unlock();
+		rebuild(id);
+		lock.lock();
+
+		--_state->building;
+
+		auto found = _state->entries.find(id);
+		if (found != _state->entries.end())
+		{
+			found->second.queued = false;
+		}
+
+		_state->queueChanged.notify_all();
+	}
+}
+
+} // End integral
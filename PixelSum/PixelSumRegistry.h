@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>		// size_t
+
+#include "Common.h"
+
+namespace integral {
+
+/**
+ * Region queries of many images under a memory budget for the summed area tables.
+ * Images are added by id, the pixels are kept (naivev2::PixelSum) and the tables of
+ * integral::PixelSum are built on the first query of an image.
+ *
+ * Images with tables are in LRU order. When a new table does not fit the budget, tables
+ * of the least recently queried images are freed, the image itself stays registered and
+ * its table is rebuilt on the next query. A table larger than the budget is still kept
+ * while it is the only one.
+ *
+ * Rebuilds run on a worker thread when 'asyncRebuild' is set. Queries of an image
+ * without a table are answered by the naivev2 scan meanwhile, so a query never waits
+ * for a table. Otherwise a query of an image without a table builds it first.
+ *
+ * Queries can be called from any thread. A table freed while a query reads it is
+ * released after the query.
+ *
+ * Memory: getTableBytes() per image with a table <= budget, plus xWidth * yHeight per image
+ */
+class PIXEL_SUM_API PixelSumRegistry
+{
+public:
+	struct Counters
+	{
+		long long hits;			// Queries answered by a table
+		long long misses;		// Queries of images without a table
+		long long fallbacks;	// Misses answered by the naivev2 scan
+		long long rebuilds;
+		long long rebuildMks;	// Total time of the rebuilds
+		long long evictions;
+	};
+
+public:
+	// Contrustors/Destructor
+	PixelSumRegistry(size_t budgetBytes, bool asyncRebuild = true);
+	~PixelSumRegistry();
+	PixelSumRegistry(const PixelSumRegistry& other) = delete;
+
+	// Operators
+	PixelSumRegistry& operator=(const PixelSumRegistry& other) = delete;
+
+	// Methods
+
+	// Copies the pixels. An image with the same id is replaced
+	void add(int id, const unsigned char* buffer, int xWidth, int yHeight);
+	void remove(int id);
+
+	bool contains(int id) const;
+
+	// The table of the image is built
+	bool isResident(int id) const;
+
+	// Same as integral::PixelSum of the image, the image is registered
+	unsigned int getPixelSum(int id, int x0, int y0, int x1, int y1);
+	double getPixelAverage(int id, int x0, int y0, int x1, int y1);
+
+	int getNonZeroCount(int id, int x0, int y0, int x1, int y1);
+	double getNonZeroAverage(int id, int x0, int y0, int x1, int y1);
+
+	Counters getCounters() const;
+
+	// Bytes of the built tables
+	size_t getUsedBytes() const;
+
+	// Waits for the queued rebuilds
+	void waitRebuilds();
+
+	// Inlines
+	size_t getBudget() const
+	{
+		return _budgetBytes;
+	}
+
+	// integral::PixelSum of xWidth x yHeight
+	static size_t getTableBytes(int xWidth, int yHeight)
+	{
+		return size_t(xWidth) * yHeight * (sizeof(unsigned char) + sizeof(unsigned int) * 2);
+	}
+
+private:
+	// Images, LRU list, counters and the worker
+	struct State;
+
+	enum class Query
+	{
+		Sum,
+		Average,
+		NonZeroCount,
+		NonZeroAverage
+	};
+
+	double query(int id, Query type, int x0, int y0, int x1, int y1);
+
+	void rebuild(int id);
+	void runWorker();
+
+private:
+	size_t _budgetBytes;
+	bool _asyncRebuild;
+
+	State* _state;
+};
+
+} // End integral
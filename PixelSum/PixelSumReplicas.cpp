@@ -0,0 +1,225 @@
+#include "PixelSumReplicas.h"
+
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(PIXEL_SUM_LIBNUMA)
+#include <numa.h>
+#include <sched.h>		// sched_getcpu
+#endif
+
+namespace integral {
+
+// Queries of a thread between the detections of its node, a thread can be moved by the OS
+const int NodeCheckInterval = 1024;
+
+struct ThreadNode
+{
+	int pinned = -1;	// setThreadNode
+	int detected = 0;
+	int queries = 0;	// Until the next detection
+};
+
+thread_local ThreadNode threadNode;
+
+// Runs the calling thread on the processors of 'node', its new pages are placed on the node
+PixelSumReplicas::Placement bindToNode(int node)
+{
+#ifdef _WIN32
+	GROUP_AFFINITY affinity = {};
+	if (GetNumaNodeProcessorMaskEx(USHORT(node), &affinity) && affinity.Mask != 0
+		&& SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr))
+	{
+		return PixelSumReplicas::Placement::FirstTouch;
+	}
+#elif defined(PIXEL_SUM_LIBNUMA)
+	if (numa_run_on_node(node) == 0)
+	{
+		// MPOL_BIND of the thread. Without it the pages are still touched on the node first
+		bitmask* nodes = numa_allocate_nodemask();
+		numa_bitmask_setbit(nodes, node);
+		numa_set_membind(nodes);
+
+		bitmask* bound = numa_get_membind();
+		bool strict = numa_bitmask_equal(nodes, bound) != 0;
+
+		numa_bitmask_free(bound);
+		numa_bitmask_free(nodes);
+
+		return strict ? PixelSumReplicas::Placement::Bound : PixelSumReplicas::Placement::FirstTouch;
+	}
+#else
+	(void)node;
+#endif
+
+	return PixelSumReplicas::Placement::None;
+}
+
+PixelSumReplicas::PixelSumReplicas(const unsigned char* buffer, int xWidth, int yHeight, int nodes)
+	: _nodes(nodes > 0 ? nodes : getMachineNodes())
+	, _placement(Placement::None)
+	, _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+
+	_replicas = new PixelSum*[_nodes];
+	_replicaNodes = new int[_nodes];
+
+	// A builder per node, the tables are filled by the thread that allocates them
+	int machineNodes = getMachineNodes();
+	std::vector<Placement> placements(_nodes, Placement::None);
+
+	std::vector<std::thread> builders;
+	builders.reserve(_nodes);
+
+	for (int node = 0; node < _nodes; ++node)
+	{
+		builders.emplace_back([&, node]() {
+			if (machineNodes > 1)
+			{
+				placements[node] = bindToNode(node % machineNodes);
+			}
+
+			_replicas[node] = new PixelSum(buffer, xWidth, yHeight);
+
+			// The node of the placement or the one the builder touched the pages on
+			_replicaNodes[node] = placements[node] != Placement::None ? node % machineNodes : getCurrentNode();
+		});
+	}
+
+	for (auto& builder : builders)
+	{
+		builder.join();
+	}
+
+	// The weakest placement of the replicas
+	_placement = *std::min_element(placements.begin(), placements.end());
+}
+
+PixelSumReplicas::~PixelSumReplicas()
+{
+	for (int node = 0; node < _nodes; ++node)
+	{
+		delete _replicas[node];
+	}
+
+	delete[] _replicaNodes;
+	delete[] _replicas;
+}
+
+unsigned int PixelSumReplicas::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	return local().getPixelSum(x0, y0, x1, y1);
+}
+
+double PixelSumReplicas::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	return local().getPixelAverage(x0, y0, x1, y1);
+}
+
+int PixelSumReplicas::getNonZeroCount(int x0, int y0, int x1, int y1) const
+{
+	return local().getNonZeroCount(x0, y0, x1, y1);
+}
+
+double PixelSumReplicas::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	return local().getNonZeroAverage(x0, y0, x1, y1);
+}
+
+const PixelSum& PixelSumReplicas::getReplica(int node) const
+{
+	assert(node >= 0 && node < _nodes);
+	return *_replicas[node];
+}
+
+int PixelSumReplicas::getThreadReplica() const
+{
+	auto& thread = threadNode;
+
+	if (thread.pinned >= 0)
+	{
+		return thread.pinned % _nodes;
+	}
+
+	if (--thread.queries < 0)
+	{
+		thread.detected = getCurrentNode();
+		thread.queries = NodeCheckInterval;
+	}
+
+	return thread.detected % _nodes;
+}
+
+int PixelSumReplicas::getReplicaNode(int replica) const
+{
+	assert(replica >= 0 && replica < _nodes);
+	return _replicaNodes[replica];
+}
+
+size_t PixelSumReplicas::getNodeBytes(int node) const
+{
+	assert(node >= 0);
+
+	size_t replicaBytes = size_t(_xWidth) * _yHeight * (sizeof(unsigned char) + sizeof(unsigned int) * 2);
+	size_t bytes = 0;
+
+	for (int replica = 0; replica < _nodes; ++replica)
+	{
+		bytes += _replicaNodes[replica] == node ? replicaBytes : 0;
+	}
+
+	return bytes;
+}
+
+void PixelSumReplicas::setThreadNode(int node)
+{
+	assert(node >= -1);
+
+	threadNode.pinned = node;
+	threadNode.queries = 0;
+}
+
+int PixelSumReplicas::getCurrentNode()
+{
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+
+	USHORT node = 0;
+	return GetNumaProcessorNodeEx(&processor, &node) ? int(node) : 0;
+#elif defined(PIXEL_SUM_LIBNUMA)
+	int cpu = sched_getcpu();
+	return cpu >= 0 && numa_available() >= 0 ? std::max(numa_node_of_cpu(cpu), 0) : 0;
+#else
+	return 0;
+#endif
+}
+
+int PixelSumReplicas::getMachineNodes()
+{
+#ifdef _WIN32
+	ULONG highest = 0;
+	return GetNumaHighestNodeNumber(&highest) ? int(highest) + 1 : 1;
+#elif defined(PIXEL_SUM_LIBNUMA)
+	return numa_available() >= 0 ? numa_max_node() + 1 : 1;
+#else
+	return 1;
+#endif
+}
+
+const PixelSum& PixelSumReplicas::local() const
+{
+	return *_replicas[getThreadReplica()];
+}
+
+} // End integral
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>		// size_t
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * integral::PixelSum replicated per NUMA node for query servers on several sockets.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * Every node gets its own copy of the buffer and of the tables, so the four corner loads
+ * of a query never cross the socket. Replicas are built in parallel, one thread per node:
+ * - Windows: the thread runs on the processors of the node, pages are placed by first touch
+ * - Linux with PIXEL_SUM_LIBNUMA (link libnuma): the thread runs on the node and its memory
+ *   policy is bound to the node (numa_set_membind, MPOL_BIND), new pages come from the node only
+ * - otherwise or when the machine has one node: no placement, replicas are plain copies
+ *
+ * A query is answered by the replica of the node of the calling thread. The node is detected
+ * from the current processor and cached by the thread for a while, setThreadNode pins the thread
+ * to a replica instead. More replicas than nodes simulate nodes on a smaller machine, replica
+ * 'node' is then placed on node % machine nodes and threads are routed by setThreadNode only.
+ *
+ * Memory: xWidth * yHeight * (sizeof(uint8) + sizeof(uint32) * 2) per replica, getNodeBytes
+ * adds up the replicas by the machine node they were placed on
+ */
+class PIXEL_SUM_API PixelSumReplicas
+{
+public:
+	enum class Placement
+	{
+		None,		// Copies of a single node machine or without NUMA support
+		FirstTouch,	// Built by a thread running on the node
+		Bound		// Pages of the builder thread are allocated on the node only
+	};
+
+public:
+	// Contrustors/Destructor
+	PixelSumReplicas(const unsigned char* buffer, int xWidth, int yHeight, int nodes = 0);	// nodes <= 0 - one per node of the machine
+	~PixelSumReplicas();
+	PixelSumReplicas(const PixelSumReplicas& other) = delete;
+
+	// Operators
+	PixelSumReplicas& operator=(const PixelSumReplicas& other) = delete;
+
+	// Methods
+
+	// Same as integral::PixelSum, by the replica of the calling thread
+	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	double getPixelAverage(int x0, int y0, int x1, int y1) const;
+
+	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
+	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
+
+	const PixelSum& getReplica(int node) const;
+
+	// Replica of the calling thread
+	int getThreadReplica() const;
+
+	// Machine node the replica was placed on
+	int getReplicaNode(int replica) const;
+
+	// Bytes of the replicas placed on machine node 'node'
+	size_t getNodeBytes(int node) const;
+
+	// Routes the queries of the calling thread to replica 'node' (modulo the replicas),
+	// -1 - back to the detected node
+	static void setThreadNode(int node);
+
+	// Node of the processor of the calling thread, 0 without NUMA support
+	static int getCurrentNode();
+
+	// Nodes of the machine, 1 without NUMA support
+	static int getMachineNodes();
+
+	// Inlines
+	int getNodeCount() const
+	{
+		return _nodes;
+	}
+
+	Placement getPlacement() const
+	{
+		return _placement;
+	}
+
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	const PixelSum& local() const;
+
+private:
+	PixelSum** _replicas;
+	int* _replicaNodes;
+	int _nodes;
+	Placement _placement;
+
+	int _xWidth;
+	int _yHeight;
+};
+
+} // End integral
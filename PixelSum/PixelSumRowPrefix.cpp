@@ -0,0 +1,209 @@
+#include "PixelSumRowPrefix.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace rowprefix {
+
+// Prefix sums and non-zero counts of a line
+void fillRowPrefix(const unsigned char* src, unsigned int* rowSum, unsigned int* rowNonZero, int len)
+{
+#ifdef __SSE2__
+	// A pixel is its own mask, zeros add nothing to the sum
+	maskedRowSumsSSE(src, src, rowSum, rowNonZero, len);
+#else
+	unsigned int sum = 0;
+	unsigned int count = 0;
+
+	for (int x = 0; x < len; ++x)
+	{
+		sum += src[x];
+		count += src[x] != 0 ? 1 : 0;
+
+		rowSum[x] = sum;
+		rowNonZero[x] = count;
+	}
+#endif // __SSE2__
+}
+
+PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight, int threads)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+{
+	assert(buffer != nullptr);
+	assert(xWidth > 0 && yHeight > 0);
+	assert(xWidth * yHeight <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
+
+	allocateMemory();
+
+	// Lines are independent
+	utils::parallelFor(_yHeight, threads, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y)
+		{
+			int offset = y * _xWidth;
+			fillRowPrefix(buffer + offset, _rowSums + offset, _rowNonZero + offset, _xWidth);
+		}
+	});
+}
+
+PixelSum::~PixelSum()
+{
+	freeMemory();
+}
+
+PixelSum::PixelSum(const PixelSum& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_rowSums, other._rowSums, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_rowNonZero, other._rowNonZero, _xWidth * _yHeight * sizeof(unsigned int));
+}
+
+PixelSum::PixelSum(PixelSum&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+{
+	// Move
+	_rowSums = other._rowSums;
+	other._rowSums = nullptr;
+
+	_rowNonZero = other._rowNonZero;
+	other._rowNonZero = nullptr;
+}
+
+PixelSum& PixelSum::operator=(const PixelSum& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+
+	allocateMemory();
+
+	memcpy(_rowSums, other._rowSums, _xWidth * _yHeight * sizeof(unsigned int));
+	memcpy(_rowNonZero, other._rowNonZero, _xWidth * _yHeight * sizeof(unsigned int));
+
+	return *this;
+}
+
+PixelSum& PixelSum::operator=(PixelSum&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+
+	_rowSums = other._rowSums;
+	other._rowSums = nullptr;
+
+	_rowNonZero = other._rowNonZero;
+	other._rowNonZero = nullptr;
+
+	return *this;
+}
+
+unsigned int PixelSum::getPixelSum(int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate. P(x1, y) - P(x0 - 1, y) per line
+	const auto right = _rowSums + rect.x1;
+	const auto left = rect.x0 > 0 ? _rowSums + rect.x0 - 1 : nullptr;
+
+	unsigned int sum = 0;
+
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		int offset = y * _xWidth;
+		sum += right[offset] - (left ? left[offset] : 0);
+	}
+
+	return sum;
+}
+
+double PixelSum::getPixelAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+
+	// Result
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+
+	return double(sum) / double(width * height);
+}
+
+int PixelSum::getNonZeroCount(int x0, int y0, int x1, int y1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	// Calculate
+	const auto right = _rowNonZero + rect.x1;
+	const auto left = rect.x0 > 0 ? _rowNonZero + rect.x0 - 1 : nullptr;
+
+	unsigned int count = 0;
+
+	for (int y = rect.y0; y <= rect.y1; ++y)
+	{
+		int offset = y * _xWidth;
+		count += right[offset] - (left ? left[offset] : 0);
+	}
+
+	return int(count);
+}
+
+double PixelSum::getNonZeroAverage(int x0, int y0, int x1, int y1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, x1, y1);
+	int count = getNonZeroCount(x0, y0, x1, y1);
+
+	// Result
+	return count != 0 ? double(sum) / double(count) : 0.0;
+}
+
+void PixelSum::updateRow(int y, const unsigned char* line)
+{
+	assert(line != nullptr);
+	assert(y >= 0 && y < _yHeight);
+
+	int offset = y * _xWidth;
+	fillRowPrefix(line, _rowSums + offset, _rowNonZero + offset, _xWidth);
+}
+
+void PixelSum::allocateMemory()
+{
+	_rowSums = new unsigned int[_xWidth * _yHeight];
+	_rowNonZero = new unsigned int[_xWidth * _yHeight];
+}
+
+void PixelSum::freeMemory()
+{
+	delete[] _rowNonZero;
+	delete[] _rowSums;
+}
+
+} // End rowprefix
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Common.h"
+
+namespace rowprefix {
+
+/**
+ * Row prefix sums implementation for providing region queries from a pixel buffer.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the buffer by the implementation.
+ *
+ * For example: getPixelSum(4,8,7,10) gets the sum of a 4x3 region where top left
+ * corner is located at (4,8) and bottom right at (7,10). In other words
+ * all coordinates are _inclusive_.
+ * If the resulting region after clamping is empty, the return value for all
+ * functions should be 0.
+ *
+ * The width and height of the buffer dimensions < 4096 x 4096.
+ *
+ * O(height) solution, between naivev2 (no preparation, O(area)) and integral (serial
+ * 2D preparation, O(1)). Only the prefix sums of every line are kept:
+ *   P(x, y) = B(0, y) + ... + B(x, y)
+ * a line of a region is P(x1, y) - P(x0 - 1, y). Lines do not depend on each other,
+ * so the preparation is split between threads and a line is one SSE prefix pass.
+ * A line is replaced by updateRow in O(width), the integral image would be O(area).
+ *
+ * Memory: xWidth * yHeight * sizeof(uint32) * 2
+ */
+class PIXEL_SUM_API PixelSum
+{
+public:
+	// Contrustors/Destructor
+	PixelSum(const unsigned char* buffer, int xWidth, int yHeight, int threads = 0);	// threads <= 0 - one per hardware thread
+	~PixelSum();
+	PixelSum(const PixelSum& other);
+	PixelSum(PixelSum&& other);
+
+	// Operators
+	PixelSum& operator=(const PixelSum& other);
+	PixelSum& operator=(PixelSum&& other);
+
+	// Methods
+	unsigned int getPixelSum(int x0, int y0, int x1, int y1) const;
+	double getPixelAverage(int x0, int y0, int x1, int y1) const;
+
+	int getNonZeroCount(int x0, int y0, int x1, int y1) const;
+	double getNonZeroAverage(int x0, int y0, int x1, int y1) const;
+
+	// Replaces line y of the buffer, line is xWidth pixels
+	void updateRow(int y, const unsigned char* line);
+
+	// Inlines
+	int getWidth() const
+	{
+		return _xWidth;
+	}
+
+	int getHeight() const
+	{
+		return _yHeight;
+	}
+
+private:
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned int* _rowSums;
+	unsigned int* _rowNonZero;
+
+	int _xWidth;
+	int _yHeight;
+};
+
+} // End rowprefix
@@ -0,0 +1,262 @@
+#include "PixelSumVolume.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace volume {
+
+void addLine(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	sumArraySSE(src0, src1, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = src0[x] + src1[x];
+	}
+#endif // __SSE2__
+}
+
+// SVT(x, y, t) = SAT(x, y, t) + SVT(x, y, t - 1)
+void fillPlane(const unsigned char* frame, const unsigned int* prevPlane, unsigned int* plane, const unsigned int* prevNonZeroPlane, unsigned int* nonZeroPlane, int xWidth, int yHeight)
+{
+	// SAT(x, y - 1, t) before the update
+	std::vector<unsigned int> sumLine(xWidth, 0);
+	std::vector<unsigned int> zeroSumLine(xWidth, 0);
+
+	std::vector<unsigned int> rowSum(xWidth);
+	std::vector<unsigned int> rowZeroSum(xWidth);
+
+	for (int y = 0; y < yHeight; ++y)
+	{
+		const auto src = frame + y * xWidth;
+
+		unsigned int sum = 0;
+		unsigned int zeroSum = 0;
+
+		for (int x = 0; x < xWidth; ++x)
+		{
+			unsigned char value = src[x];
+
+			sum += value;
+			zeroSum += (value > 0 ? 1 : 0);
+
+			rowSum[x] = sum;
+			rowZeroSum[x] = zeroSum;
+		}
+
+		int offset = y * xWidth;
+
+		addLine(sumLine.data(), rowSum.data(), sumLine.data(), xWidth);
+		addLine(sumLine.data(), prevPlane + offset, plane + offset, xWidth);
+
+		addLine(zeroSumLine.data(), rowZeroSum.data(), zeroSumLine.data(), xWidth);
+		addLine(zeroSumLine.data(), prevNonZeroPlane + offset, nonZeroPlane + offset, xWidth);
+	}
+}
+
+PixelSum::PixelSum(const unsigned char* buffer, int xWidth, int yHeight, int frames)
+	: PixelSum(xWidth, yHeight, frames)
+{
+	assert(buffer != nullptr);
+
+	for (int t = 0; t < frames; ++t)
+	{
+		pushFrame(buffer + size_t(t) * getPlaneSize());
+	}
+}
+
+PixelSum::PixelSum(int xWidth, int yHeight, int frames)
+	: _xWidth(xWidth)
+	, _yHeight(yHeight)
+	, _frames(frames)
+	, _frameCount(0)
+{
+	assert(xWidth > 0 && yHeight > 0 && frames > 0);
+	assert(xWidth * yHeight * frames <= 4096 * 4096); // 4096 * 4096 * 256 == max(uint32)
+
+	allocateMemory();
+
+	// SVT(x, y, -1) == 0
+	memset(_summedVolume + planeIndex(-1) * getPlaneSize(), 0, getPlaneSize() * sizeof(unsigned int));
+	memset(_summedNonZeroVolume + planeIndex(-1) * getPlaneSize(), 0, getPlaneSize() * sizeof(unsigned int));
+}
+
+PixelSum::~PixelSum()
+{
+	freeMemory();
+}
+
+PixelSum::PixelSum(const PixelSum& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _frames(other._frames)
+	, _frameCount(other._frameCount)
+{
+	allocateMemory();
+
+	// Copy data
+	memcpy(_summedVolume, other._summedVolume, getPlaneSize() * (_frames + 1) * sizeof(unsigned int));
+	memcpy(_summedNonZeroVolume, other._summedNonZeroVolume, getPlaneSize() * (_frames + 1) * sizeof(unsigned int));
+}
+
+PixelSum::PixelSum(PixelSum&& other)
+	: _xWidth(other._xWidth)
+	, _yHeight(other._yHeight)
+	, _frames(other._frames)
+	, _frameCount(other._frameCount)
+{
+	// Move
+	_summedVolume = other._summedVolume;
+	other._summedVolume = nullptr;
+
+	_summedNonZeroVolume = other._summedNonZeroVolume;
+	other._summedNonZeroVolume = nullptr;
+}
+
+PixelSum& PixelSum::operator=(const PixelSum& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Copy
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_frames = other._frames;
+	_frameCount = other._frameCount;
+
+	allocateMemory();
+
+	memcpy(_summedVolume, other._summedVolume, getPlaneSize() * (_frames + 1) * sizeof(unsigned int));
+	memcpy(_summedNonZeroVolume, other._summedNonZeroVolume, getPlaneSize() * (_frames + 1) * sizeof(unsigned int));
+
+	return *this;
+}
+
+PixelSum& PixelSum::operator=(PixelSum&& other)
+{
+	assert(&other != this);
+
+	// Free
+	freeMemory();
+
+	// Move
+	_xWidth = other._xWidth;
+	_yHeight = other._yHeight;
+	_frames = other._frames;
+	_frameCount = other._frameCount;
+
+	_summedVolume = other._summedVolume;
+	other._summedVolume = nullptr;
+
+	_summedNonZeroVolume = other._summedNonZeroVolume;
+	other._summedNonZeroVolume = nullptr;
+
+	return *this;
+}
+
+void PixelSum::pushFrame(const unsigned char* frame)
+{
+	assert(frame != nullptr);
+
+	int t = _frameCount;
+
+	// The plane of the oldest frame - 1 is overwritten
+	const auto prevPlane = _summedVolume + planeIndex(t - 1) * getPlaneSize();
+	const auto prevNonZeroPlane = _summedNonZeroVolume + planeIndex(t - 1) * getPlaneSize();
+
+	auto plane = _summedVolume + planeIndex(t) * getPlaneSize();
+	auto nonZeroPlane = _summedNonZeroVolume + planeIndex(t) * getPlaneSize();
+
+	fillPlane(frame, prevPlane, plane, prevNonZeroPlane, nonZeroPlane, _xWidth, _yHeight);
+
+	++_frameCount;
+}
+
+unsigned int PixelSum::getPixelSum(int x0, int y0, int t0, int x1, int y1, int t1) const
+{
+	return boxValue(_summedVolume, x0, y0, t0, x1, y1, t1);
+}
+
+double PixelSum::getPixelAverage(int x0, int y0, int t0, int x1, int y1, int t1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, t0, x1, y1, t1);
+
+	// Result
+	int width = std::abs(x1 - x0) + 1;
+	int height = std::abs(y1 - y0) + 1;
+	int depth = std::abs(t1 - t0) + 1;
+
+	return double(sum) / (double(width * height) * double(depth));
+}
+
+int PixelSum::getNonZeroCount(int x0, int y0, int t0, int x1, int y1, int t1) const
+{
+	return boxValue(_summedNonZeroVolume, x0, y0, t0, x1, y1, t1);
+}
+
+double PixelSum::getNonZeroAverage(int x0, int y0, int t0, int x1, int y1, int t1) const
+{
+	// Calculate
+	unsigned int sum = getPixelSum(x0, y0, t0, x1, y1, t1);
+	unsigned int count = getNonZeroCount(x0, y0, t0, x1, y1, t1);
+
+	// Result
+	return count > 0 ? double(sum) / double(count) : 0.0;
+}
+
+unsigned int PixelSum::boxValue(const unsigned int* table, int x0, int y0, int t0, int x1, int y1, int t1) const
+{
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _xWidth - 1, _yHeight - 1);
+
+	int minT = std::max(std::min(t0, t1), getFirstFrame());
+	int maxT = std::min(std::max(t0, t1), getLastFrame());
+
+	if (minT > maxT)
+	{
+		return 0;
+	}
+
+	// Calculate. Difference of two planes of the 2D sum
+	const auto front = table + planeIndex(minT - 1) * getPlaneSize();
+	const auto back = table + planeIndex(maxT) * getPlaneSize();
+
+	unsigned int A = cornerValue(back, rect.x1, rect.y1) - cornerValue(front, rect.x1, rect.y1);
+	unsigned int B = cornerValue(back, rect.x0 - 1, rect.y0 - 1) - cornerValue(front, rect.x0 - 1, rect.y0 - 1);
+	unsigned int C = cornerValue(back, rect.x1, rect.y0 - 1) - cornerValue(front, rect.x1, rect.y0 - 1);
+	unsigned int D = cornerValue(back, rect.x0 - 1, rect.y1) - cornerValue(front, rect.x0 - 1, rect.y1);
+
+	return A + B - C - D;
+}
+
+unsigned int PixelSum::cornerValue(const unsigned int* plane, int x, int y) const
+{
+	return x >= 0 && y >= 0 ? plane[x + y * _xWidth] : 0;
+}
+
+void PixelSum::allocateMemory()
+{
+	_summedVolume = new unsigned int[getPlaneSize() * (_frames + 1)];
+	_summedNonZeroVolume = new unsigned int[getPlaneSize() * (_frames + 1)];
+}
+
+void PixelSum::freeMemory()
+{
+	delete[] _summedNonZeroVolume;
+	delete[] _summedVolume;
+}
+
+} // End volume
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Common.h"
+
+namespace volume {
+
+/**
+ * Summed volume table implementation for providing box queries from a stack of 8-bit frames.
+ * Note: all coordinates are *inclusive* and clamped internally to the borders
+ * of the volume by the implementation.
+ *
+ * For example: getPixelSum(4,8,2,7,10,5) gets the sum of a 4x3x4 box where top left
+ * corner of the first frame is located at (4,8,2) and bottom right of the last frame
+ * at (7,10,5). In other words all coordinates are _inclusive_.
+ * If the resulting box after clamping is empty, the return value for all
+ * functions should be 0.
+ *
+ * The width * height * frames of the stored volume <= 4096 * 4096.
+ *
+ * O(1) solution is made. Eight corners of SVT(x, y, t) = SAT(x, y, t) + SVT(x, y, t - 1)
+ * https://en.wikipedia.org/wiki/Summed-area_table#Extensions
+ *
+ * Planes of the table are a ring buffer of the last 'frames' frames. pushFrame drops
+ * the oldest one without a rebuild: the planes are cumulative since the first frame
+ * and a box is a difference of two planes in modular uint32 arithmetic, so it is exact
+ * while the sum of a box fits uint32. Frame indices are absolute, queries are clamped
+ * to [getFirstFrame(), getLastFrame()].
+ *
+ * Memory: xWidth * yHeight * (frames + 1) * sizeof(uint32) * 2
+ */
+class PIXEL_SUM_API PixelSum
+{
+public:
+	// Contrustors/Destructor
+	PixelSum(const unsigned char* buffer, int xWidth, int yHeight, int frames);	// Contiguous frames
+	PixelSum(int xWidth, int yHeight, int frames);								// Empty ring buffer, see pushFrame
+	~PixelSum();
+	PixelSum(const PixelSum& other);
+	PixelSum(PixelSum&& other);
+
+	// Operators
+	PixelSum& operator=(const PixelSum& other);
+	PixelSum& operator=(PixelSum&& other);
+
+	// Methods
+	void pushFrame(const unsigned char* frame);
+
+	unsigned int getPixelSum(int x0, int y0, int t0, int x1, int y1, int t1) const;
+	double getPixelAverage(int x0, int y0, int t0, int x1, int y1, int t1) const;
+
+	int getNonZeroCount(int x0, int y0, int t0, int x1, int y1, int t1) const;
+	double getNonZeroAverage(int x0, int y0, int t0, int x1, int y1, int t1) const;
+
+	// Inlines
+	int getFirstFrame() const
+	{
+		return _frameCount > _frames ? _frameCount - _frames : 0;
+	}
+
+	int getLastFrame() const
+	{
+		return _frameCount - 1;
+	}
+
+	int getFrameCount() const
+	{
+		return _frameCount;
+	}
+
+private:
+	// Plane of SVT(x, y, t). The plane of t == getFirstFrame() - 1 is kept too
+	int planeIndex(int t) const
+	{
+		return (t + 1) % (_frames + 1);
+	}
+
+	unsigned int boxValue(const unsigned int* table, int x0, int y0, int t0, int x1, int y1, int t1) const;
+	unsigned int cornerValue(const unsigned int* plane, int x, int y) const;
+
+	int getPlaneSize() const
+	{
+		return _xWidth * _yHeight;
+	}
+
+	void allocateMemory();
+	void freeMemory();
+
+private:
+	unsigned int* _summedVolume;
+	unsigned int* _summedNonZeroVolume;
+
+	int _xWidth;
+	int _yHeight;
+	int _frames;
+	int _frameCount;
+};
+
+} // End volume
@@ -0,0 +1,229 @@
+#include "PixelTemplateMatch.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <math.h>		// sqrt
+#include <algorithm>	// min, max, clamp
+#include <mutex>
+#include <vector>
+
+#include "PixelBoxFilter.h"
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void multiplyAddLine(const unsigned char* src, unsigned int weight, unsigned int* dst, int len)
+{
+#ifdef __SSE2__
+	multiplyAddU8SSE(src, weight, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] += src[x] * weight;
+	}
+#endif // __SSE2__
+}
+
+// Higher score first, then top to bottom, left to right
+bool isBetterMatch(const TemplateMatch::Match& a, const TemplateMatch::Match& b)
+{
+	if (a.score != b.score)
+	{
+		return a.score > b.score;
+	}
+
+	return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+struct TemplateMatch::LineState
+{
+	// Bands are shifted by one, band[0] = 0 is the column before the buffer
+	std::vector<unsigned int> top;
+	std::vector<unsigned int> band;
+	std::vector<unsigned int> squareBand;
+
+	std::vector<unsigned int> sums;
+	std::vector<unsigned int> squares;
+	std::vector<unsigned int> cross;
+
+	LineState(int xWidth, int mapWidth)
+		: top(xWidth)
+		, band(xWidth + 1, 0)
+		, squareBand(xWidth + 1, 0)
+		, sums(mapWidth)
+		, squares(mapWidth)
+		, cross(mapWidth)
+	{
+	}
+};
+
+TemplateMatch::TemplateMatch(const PixelSum& pixelSum, const unsigned char* templ, int tWidth, int tHeight, int threads)
+	: _pixelSum(pixelSum)
+	, _threads(threads)
+	, _tWidth(tWidth)
+	, _tHeight(tHeight)
+{
+	assert(templ != nullptr);
+	assert(tWidth > 0 && tHeight > 0);
+	assert(tWidth <= pixelSum.getWidth() && tHeight <= pixelSum.getHeight());
+	assert(tWidth * tHeight <= MaxTemplateArea);
+
+	int xWidth = _pixelSum.getWidth();
+	int yHeight = _pixelSum.getHeight();
+
+	_template = new unsigned char[_tWidth * _tHeight];
+	memcpy(_template, templ, _tWidth * _tHeight * sizeof(unsigned char));
+
+	// Template statistics
+	long long n = _tWidth * _tHeight;
+	long long sum = 0;
+	long long squareSum = 0;
+
+	for (int i = 0; i < _tWidth * _tHeight; ++i)
+	{
+		sum += _template[i];
+		squareSum += _template[i] * _template[i];
+	}
+
+	_templateSum = sum;
+	_templateDeviation = sqrt(double(n * squareSum - sum * sum));
+
+	_summedSquares = new unsigned int[xWidth * yHeight];
+	utils::fillSummedSquares(_pixelSum.getBuffer(), _summedSquares, xWidth, yHeight);
+}
+
+TemplateMatch::~TemplateMatch()
+{
+	delete[] _summedSquares;
+	delete[] _template;
+}
+
+void TemplateMatch::getScoreMap(float* dst) const
+{
+	assert(dst != nullptr);
+
+	int mapWidth = getMapWidth();
+
+	utils::parallelFor(getMapHeight(), _threads, [&](int begin, int end) {
+		LineState state(_pixelSum.getWidth(), mapWidth);
+
+		for (int y = begin; y < end; ++y)
+		{
+			getScoreLine(y, state, dst + size_t(y) * mapWidth);
+		}
+	});
+}
+
+int TemplateMatch::getTopMatches(int k, Match* matches) const
+{
+	assert(matches != nullptr);
+	assert(k > 0);
+
+	int mapWidth = getMapWidth();
+
+	std::vector<Match> best;
+	std::mutex bestMutex;
+
+	utils::parallelFor(getMapHeight(), _threads, [&](int begin, int end) {
+		LineState state(_pixelSum.getWidth(), mapWidth);
+		std::vector<float> scores(mapWidth);
+
+		// Heap of the best k of the band, the worst on top
+		std::vector<Match> heap;
+		heap.reserve(k + 1);
+
+		for (int y = begin; y < end; ++y)
+		{
+			getScoreLine(y, state, scores.data());
+
+			for (int x = 0; x < mapWidth; ++x)
+			{
+				Match match = { x, y, scores[x] };
+
+				if (int(heap.size()) < k)
+				{
+					heap.push_back(match);
+					std::push_heap(heap.begin(), heap.end(), isBetterMatch);
+				}
+				else if (isBetterMatch(match, heap.front()))
+				{
+					std::pop_heap(heap.begin(), heap.end(), isBetterMatch);
+					heap.back() = match;
+					std::push_heap(heap.begin(), heap.end(), isBetterMatch);
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(bestMutex);
+		best.insert(best.end(), heap.begin(), heap.end());
+	});
+
+	int count = std::min(k, int(best.size()));
+
+	std::partial_sort(best.begin(), best.begin() + count, best.end(), isBetterMatch);
+	std::copy(best.begin(), best.begin() + count, matches);
+
+	return count;
+}
+
+void TemplateMatch::getScoreLine(int y, LineState& state, float* dst) const
+{
+	int xWidth = _pixelSum.getWidth();
+	int mapWidth = getMapWidth();
+
+	int y0 = y;
+	int y1 = y + _tHeight - 1;
+
+	// Columns of the band. SA(x, y1) - SA(x, y0 - 1)
+	_pixelSum.getSummedAreaLine(y1, state.band.data() + 1, nullptr);
+
+	if (y0 > 0)
+	{
+		_pixelSum.getSummedAreaLine(y0 - 1, state.top.data(), nullptr);
+		BoxFilter::getBandLine(state.band.data() + 1, state.top.data(), state.band.data() + 1, xWidth);
+	}
+
+	const auto squaresTop = y0 > 0 ? _summedSquares + size_t(y0 - 1) * xWidth : nullptr;
+	BoxFilter::getBandLine(_summedSquares + size_t(y1) * xWidth, squaresTop, state.squareBand.data() + 1, xWidth);
+
+	// Windows x..x + tWidth - 1
+	BoxFilter::getBandLine(state.band.data() + _tWidth, state.band.data(), state.sums.data(), mapWidth);
+	BoxFilter::getBandLine(state.squareBand.data() + _tWidth, state.squareBand.data(), state.squares.data(), mapWidth);
+
+	// Sliding dot product. Zero pixels of the template are skipped
+	std::fill(state.cross.begin(), state.cross.end(), 0);
+
+	for (int ty = 0; ty < _tHeight; ++ty)
+	{
+		const auto src = _pixelSum.getBuffer() + size_t(y + ty) * xWidth;
+		const auto templateLine = _template + ty * _tWidth;
+
+		for (int tx = 0; tx < _tWidth; ++tx)
+		{
+			if (templateLine[tx] != 0)
+			{
+				multiplyAddLine(src + tx, templateLine[tx], state.cross.data(), mapWidth);
+			}
+		}
+	}
+
+	// Scores. Numerator and variance are exact integers multiplied by n
+	long long n = _tWidth * _tHeight;
+
+	for (int x = 0; x < mapWidth; ++x)
+	{
+		long long sum = state.sums[x];
+
+		long long numerator = n * state.cross[x] - sum * _templateSum;
+		long long variance = n * state.squares[x] - sum * sum;
+
+		double denominator = sqrt(double(variance)) * _templateDeviation;
+
+		dst[x] = denominator > 0.0 ? float(utils::clamp(double(numerator) / denominator, -1.0, 1.0)) : 0.0f;
+	}
+}
+
+} // End integral
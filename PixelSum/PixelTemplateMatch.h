@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * Normalized cross-correlation template matching over the summed area tables of integral::PixelSum.
+ * Score of position (x, y) is the NCC of the template and the image window with
+ * top left corner (x, y), 0 <= x <= xWidth - tWidth, 0 <= y <= yHeight - tHeight:
+ *
+ *   NCC = (S(IT) - S(I) * S(T) / n) / sqrt((S(I^2) - S(I)^2 / n) * (S(T^2) - S(T)^2 / n))
+ *
+ * in [-1, 1], 0 for flat windows or a flat template. n = tWidth * tHeight.
+ * https://en.wikipedia.org/wiki/Cross-correlation#Zero-normalized_cross-correlation_(ZNCC)
+ *
+ * S(I) of a window is O(1) from the tables, S(I^2) from a table of squares built by
+ * the constructor, xWidth * yHeight * sizeof(uint32). It is modular like the sums,
+ * so the template area is <= MaxTemplateArea.
+ * S(IT) is a sliding dot product, one SSE multiply-add of an image line per template
+ * pixel, O(n) per position. Output lines are split between threads.
+ */
+class PIXEL_SUM_API TemplateMatch
+{
+public:
+	struct Match
+	{
+		int x;
+		int y;
+		float score;
+	};
+
+	// 255^2 * MaxTemplateArea < 2^32
+	static const int MaxTemplateArea = 66051;
+
+public:
+	// Contrustors/Destructor
+	TemplateMatch(const PixelSum& pixelSum, const unsigned char* templ, int tWidth, int tHeight, int threads = 0);	// threads <= 0 - one per hardware thread
+	~TemplateMatch();
+	TemplateMatch(const TemplateMatch& other) = delete;
+
+	// Operators
+	TemplateMatch& operator=(const TemplateMatch& other) = delete;
+
+	// Methods
+
+	// dst is getMapWidth() * getMapHeight()
+	void getScoreMap(float* dst) const;
+
+	// Best k positions by score, descending. Returns the count written to matches, <= k
+	int getTopMatches(int k, Match* matches) const;
+
+	// Inlines
+	int getMapWidth() const
+	{
+		return _pixelSum.getWidth() - _tWidth + 1;
+	}
+
+	int getMapHeight() const
+	{
+		return _pixelSum.getHeight() - _tHeight + 1;
+	}
+
+private:
+	// Buffers of a thread
+	struct LineState;
+
+	void getScoreLine(int y, LineState& state, float* dst) const;
+
+private:
+	const PixelSum& _pixelSum;
+	int _threads;
+
+	unsigned char* _template;
+	int _tWidth;
+	int _tHeight;
+
+	long long _templateSum;
+	double _templateDeviation;	// sqrt(n * S(T^2) - S(T)^2)
+
+	unsigned int* _summedSquares;
+};
+
+} // End integral
@@ -0,0 +1,136 @@
+#include "PixelThreshold.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <math.h>		// sqrt
+#include <algorithm>	// min, max, clamp
+#include <vector>
+
+#include "PixelBoxFilter.h"
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace integral {
+
+void thresholdBradley(const unsigned char* src, const unsigned int* sums, const float* widths, float height, float scale, unsigned char* dst, int len)
+{
+#ifdef __SSE2__
+	thresholdBradleySSE(src, sums, widths, height, scale, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		dst[x] = float(src[x]) * (widths[x] * height) > float(sums[x]) * scale ? 255 : 0;
+	}
+#endif // __SSE2__
+}
+
+void thresholdSauvola(const unsigned char* src, const unsigned int* sums, const unsigned int* squares, const float* widths, float height, float k, float invRange, unsigned char* dst, int len)
+{
+#ifdef __SSE2__
+	thresholdSauvolaSSE(src, sums, squares, widths, height, k, invRange, dst, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		float invArea = 1.0f / (widths[x] * height);
+		float mean = float(sums[x]) * invArea;
+		float deviation = sqrtf(std::max(float(squares[x]) * invArea - mean * mean, 0.0f));
+
+		dst[x] = float(src[x]) > mean * (1.0f + k * (deviation * invRange - 1.0f)) ? 255 : 0;
+	}
+#endif // __SSE2__
+}
+
+AdaptiveThreshold::AdaptiveThreshold(const PixelSum& pixelSum, Method method, int threads)
+	: _pixelSum(pixelSum)
+	, _method(method)
+	, _threads(threads)
+	, _summedSquares(nullptr)
+{
+	if (_method == Method::Sauvola)
+	{
+		int xWidth = _pixelSum.getWidth();
+		int yHeight = _pixelSum.getHeight();
+
+		_summedSquares = new unsigned int[xWidth * yHeight];
+		utils::fillSummedSquares(_pixelSum.getBuffer(), _summedSquares, xWidth, yHeight);
+	}
+}
+
+AdaptiveThreshold::~AdaptiveThreshold()
+{
+	delete[] _summedSquares;
+}
+
+void AdaptiveThreshold::apply(int radius, double k, unsigned char* dst, double range) const
+{
+	assert(dst != nullptr);
+	assert(radius >= 0);
+	assert(range > 0.0);
+
+	bool sauvola = _method == Method::Sauvola;
+
+	// The window of squares overflows uint32 above
+	if (sauvola && radius > MaxSauvolaRadius)
+	{
+		radius = MaxSauvolaRadius;
+	}
+
+	int xWidth = _pixelSum.getWidth();
+	int yHeight = _pixelSum.getHeight();
+
+	// Clamped widths of the windows. Once for all lines
+	std::vector<float> widths(xWidth);
+	for (int x = 0; x < xWidth; ++x)
+	{
+		widths[x] = float(std::min(x + radius, xWidth - 1) - std::max(x - radius, 0) + 1);
+	}
+
+	utils::parallelFor(yHeight, _threads, [&](int begin, int end) {
+		std::vector<unsigned int> top(xWidth);
+		std::vector<unsigned int> bottom(xWidth);
+		std::vector<unsigned int> sums(xWidth);
+
+		std::vector<unsigned int> squareColumns(sauvola ? xWidth : 0);
+		std::vector<unsigned int> squares(sauvola ? xWidth : 0);
+
+		for (int y = begin; y < end; ++y)
+		{
+			int y0 = y - radius - 1;
+			int y1 = std::min(y + radius, yHeight - 1);
+
+			float height = float(y1 - std::max(y0, -1));
+
+			// Columns of the band. SA(x, y1) - SA(x, y0)
+			_pixelSum.getSummedAreaLine(y1, bottom.data(), nullptr);
+
+			if (y0 >= 0)
+			{
+				_pixelSum.getSummedAreaLine(y0, top.data(), nullptr);
+				BoxFilter::getBandLine(bottom.data(), top.data(), bottom.data(), xWidth);
+			}
+
+			BoxFilter::getWindowLine(bottom.data(), xWidth, radius, sums.data());
+
+			const auto src = _pixelSum.getBuffer() + size_t(y) * xWidth;
+			auto line = dst + size_t(y) * xWidth;
+
+			if (sauvola)
+			{
+				const auto squaresTop = y0 >= 0 ? _summedSquares + size_t(y0) * xWidth : nullptr;
+				BoxFilter::getBandLine(_summedSquares + size_t(y1) * xWidth, squaresTop, squareColumns.data(), xWidth);
+
+				BoxFilter::getWindowLine(squareColumns.data(), xWidth, radius, squares.data());
+
+				thresholdSauvola(src, sums.data(), squares.data(), widths.data(), height, float(k), float(1.0 / range), line, xWidth);
+			}
+			else
+			{
+				thresholdBradley(src, sums.data(), widths.data(), height, float(1.0 - k), line, xWidth);
+			}
+		}
+	});
+}
+
+} // End integral
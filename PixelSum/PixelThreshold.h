@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumIntegral.h"
+
+namespace integral {
+
+/**
+ * Adaptive thresholding of a whole image from the summed area tables of integral::PixelSum.
+ * The window of pixel (x, y) is (x - radius, y - radius, x + radius, y + radius) clamped
+ * to the borders of the buffer. Unlike getPixelAverage the mean is divided by the clamped
+ * area, so the borders are binarized by the pixels they have.
+ *
+ * Output is 255 for pixels above the local threshold, 0 otherwise:
+ *
+ *   Bradley - B(x, y) > mean * (1 - k), k ~ 0.15
+ *   Bradley, Roth. Adaptive thresholding using the integral image. 2007
+ *
+ *   Sauvola - B(x, y) > mean * (1 + k * (deviation / range - 1)), k ~ 0.2..0.5, range = 128
+ *   Sauvola, Pietikainen. Adaptive document image binarization. 2000
+ *
+ * Sauvola needs a table of squares, it is built by the constructor and takes
+ * xWidth * yHeight * sizeof(uint32). It is modular like the sums, so a window
+ * of squares fits uint32 for radius <= 128, larger radii are clamped to it.
+ *
+ * Window bounds are computed once per line and column, a line is thresholded by SSE.
+ * Lines are split between threads.
+ */
+class PIXEL_SUM_API AdaptiveThreshold
+{
+public:
+	enum class Method
+	{
+		Bradley,
+		Sauvola
+	};
+
+	static const int MaxSauvolaRadius = 128;
+
+public:
+	// Contrustors/Destructor
+	AdaptiveThreshold(const PixelSum& pixelSum, Method method, int threads = 0);	// threads <= 0 - one per hardware thread
+	~AdaptiveThreshold();
+	AdaptiveThreshold(const AdaptiveThreshold& other) = delete;
+
+	// Operators
+	AdaptiveThreshold& operator=(const AdaptiveThreshold& other) = delete;
+
+	// Methods
+
+	// dst is xWidth * yHeight
+	void apply(int radius, double k, unsigned char* dst, double range = 128.0) const;
+
+	// Inlines
+	Method getMethod() const
+	{
+		return _method;
+	}
+
+private:
+	const PixelSum& _pixelSum;
+	Method _method;
+	int _threads;
+
+	unsigned int* _summedSquares;
+};
+
+} // End integral
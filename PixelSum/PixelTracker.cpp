@@ -0,0 +1,233 @@
+#include "PixelTracker.h"
+
+#include <string.h>		// memcpy
+#include <stdlib.h>		// malloc, free, rand
+#include <assert.h>
+#include <algorithm>	// min, max, clamp
+
+#include "Utils.h"
+
+#include "SSE.h"
+
+namespace naivev2 {
+
+void updateColumns(const unsigned char* src, bool subtract, unsigned int* sums, unsigned int* counts, int len)
+{
+#ifdef __SSE2__
+	updateColumnsU8SSE(src, subtract, sums, counts, len);
+#else
+	for (int x = 0; x < len; ++x)
+	{
+		unsigned int value = src[x];
+		unsigned int count = src[x] != 0 ? 1 : 0;
+
+		sums[x] += subtract ? 0u - value : value;
+		counts[x] += subtract ? 0u - count : count;
+	}
+#endif // __SSE2__
+}
+
+WindowTracker::WindowTracker(const PixelSum& pixelSum, int x0, int y0, int x1, int y1)
+	: _pixelSum(pixelSum)
+{
+	_columnSums = new unsigned int[_pixelSum.getWidth()];
+	_columnCounts = new unsigned int[_pixelSum.getWidth()];
+
+	// Empty window, the first setWindow is a scan
+	_minX = 0;
+	_minY = 0;
+	_maxX = -1;
+	_maxY = -1;
+
+	setWindow(x0, y0, x1, y1);
+}
+
+WindowTracker::~WindowTracker()
+{
+	delete[] _columnCounts;
+	delete[] _columnSums;
+}
+
+void WindowTracker::move(int dx, int dy)
+{
+	setWindow(_x0 + dx, _y0 + dy, _x1 + dx, _y1 + dy);
+}
+
+void WindowTracker::setWindow(int x0, int y0, int x1, int y1)
+{
+	_x0 = x0;
+	_y0 = y0;
+	_x1 = x1;
+	_y1 = y1;
+
+	// Prepare
+	auto rect = utils::Rect(x0, y0, x1, y1)
+		.normalized()
+		.intersected(0, 0, _pixelSum.getWidth() - 1, _pixelSum.getHeight() - 1);
+
+	// Columns and lines of both windows
+	int keepX0 = std::max(rect.x0, _minX);
+	int keepX1 = std::min(rect.x1, _maxX);
+	int keepY0 = std::max(rect.y0, _minY);
+	int keepY1 = std::min(rect.y1, _maxY);
+
+	if (keepX0 > keepX1 || keepY0 > keepY1)
+	{
+		// Rescan
+		_sum = 0;
+		_count = 0;
+
+		addColumns(rect.x0, rect.y0, rect.x1, rect.y1);
+	}
+	else
+	{
+		// Columns that leave
+		for (int x = _minX; x <= _maxX; ++x)
+		{
+			if (x < keepX0 || x > keepX1)
+			{
+				_sum -= _columnSums[x];
+				_count -= _columnCounts[x];
+			}
+		}
+
+		// Lines that leave and enter, kept columns only
+		if (_minY < keepY0)
+		{
+			updateStrip(keepX0, _minY, keepX1, keepY0 - 1, true);
+		}
+
+		if (_maxY > keepY1)
+		{
+			updateStrip(keepX0, keepY1 + 1, keepX1, _maxY, true);
+		}
+
+		if (rect.y0 < keepY0)
+		{
+			updateStrip(keepX0, rect.y0, keepX1, keepY0 - 1, false);
+		}
+
+		if (rect.y1 > keepY1)
+		{
+			updateStrip(keepX0, keepY1 + 1, keepX1, rect.y1, false);
+		}
+
+		// Columns that enter, all lines of the window
+		if (rect.x0 < keepX0)
+		{
+			addColumns(rect.x0, rect.y0, keepX0 - 1, rect.y1);
+		}
+
+		if (rect.x1 > keepX1)
+		{
+			addColumns(keepX1 + 1, rect.y0, rect.x1, rect.y1);
+		}
+	}
+
+	_minX = rect.x0;
+	_minY = rect.y0;
+	_maxX = rect.x1;
+	_maxY = rect.y1;
+}
+
+unsigned int WindowTracker::getPixelSum() const
+{
+	return _sum;
+}
+
+double WindowTracker::getPixelAverage() const
+{
+	// Same as naivev2::PixelSum, divided by the unclamped area
+	int width = std::abs(_x1 - _x0) + 1;
+	int height = std::abs(_y1 - _y0) + 1;
+
+	return double(_sum) / double(width * height);
+}
+
+int WindowTracker::getNonZeroCount() const
+{
+	return int(_count);
+}
+
+double WindowTracker::getNonZeroAverage() const
+{
+	return _count != 0 ? double(_sum) / double(_count) : 0.0;
+}
+
+void WindowTracker::updateStrip(int x0, int y0, int x1, int y1, bool subtract)
+{
+	const auto buffer = _pixelSum.getBuffer();
+	int xWidth = _pixelSum.getWidth();
+	int stripWidth = x1 - x0 + 1;
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		auto ptr = buffer + x0 + y * xWidth;
+
+		updateColumns(ptr, subtract, _columnSums + x0, _columnCounts + x0, stripWidth);
+
+#ifdef __SSE2__
+		unsigned int lineSum;
+		unsigned int lineCount;
+		sumAndCountNonZeroSSE(ptr, stripWidth, lineSum, lineCount);
+#else
+		unsigned int lineSum = 0;
+		unsigned int lineCount = 0;
+
+		for (int x = 0; x < stripWidth; ++x)
+		{
+			lineSum += ptr[x];
+			lineCount += ptr[x] != 0 ? 1 : 0;
+		}
+#endif // __SSE2__
+
+		_sum += subtract ? 0u - lineSum : lineSum;
+		_count += subtract ? 0u - lineCount : lineCount;
+	}
+}
+
+void WindowTracker::addColumns(int x0, int y0, int x1, int y1)
+{
+	const auto buffer = _pixelSum.getBuffer();
+	int xWidth = _pixelSum.getWidth();
+	int stripWidth = x1 - x0 + 1;
+
+	if (stripWidth < 16)
+	{
+		// Steps of a few pixels. Column by column, shorter than one SSE register
+		for (int x = x0; x <= x1; ++x)
+		{
+			auto ptr = buffer + x + y0 * xWidth;
+
+			unsigned int sum = 0;
+			unsigned int count = 0;
+
+			for (int y = y0; y <= y1; ++y, ptr += xWidth)
+			{
+				sum += *ptr;
+				count += *ptr != 0 ? 1 : 0;
+			}
+
+			_columnSums[x] = sum;
+			_columnCounts[x] = count;
+		}
+	}
+	else
+	{
+		std::fill(_columnSums + x0, _columnSums + x1 + 1, 0u);
+		std::fill(_columnCounts + x0, _columnCounts + x1 + 1, 0u);
+
+		for (int y = y0; y <= y1; ++y)
+		{
+			updateColumns(buffer + x0 + y * xWidth, false, _columnSums + x0, _columnCounts + x0, stripWidth);
+		}
+	}
+
+	for (int x = x0; x <= x1; ++x)
+	{
+		_sum += _columnSums[x];
+		_count += _columnCounts[x];
+	}
+}
+
+} // End naivev2
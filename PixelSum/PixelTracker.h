@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Common.h"
+#include "PixelSumNaiveV2.h"
+
+namespace naivev2 {
+
+/**
+ * Incremental region queries of a window that moves over the buffer of naivev2::PixelSum.
+ * The window is clamped to the borders of the buffer the same way as the region queries,
+ * results are equal to getPixelSum(x0, y0, x1, y1) etc. of the current window.
+ *
+ * Sums and non-zero counts of the columns of the window are kept. A move is split into
+ * strips: lines that enter or leave are added to or subtracted from the columns, columns
+ * that enter are summed over the lines of the window, columns that leave are dropped.
+ * Strips are updated by SSE line by line, so a move by (dx, dy) is
+ * O(|dx| * height + |dy| * width) instead of O(width * height) of a rescan.
+ * Windows that do not overlap and resized windows are handled the same way,
+ * without overlap it is a rescan.
+ *
+ * Memory: xWidth * sizeof(uint32) * 2
+ */
+class PIXEL_SUM_API WindowTracker
+{
+public:
+	// Contrustors/Destructor
+	WindowTracker(const PixelSum& pixelSum, int x0, int y0, int x1, int y1);
+	~WindowTracker();
+	WindowTracker(const WindowTracker& other) = delete;
+
+	// Operators
+	WindowTracker& operator=(const WindowTracker& other) = delete;
+
+	// Methods
+	void move(int dx, int dy);
+	void setWindow(int x0, int y0, int x1, int y1);
+
+	unsigned int getPixelSum() const;
+	double getPixelAverage() const;
+
+	int getNonZeroCount() const;
+	double getNonZeroAverage() const;
+
+	// Inlines. The window as set, not clamped
+	int getX0() const
+	{
+		return _x0;
+	}
+
+	int getY0() const
+	{
+		return _y0;
+	}
+
+	int getX1() const
+	{
+		return _x1;
+	}
+
+	int getY1() const
+	{
+		return _y1;
+	}
+
+private:
+	// Adds (subtracts) lines y0..y1 of columns x0..x1 to the columns and to the totals
+	void updateStrip(int x0, int y0, int x1, int y1, bool subtract);
+
+	// Sums columns x0..x1 over lines y0..y1 and adds them to the totals
+	void addColumns(int x0, int y0, int x1, int y1);
+
+private:
+	const PixelSum& _pixelSum;
+
+	unsigned int* _columnSums;
+	unsigned int* _columnCounts;
+
+	// Window as set
+	int _x0;
+	int _y0;
+	int _x1;
+	int _y1;
+
+	// Clamped window, the columns and the totals are of it
+	int _minX;
+	int _minY;
+	int _maxX;
+	int _maxY;
+
+	unsigned int _sum;
+	unsigned int _count;
+};
+
+} // End naivev2
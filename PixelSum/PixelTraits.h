@@ -0,0 +1,27 @@
+#pragma once
+
+namespace utils {
+
+// Accumulator types per pixel type. Sums of a 4096 x 4096 buffer must not overflow
+template<class TPixel>
+struct PixelTraits;
+
+template<>
+struct PixelTraits<unsigned char>
+{
+	typedef unsigned int Sum;		// 4096 * 4096 * 256 == max(uint32)
+};
+
+template<>
+struct PixelTraits<unsigned short>
+{
+	typedef unsigned long long Sum;
+};
+
+template<>
+struct PixelTraits<float>
+{
+	typedef double Sum;
+};
+
+} // End utils
@@ -1,6 +1,8 @@
 #include "SSE.h"
 
+#include <string.h>		// memcpy
 #include <algorithm>	// min
+#include <cmath>		// sqrt
 #include <immintrin.h>	// SSE instructions
 
 
@@ -89,7 +91,7 @@ int sumSSE(const unsigned char* data, int len)
 		for (; x < tmpLen; x += nlanes)
 		{
 			// 16 x 8bits
-			__m128i src = _mm_load_si128(reinterpret_cast<const __m128i*>(&data[x]));
+			__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[x]));
 			xSum16 = add_u16_u8(xSum16, src);
 		}
 
@@ -131,7 +133,7 @@ int countNonZeroSSE(const unsigned char* data, int len)
 		for (; x < tmpLen; x += nlanes)
 		{
 			// 16 x 8bits
-			__m128i src = _mm_load_si128(reinterpret_cast<const __m128i*>(&data[x]));
+			__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[x]));
 
 			__m128i nonZero = non_zero(src);
 			xCount16 = add_u16_u8(xCount16, nonZero);
@@ -176,7 +178,7 @@ void sumAndCountNonZeroSSE(const unsigned char* data, int len, unsigned int& sum
 		for (; x < tmpLen; x += nlanes)
 		{
 			// 16 x 8bits
-			__m128i src = _mm_load_si128(reinterpret_cast<const __m128i*>(&data[x]));
+			__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[x]));
 
 			// Sum
 			xSum16 = add_u16_u8(xSum16, src);
@@ -219,11 +221,10 @@ void sumArraySSE(const unsigned int* src0, const unsigned int* src1, unsigned in
 	while (x < roundedLen)
 	{
 		// 4 x 32bits
-		__m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(&src0[x]));
-		__m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(&src1[x]));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[x]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[x]));
 
-		__m128i& result = *reinterpret_cast<__m128i*>(&dst[x]);
-		result = _mm_add_epi32(a, b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), _mm_add_epi32(a, b));
 
 		x += nlanes;
 	}
@@ -235,6 +236,7 @@ void sumArraySSE(const unsigned int* src0, const unsigned int* src1, unsigned in
 	while (x < len)
 	{
 		dst[x] = src0[x] + src1[x];
+		++x;
 	}
 }
 
@@ -554,4 +556,1297 @@ void fillSummedAreaSSE(const unsigned char* buffer, unsigned int* summedArea, un
 			xWidth
 		);
 	}
+}
+
+void fillHistogramLineSSE(const unsigned char* src, const unsigned short* prevLine, unsigned short* line, int xWidth, int bins, int binShift)
+{
+	int nlanes = 8;
+	int nregs = bins / nlanes;
+
+	// Running counts of the line and bin indices. bins x 16bits
+	__m128i rowCount[256 / 8];
+	__m128i binIndex[256 / 8];
+
+	for (int i = 0; i < nregs; ++i)
+	{
+		rowCount[i] = _mm_setzero_si128();
+		binIndex[i] = _mm_add_epi16(_mm_set1_epi16(short(i * nlanes)), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+	}
+
+	for (int x = 0; x < xWidth; ++x)
+	{
+		__m128i bin = _mm_set1_epi16(short(src[x] >> binShift));
+
+		auto dst = line + x * bins;
+		auto prev = prevLine + x * bins;
+
+		for (int i = 0; i < nregs; ++i)
+		{
+			// [0000/FFFF] == -1 for the bin of the pixel
+			rowCount[i] = _mm_sub_epi16(rowCount[i], _mm_cmpeq_epi16(binIndex[i], bin));
+
+			__m128i value = rowCount[i];
+			if (prevLine != nullptr)
+			{
+				value = _mm_add_epi16(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i * nlanes)));
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * nlanes), value);
+		}
+	}
+}
+
+void addLineU32U16SSE(const unsigned int* base, const unsigned short* line, unsigned int* dst, int len)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	int nlanes = 8;
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 8 x 16bits
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x));
+
+		// 2 x 4 x 32bits
+		__m128i lower = _mm_unpacklo_epi16(value, zero);
+		__m128i higher = _mm_unpackhi_epi16(value, zero);
+
+		lower = _mm_add_epi32(lower, _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + x)));
+		higher = _mm_add_epi32(higher, _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + x + 4)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), lower);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), higher);
+	}
+
+	// Add single values
+	while (x < len)
+	{
+		dst[x] = base[x] + line[x];
+		++x;
+	}
+}
+
+_inline unsigned char reduce_min_u8(__m128i a)
+{
+	a = _mm_min_epu8(a, _mm_srli_si128(a, 8));
+	a = _mm_min_epu8(a, _mm_srli_si128(a, 4));
+	a = _mm_min_epu8(a, _mm_srli_si128(a, 2));
+	a = _mm_min_epu8(a, _mm_srli_si128(a, 1));
+
+	return (unsigned char)_mm_cvtsi128_si32(a);
+}
+
+_inline unsigned char reduce_max_u8(__m128i a)
+{
+	a = _mm_max_epu8(a, _mm_srli_si128(a, 8));
+	a = _mm_max_epu8(a, _mm_srli_si128(a, 4));
+	a = _mm_max_epu8(a, _mm_srli_si128(a, 2));
+	a = _mm_max_epu8(a, _mm_srli_si128(a, 1));
+
+	return (unsigned char)_mm_cvtsi128_si32(a);
+}
+
+void minArraySSE(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_min_epu8(va, vb));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = std::min(a[x], b[x]);
+	}
+}
+
+void maxArraySSE(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_max_epu8(va, vb));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = std::max(a[x], b[x]);
+	}
+}
+
+unsigned char minSSE(const unsigned char* data, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	unsigned char result = 255;
+
+	int roundedLen = len & -nlanes;
+	if (roundedLen > 0)
+	{
+		// 16 x 8bits
+		__m128i xMin = _mm_set1_epi8(char(0xFF));
+		for (; x < roundedLen; x += nlanes)
+		{
+			xMin = _mm_min_epu8(xMin, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + x)));
+		}
+
+		result = reduce_min_u8(xMin);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		result = std::min(result, data[x]);
+	}
+
+	return result;
+}
+
+unsigned char maxSSE(const unsigned char* data, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	unsigned char result = 0;
+
+	int roundedLen = len & -nlanes;
+	if (roundedLen > 0)
+	{
+		// 16 x 8bits
+		__m128i xMax = _mm_setzero_si128();
+		for (; x < roundedLen; x += nlanes)
+		{
+			xMax = _mm_max_epu8(xMax, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + x)));
+		}
+
+		result = reduce_max_u8(xMax);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		result = std::max(result, data[x]);
+	}
+
+	return result;
+}
+
+void extractBitsSSE(const unsigned char* data, int len, int bit, unsigned long long* bits)
+{
+	int nlanes = 64;
+	int x = 0;
+
+	// Move the bit to the sign bit of 8 bits lanes
+	const __m128i shift = _mm_cvtsi32_si128(7 - bit);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		unsigned long long word = 0;
+
+		for (int i = 0; i < nlanes; i += 16)
+		{
+			// 16 x 8bits
+			__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + x + i));
+			value = _mm_sll_epi16(value, shift);
+
+			word |= (unsigned long long)(unsigned int)_mm_movemask_epi8(value) << i;
+		}
+
+		bits[x / nlanes] = word;
+	}
+
+	// Single values
+	if (x < len)
+	{
+		unsigned long long word = 0;
+		for (int i = 0; x + i < len; ++i)
+		{
+			word |= (unsigned long long)((data[x + i] >> bit) & 1) << i;
+		}
+
+		bits[x / nlanes] = word;
+	}
+}
+
+void lumaInterleavedSSE(const unsigned char* src, int channels, short w0, short w1, short w2, unsigned char* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i weights = _mm_setr_epi16(w0, w1, w2, 0, w0, w1, w2, 0);
+
+	// 4 pixels of 3 channels to 4 channels. The 4th channel is zero
+	const __m128i expandRGB = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+	// 16 bytes are loaded for 4 pixels of 3 channels. Do not read after the end
+	int roundedLen = (channels == 3 ? len - 2 : len) & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		__m128i luma[4];
+
+		for (int i = 0; i < 4; ++i)
+		{
+			// 4 pixels x 4 x 8bits
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (x + i * 4) * channels));
+			if (channels == 3)
+			{
+				pixels = _mm_shuffle_epi8(pixels, expandRGB);
+			}
+
+			// 2 x 2 pixels x 4 x 16bits. Partial sums of 2 channels in 32bits, then per pixel
+			__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+			__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+
+			luma[i] = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(lo, hi), round), 8);
+		}
+
+		// 16 x 8bits
+		__m128i result = _mm_packus_epi16(_mm_packs_epi32(luma[0], luma[1]), _mm_packs_epi32(luma[2], luma[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), result);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		const auto pixel = src + x * channels;
+		dst[x] = (unsigned char)((w0 * pixel[0] + w1 * pixel[1] + w2 * pixel[2] + 128) >> 8);
+	}
+}
+
+void lumaPlanarSSE(const unsigned char* src0, const unsigned char* src1, const unsigned char* src2, short w0, short w1, short w2, unsigned char* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(128);
+	const __m128i weight0 = _mm_set1_epi16(w0);
+	const __m128i weight1 = _mm_set1_epi16(w1);
+	const __m128i weight2 = _mm_set1_epi16(w2);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits of every plane
+		__m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + x));
+		__m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x));
+		__m128i c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + x));
+
+		// 2 x 8 x 16bits. The sum is <= 255 * 256 + 128, so it fits unsigned 16bits
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(c0, zero), weight0);
+		lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(c1, zero), weight1));
+		lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(c2, zero), weight2));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(c0, zero), weight0);
+		hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(c1, zero), weight1));
+		hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(c2, zero), weight2));
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = (unsigned char)((w0 * src0[x] + w1 * src1[x] + w2 * src2[x] + 128) >> 8);
+	}
+}
+
+_inline __m128i add_u64_u32(__m128i u64, __m128i u32)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	// Make 2 x 2 x 64bits
+	__m128i lower = _mm_unpacklo_epi32(u32, zero);
+	__m128i higher = _mm_unpackhi_epi32(u32, zero);
+
+	return _mm_add_epi64(u64, _mm_add_epi64(lower, higher));
+}
+
+inline unsigned long long reduce_u64(__m128i a)
+{
+	unsigned long long values[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(values), a);
+
+	return values[0] + values[1];
+}
+
+inline double reduce_f64(__m128d a)
+{
+	double values[2];
+	_mm_storeu_pd(values, a);
+
+	return values[0] + values[1];
+}
+
+// -1 in 16bits lanes of non zero values
+_inline __m128i non_zero_mask16(__m128i values)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(-1);
+
+	return _mm_andnot_si128(_mm_cmpeq_epi16(values, zero), ones);
+}
+
+unsigned long long sumSSE(const unsigned short* data, int len)
+{
+	unsigned long long sum;
+	unsigned int countNonZero;
+
+	sumAndCountNonZeroSSE(data, len, sum, countNonZero);
+
+	return sum;
+}
+
+int countNonZeroSSE(const unsigned short* data, int len)
+{
+	int nlanes = 8;
+
+	// 4 x 32bits
+	__m128i xCount32 = _mm_setzero_si128();
+
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	while (x < roundedLen)
+	{
+		// 8 x 16bits
+		__m128i xCount16 = _mm_setzero_si128();
+
+		int tmpLen = std::min(x + 32767 * nlanes, roundedLen);
+		for (; x < tmpLen; x += nlanes)
+		{
+			// 8 x 16bits
+			__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[x]));
+
+			// count -= -1
+			xCount16 = _mm_sub_epi16(xCount16, non_zero_mask16(src));
+		}
+
+		xCount32 = add_u32_u16(xCount32, xCount16);
+	}
+
+	int count = reduce_u32(xCount32);
+
+	// Add single values
+	for (; x < len; ++x)
+	{
+		count += data[x] != 0 ? 1 : 0;
+	}
+
+	return count;
+}
+
+void sumAndCountNonZeroSSE(const unsigned short* data, int len, unsigned long long& sum, unsigned int& countNonZero)
+{
+	int nlanes = 8;
+
+	// 2 x 64bits
+	__m128i xSum64 = _mm_setzero_si128();
+
+	// 4 x 32bits
+	__m128i xCount32 = _mm_setzero_si128();
+
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	while (x < roundedLen)
+	{
+		// 4 x 32bits. 2 * 65535 per iteration
+		__m128i xSum32 = _mm_setzero_si128();
+		__m128i xCount16 = _mm_setzero_si128();
+
+		int tmpLen = std::min(x + 16384 * nlanes, roundedLen);
+		for (; x < tmpLen; x += nlanes)
+		{
+			// 8 x 16bits
+			__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[x]));
+
+			// Sum
+			xSum32 = add_u32_u16(xSum32, src);
+
+			// Count
+			xCount16 = _mm_sub_epi16(xCount16, non_zero_mask16(src));
+		}
+
+		xSum64 = add_u64_u32(xSum64, xSum32);
+		xCount32 = add_u32_u16(xCount32, xCount16);
+	}
+
+	sum = reduce_u64(xSum64);
+	countNonZero = reduce_u32(xCount32);
+
+	// Add single values
+	for (; x < len; ++x)
+	{
+		sum += data[x];
+		countNonZero += data[x] != 0 ? 1 : 0;
+	}
+}
+
+double sumSSE(const float* data, int len)
+{
+	double sum;
+	unsigned int countNonZero;
+
+	sumAndCountNonZeroSSE(data, len, sum, countNonZero);
+
+	return sum;
+}
+
+int countNonZeroSSE(const float* data, int len)
+{
+	int nlanes = 4;
+
+	const __m128 zero = _mm_setzero_ps();
+
+	// 4 x 32bits
+	__m128i xCount32 = _mm_setzero_si128();
+
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 src = _mm_loadu_ps(&data[x]);
+
+		// count -= -1
+		xCount32 = _mm_sub_epi32(xCount32, _mm_castps_si128(_mm_cmpneq_ps(src, zero)));
+	}
+
+	int count = reduce_u32(xCount32);
+
+	// Add single values
+	for (; x < len; ++x)
+	{
+		count += data[x] != 0 ? 1 : 0;
+	}
+
+	return count;
+}
+
+void sumAndCountNonZeroSSE(const float* data, int len, double& sum, unsigned int& countNonZero)
+{
+	int nlanes = 4;
+
+	const __m128 zero = _mm_setzero_ps();
+
+	// 2 x 2 x double. Float values are summed in double to limit the error growth
+	__m128d xSumLower = _mm_setzero_pd();
+	__m128d xSumHigher = _mm_setzero_pd();
+
+	// 4 x 32bits
+	__m128i xCount32 = _mm_setzero_si128();
+
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 src = _mm_loadu_ps(&data[x]);
+
+		// Sum
+		xSumLower = _mm_add_pd(xSumLower, _mm_cvtps_pd(src));
+		xSumHigher = _mm_add_pd(xSumHigher, _mm_cvtps_pd(_mm_movehl_ps(src, src)));
+
+		// Count
+		xCount32 = _mm_sub_epi32(xCount32, _mm_castps_si128(_mm_cmpneq_ps(src, zero)));
+	}
+
+	sum = reduce_f64(_mm_add_pd(xSumLower, xSumHigher));
+	countNonZero = reduce_u32(xCount32);
+
+	// Add single values
+	for (; x < len; ++x)
+	{
+		sum += data[x];
+		countNonZero += data[x] != 0 ? 1 : 0;
+	}
+}
+
+void subtractArraySSE(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x 32bits
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[x]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[x]));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), _mm_sub_epi32(a, b));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = src0[x] - src1[x];
+	}
+}
+
+// 4 x uint32 to 4 x float. _mm_cvtepi32_ps is signed, so convert 16 bits halves
+_inline __m128 cvt_f32_u32(__m128i values)
+{
+	const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+	const __m128 highScale = _mm_set1_ps(65536.0f);
+
+	__m128 low = _mm_cvtepi32_ps(_mm_and_si128(values, lowMask));
+	__m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(values, 16));
+
+	return _mm_add_ps(_mm_mul_ps(high, highScale), low);
+}
+
+void convertScaleU32SSE(const unsigned int* src, float scale, float* dst, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128 xScale = _mm_set1_ps(scale);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x 32bits
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+
+		_mm_storeu_ps(&dst[x], _mm_mul_ps(cvt_f32_u32(values), xScale));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = float(src[x]) * scale;
+	}
+}
+
+void divideU32SSE(const unsigned int* src0, const unsigned int* src1, float* dst, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x 32bits
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[x]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[x]));
+
+		// Zero where b == 0. Division by zero gives inf/nan in these lanes only
+		__m128 nonZero = _mm_castsi128_ps(_mm_andnot_si128(_mm_cmpeq_epi32(b, zero), _mm_set1_epi32(-1)));
+		__m128 result = _mm_div_ps(cvt_f32_u32(a), cvt_f32_u32(b));
+
+		_mm_storeu_ps(&dst[x], _mm_and_ps(result, nonZero));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = src1[x] != 0 ? float(src0[x]) / float(src1[x]) : 0.0f;
+	}
+}
+
+// 4 x 8bits of src to 4 x float
+_inline __m128 cvt_f32_u8(const unsigned char* src)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	int packed;
+	memcpy(&packed, src, sizeof(packed));
+
+	__m128i values = _mm_cvtsi32_si128(packed);
+	values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(values, zero), zero);
+
+	return _mm_cvtepi32_ps(values);
+}
+
+// 4 x [00/FF] 32bits masks to 4 x 8bits of dst
+_inline void store_mask_u8(__m128 mask, unsigned char* dst)
+{
+	__m128i values = _mm_castps_si128(mask);
+	values = _mm_packs_epi32(values, values);
+	values = _mm_packs_epi16(values, values);
+
+	int packed = _mm_cvtsi128_si32(values);
+	memcpy(dst, &packed, sizeof(packed));
+}
+
+void thresholdBradleySSE(const unsigned char* src, const unsigned int* sums, const float* widths, float height, float scale, unsigned char* dst, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128 xHeight = _mm_set1_ps(height);
+	const __m128 xScale = _mm_set1_ps(scale);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 area = _mm_mul_ps(_mm_loadu_ps(&widths[x]), xHeight);
+		__m128 value = _mm_mul_ps(cvt_f32_u8(&src[x]), area);
+		__m128 threshold = _mm_mul_ps(cvt_f32_u32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&sums[x]))), xScale);
+
+		store_mask_u8(_mm_cmpgt_ps(value, threshold), &dst[x]);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = float(src[x]) * (widths[x] * height) > float(sums[x]) * scale ? 255 : 0;
+	}
+}
+
+void thresholdSauvolaSSE(const unsigned char* src, const unsigned int* sums, const unsigned int* squares, const float* widths, float height, float k, float invRange, unsigned char* dst, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 xHeight = _mm_set1_ps(height);
+	const __m128 xK = _mm_set1_ps(k);
+	const __m128 xInvRange = _mm_set1_ps(invRange);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 invArea = _mm_div_ps(one, _mm_mul_ps(_mm_loadu_ps(&widths[x]), xHeight));
+
+		__m128 mean = _mm_mul_ps(cvt_f32_u32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&sums[x]))), invArea);
+		__m128 meanSquare = _mm_mul_ps(cvt_f32_u32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&squares[x]))), invArea);
+
+		// Rounding can make the variance slightly negative
+		__m128 deviation = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(meanSquare, _mm_mul_ps(mean, mean)), zero));
+
+		// T = mean * (1 + k * (deviation / R - 1))
+		__m128 threshold = _mm_mul_ps(mean, _mm_add_ps(one, _mm_mul_ps(xK, _mm_sub_ps(_mm_mul_ps(deviation, xInvRange), one))));
+
+		store_mask_u8(_mm_cmpgt_ps(cvt_f32_u8(&src[x]), threshold), &dst[x]);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		float invArea = 1.0f / (widths[x] * height);
+		float mean = float(sums[x]) * invArea;
+		float deviation = std::sqrt(std::max(float(squares[x]) * invArea - mean * mean, 0.0f));
+
+		dst[x] = float(src[x]) > mean * (1.0f + k * (deviation * invRange - 1.0f)) ? 255 : 0;
+	}
+}
+
+void convertScaleRoundU32SSE(const unsigned int* src, const float* scales, float scale, unsigned char* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128 xScale = _mm_set1_ps(scale);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x 4 x float, truncated after + 0.5. Values are not negative
+		__m128i values[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128 value = cvt_f32_u32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x + i * 4])));
+			value = _mm_mul_ps(_mm_mul_ps(value, _mm_loadu_ps(&scales[x + i * 4])), xScale);
+
+			values[i] = _mm_cvttps_epi32(_mm_add_ps(value, half));
+		}
+
+		// 16 x 8bits
+		__m128i result = _mm_packus_epi16(_mm_packs_epi32(values[0], values[1]), _mm_packs_epi32(values[2], values[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), result);
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] = (unsigned char)std::min(float(src[x]) * scales[x] * scale + 0.5f, 255.0f);
+	}
+}
+
+void multiplyAddU8SSE(const unsigned char* src, unsigned int weight, unsigned int* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i xWeight = _mm_set1_epi16(short(weight));
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+
+		// 2 x 8 x 16bits. Products <= 255 * 255 fit unsigned 16 bits
+		__m128i productsLow = _mm_mullo_epi16(_mm_unpacklo_epi8(values, zero), xWeight);
+		__m128i productsHigh = _mm_mullo_epi16(_mm_unpackhi_epi8(values, zero), xWeight);
+
+		// 4 x 4 x 32bits
+		__m128i* sums = reinterpret_cast<__m128i*>(&dst[x]);
+
+		_mm_storeu_si128(sums + 0, _mm_add_epi32(_mm_loadu_si128(sums + 0), _mm_unpacklo_epi16(productsLow, zero)));
+		_mm_storeu_si128(sums + 1, _mm_add_epi32(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi16(productsLow, zero)));
+		_mm_storeu_si128(sums + 2, _mm_add_epi32(_mm_loadu_si128(sums + 2), _mm_unpacklo_epi16(productsHigh, zero)));
+		_mm_storeu_si128(sums + 3, _mm_add_epi32(_mm_loadu_si128(sums + 3), _mm_unpackhi_epi16(productsHigh, zero)));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] += src[x] * weight;
+	}
+}
+
+// Low 32 bits of 4 x 32bits products
+_inline __m128i mullo_u32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+void combineLanesSSE(const unsigned int* corners, const int* offsets, const int* indices, const int* weights, int count, int* dst)
+{
+	const __m128i* lanes = reinterpret_cast<const __m128i*>(corners);
+
+	for (int i = 0; i < count; ++i)
+	{
+		__m128i sum = _mm_setzero_si128();
+
+		for (int t = offsets[i]; t < offsets[i + 1]; ++t)
+		{
+			// 4 x 32bits
+			__m128i values = _mm_loadu_si128(lanes + indices[t]);
+			sum = _mm_add_epi32(sum, mullo_u32(values, _mm_set1_epi32(weights[t])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i * 4]), sum);
+	}
+}
+
+void gradientBinsSSE(const unsigned char* left, const unsigned char* right, const unsigned char* above, const unsigned char* below,
+	const float* cosines, const float* sines, int boundaries, unsigned char* bins, unsigned short* magnitudes, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 gx = _mm_sub_ps(cvt_f32_u8(&right[x]), cvt_f32_u8(&left[x]));
+		__m128 gy = _mm_sub_ps(cvt_f32_u8(&below[x]), cvt_f32_u8(&above[x]));
+
+		__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+
+		// Opposite directions are the same orientation
+		__m128 flip = _mm_or_ps(_mm_cmplt_ps(gy, zero), _mm_and_ps(_mm_cmpeq_ps(gy, zero), _mm_cmplt_ps(gx, zero)));
+		gx = _mm_xor_ps(gx, _mm_and_ps(flip, signBit));
+		gy = _mm_xor_ps(gy, _mm_and_ps(flip, signBit));
+
+		__m128 bin = zero;
+		for (int k = 0; k < boundaries; ++k)
+		{
+			__m128 side = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(cosines[k]), gy), _mm_mul_ps(_mm_set1_ps(sines[k]), gx));
+			bin = _mm_add_ps(bin, _mm_and_ps(_mm_cmpgt_ps(side, zero), one));
+		}
+
+		int binValues[4];
+		int magnitudeValues[4];
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(binValues), _mm_cvttps_epi32(bin));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(magnitudeValues), _mm_cvttps_epi32(_mm_add_ps(magnitude, half)));
+
+		for (int i = 0; i < nlanes; ++i)
+		{
+			bins[x + i] = (unsigned char)binValues[i];
+			magnitudes[x + i] = (unsigned short)magnitudeValues[i];
+		}
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		float gx = float(right[x]) - float(left[x]);
+		float gy = float(below[x]) - float(above[x]);
+
+		magnitudes[x] = (unsigned short)(sqrtf(gx * gx + gy * gy) + 0.5f);
+
+		if (gy < 0.0f || (gy == 0.0f && gx < 0.0f))
+		{
+			gx = -gx;
+			gy = -gy;
+		}
+
+		int bin = 0;
+		for (int k = 0; k < boundaries; ++k)
+		{
+			bin += cosines[k] * gy - sines[k] * gx > 0.0f ? 1 : 0;
+		}
+
+		bins[x] = (unsigned char)bin;
+	}
+}
+
+void addNonZeroU8SSE(const unsigned char* src, unsigned int* dst, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits of 0/1
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+		__m128i nonZero = _mm_andnot_si128(_mm_cmpeq_epi8(values, zero), one);
+
+		__m128i nonZeroLow = _mm_unpacklo_epi8(nonZero, zero);
+		__m128i nonZeroHigh = _mm_unpackhi_epi8(nonZero, zero);
+
+		// 4 x 4 x 32bits
+		__m128i* counts = reinterpret_cast<__m128i*>(&dst[x]);
+
+		_mm_storeu_si128(counts + 0, _mm_add_epi32(_mm_loadu_si128(counts + 0), _mm_unpacklo_epi16(nonZeroLow, zero)));
+		_mm_storeu_si128(counts + 1, _mm_add_epi32(_mm_loadu_si128(counts + 1), _mm_unpackhi_epi16(nonZeroLow, zero)));
+		_mm_storeu_si128(counts + 2, _mm_add_epi32(_mm_loadu_si128(counts + 2), _mm_unpacklo_epi16(nonZeroHigh, zero)));
+		_mm_storeu_si128(counts + 3, _mm_add_epi32(_mm_loadu_si128(counts + 3), _mm_unpackhi_epi16(nonZeroHigh, zero)));
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		dst[x] += src[x] != 0 ? 1 : 0;
+	}
+}
+
+// Prefix sums of 8 x 16bits
+_inline __m128i prefix_sum_u16(__m128i values)
+{
+	values = _mm_add_epi16(values, _mm_slli_si128(values, 2));
+	values = _mm_add_epi16(values, _mm_slli_si128(values, 4));
+	values = _mm_add_epi16(values, _mm_slli_si128(values, 8));
+
+	return values;
+}
+
+void maskedRowSumsSSE(const unsigned char* src, const unsigned char* mask, unsigned int* rowSum, unsigned int* rowCount, int len)
+{
+	int nlanes = 8;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+
+	// Totals of the previous pixels in all lanes
+	__m128i sumCarry = zero;
+	__m128i countCarry = zero;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 8 x 16bits, 0xFFFF under the mask
+		__m128i values = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[x])), zero);
+		__m128i masks = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&mask[x])), zero);
+		masks = _mm_andnot_si128(_mm_cmpeq_epi16(masks, zero), _mm_set1_epi16(-1));
+
+		// Fits 16 bits, 8 * 255
+		__m128i sums = prefix_sum_u16(_mm_and_si128(values, masks));
+		__m128i counts = prefix_sum_u16(_mm_and_si128(one, masks));
+
+		// 2 x 4 x 32bits
+		__m128i sumsLow = _mm_add_epi32(_mm_unpacklo_epi16(sums, zero), sumCarry);
+		__m128i sumsHigh = _mm_add_epi32(_mm_unpackhi_epi16(sums, zero), sumCarry);
+		__m128i countsLow = _mm_add_epi32(_mm_unpacklo_epi16(counts, zero), countCarry);
+		__m128i countsHigh = _mm_add_epi32(_mm_unpackhi_epi16(counts, zero), countCarry);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&rowSum[x]), sumsLow);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&rowSum[x + 4]), sumsHigh);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&rowCount[x]), countsLow);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&rowCount[x + 4]), countsHigh);
+
+		sumCarry = _mm_shuffle_epi32(sumsHigh, _MM_SHUFFLE(3, 3, 3, 3));
+		countCarry = _mm_shuffle_epi32(countsHigh, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+
+	// Single values
+	unsigned int sum = _mm_cvtsi128_si32(sumCarry);
+	unsigned int count = _mm_cvtsi128_si32(countCarry);
+
+	for (; x < len; ++x)
+	{
+		bool masked = mask[x] != 0;
+
+		sum += masked ? src[x] : 0;
+		count += masked ? 1 : 0;
+
+		rowSum[x] = sum;
+		rowCount[x] = count;
+	}
+}
+
+void updateColumnsU8SSE(const unsigned char* src, bool subtract, unsigned int* sums, unsigned int* counts, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+
+	// x - y == x + (y ^ -1) + 1, the sign is applied to the widened values
+	const __m128i sign = subtract ? _mm_set1_epi32(-1) : zero;
+	const __m128i carry = _mm_srli_epi32(sign, 31);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 16 x 8bits
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x]));
+		__m128i nonZero = _mm_andnot_si128(_mm_cmpeq_epi8(values, zero), one);
+
+		// 2 x 8 x 16bits
+		__m128i valuesLow = _mm_unpacklo_epi8(values, zero);
+		__m128i valuesHigh = _mm_unpackhi_epi8(values, zero);
+		__m128i nonZeroLow = _mm_unpacklo_epi8(nonZero, zero);
+		__m128i nonZeroHigh = _mm_unpackhi_epi8(nonZero, zero);
+
+		__m128i xValues[4] = {
+			_mm_unpacklo_epi16(valuesLow, zero),
+			_mm_unpackhi_epi16(valuesLow, zero),
+			_mm_unpacklo_epi16(valuesHigh, zero),
+			_mm_unpackhi_epi16(valuesHigh, zero)
+		};
+
+		__m128i xNonZero[4] = {
+			_mm_unpacklo_epi16(nonZeroLow, zero),
+			_mm_unpackhi_epi16(nonZeroLow, zero),
+			_mm_unpacklo_epi16(nonZeroHigh, zero),
+			_mm_unpackhi_epi16(nonZeroHigh, zero)
+		};
+
+		// 4 x 4 x 32bits
+		__m128i* xSums = reinterpret_cast<__m128i*>(&sums[x]);
+		__m128i* xCounts = reinterpret_cast<__m128i*>(&counts[x]);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i value = _mm_add_epi32(_mm_xor_si128(xValues[i], sign), carry);
+			__m128i count = _mm_add_epi32(_mm_xor_si128(xNonZero[i], sign), carry);
+
+			_mm_storeu_si128(xSums + i, _mm_add_epi32(_mm_loadu_si128(xSums + i), value));
+			_mm_storeu_si128(xCounts + i, _mm_add_epi32(_mm_loadu_si128(xCounts + i), count));
+		}
+	}
+
+	// Single values
+	for (; x < len; ++x)
+	{
+		unsigned int value = src[x];
+		unsigned int count = src[x] != 0 ? 1 : 0;
+
+		sums[x] += subtract ? 0u - value : value;
+		counts[x] += subtract ? 0u - count : count;
+	}
+}
+
+// Sums of 4 neighbour 16-bit values, 2 x 8 x 16bits to 4 x 32bits
+_inline __m128i sum_quads_u16(__m128i low, __m128i high)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+
+	// Pairs
+	__m128 pairsLow = _mm_castsi128_ps(_mm_madd_epi16(low, ones));
+	__m128 pairsHigh = _mm_castsi128_ps(_mm_madd_epi16(high, ones));
+
+	// Even + odd pairs
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(pairsLow, pairsHigh, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(pairsLow, pairsHigh, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	return _mm_add_epi32(even, odd);
+}
+
+void blockSums4x4SSE(const unsigned char* src, int stride, int lines, unsigned int* sums, unsigned int* counts, int len)
+{
+	int nlanes = 16;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 2 x 8 x 16bits column sums of the lines, <= 4 * 255
+		__m128i sumsLow = zero;
+		__m128i sumsHigh = zero;
+		__m128i countsLow = zero;
+		__m128i countsHigh = zero;
+
+		for (int y = 0; y < lines; ++y)
+		{
+			__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x + y * stride]));
+			__m128i nonZero = _mm_andnot_si128(_mm_cmpeq_epi8(values, zero), one);
+
+			sumsLow = _mm_add_epi16(sumsLow, _mm_unpacklo_epi8(values, zero));
+			sumsHigh = _mm_add_epi16(sumsHigh, _mm_unpackhi_epi8(values, zero));
+			countsLow = _mm_add_epi16(countsLow, _mm_unpacklo_epi8(nonZero, zero));
+			countsHigh = _mm_add_epi16(countsHigh, _mm_unpackhi_epi8(nonZero, zero));
+		}
+
+		// 4 blocks x 32bits
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[x / 4]), sum_quads_u16(sumsLow, sumsHigh));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&counts[x / 4]), sum_quads_u16(countsLow, countsHigh));
+	}
+
+	// Single blocks
+	for (; x < len; x += 4)
+	{
+		unsigned int sum = 0;
+		unsigned int count = 0;
+
+		for (int y = 0; y < lines; ++y)
+		for (int i = x; i < std::min(x + 4, len); ++i)
+		{
+			unsigned char value = src[i + y * stride];
+
+			sum += value;
+			count += value != 0 ? 1 : 0;
+		}
+
+		sums[x / 4] = sum;
+		counts[x / 4] = count;
+	}
+}
+
+// Prefix sums of 4 x 32bits
+_inline __m128i prefix_sum_u32(__m128i values)
+{
+	values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+	values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+
+	return values;
+}
+
+// Prefix sums of 2 x double
+_inline __m128d prefix_sum_f64(__m128d values)
+{
+	return _mm_add_pd(values, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(values), 8)));
+}
+
+void summedAreaLineSSE(const unsigned char* src, const unsigned int* prevSums, const unsigned int* prevCounts, unsigned int* sums, unsigned int* counts, int len)
+{
+	int nlanes = 8;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+
+	// Totals of the previous pixels of the line in all lanes
+	__m128i sumCarry = zero;
+	__m128i countCarry = zero;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 8 x 16bits
+		__m128i values = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[x])), zero);
+		__m128i nonZero = _mm_andnot_si128(_mm_cmpeq_epi16(values, zero), one);
+
+		// Fits 16 bits, 8 * 255
+		__m128i rowSums = prefix_sum_u16(values);
+		__m128i rowCounts = prefix_sum_u16(nonZero);
+
+		// 2 x 4 x 32bits
+		__m128i sumsLow = _mm_add_epi32(_mm_unpacklo_epi16(rowSums, zero), sumCarry);
+		__m128i sumsHigh = _mm_add_epi32(_mm_unpackhi_epi16(rowSums, zero), sumCarry);
+		__m128i countsLow = _mm_add_epi32(_mm_unpacklo_epi16(rowCounts, zero), countCarry);
+		__m128i countsHigh = _mm_add_epi32(_mm_unpackhi_epi16(rowCounts, zero), countCarry);
+
+		sumCarry = _mm_shuffle_epi32(sumsHigh, _MM_SHUFFLE(3, 3, 3, 3));
+		countCarry = _mm_shuffle_epi32(countsHigh, _MM_SHUFFLE(3, 3, 3, 3));
+
+		// SA(x, y) = row sum + SA(x, y - 1)
+		if (prevSums != nullptr)
+		{
+			sumsLow = _mm_add_epi32(sumsLow, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevSums[x])));
+			sumsHigh = _mm_add_epi32(sumsHigh, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevSums[x + 4])));
+			countsLow = _mm_add_epi32(countsLow, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevCounts[x])));
+			countsHigh = _mm_add_epi32(countsHigh, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevCounts[x + 4])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[x]), sumsLow);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[x + 4]), sumsHigh);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&counts[x]), countsLow);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&counts[x + 4]), countsHigh);
+	}
+
+	// Single values
+	unsigned int sum = _mm_cvtsi128_si32(sumCarry);
+	unsigned int count = _mm_cvtsi128_si32(countCarry);
+
+	for (; x < len; ++x)
+	{
+		sum += src[x];
+		count += src[x] != 0 ? 1 : 0;
+
+		sums[x] = sum + (prevSums != nullptr ? prevSums[x] : 0);
+		counts[x] = count + (prevCounts != nullptr ? prevCounts[x] : 0);
+	}
+}
+
+void summedAreaLineSSE(const unsigned short* src, const unsigned long long* prevSums, const unsigned int* prevCounts, unsigned long long* sums, unsigned int* counts, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+
+	// Totals of the previous pixels of the line in all lanes
+	__m128i sumCarry = zero;
+	__m128i countCarry = zero;
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x 32bits
+		__m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[x])), zero);
+		__m128i nonZero = _mm_andnot_si128(_mm_cmpeq_epi32(values, zero), one);
+
+		// Fits 32 bits, 4 * 65535
+		__m128i rowSums = prefix_sum_u32(values);
+		__m128i rowCounts = _mm_add_epi32(prefix_sum_u32(nonZero), countCarry);
+
+		// 2 x 2 x 64bits
+		__m128i sumsLow = _mm_add_epi64(_mm_unpacklo_epi32(rowSums, zero), sumCarry);
+		__m128i sumsHigh = _mm_add_epi64(_mm_unpackhi_epi32(rowSums, zero), sumCarry);
+
+		sumCarry = _mm_unpackhi_epi64(sumsHigh, sumsHigh);
+		countCarry = _mm_shuffle_epi32(rowCounts, _MM_SHUFFLE(3, 3, 3, 3));
+
+		// SA(x, y) = row sum + SA(x, y - 1)
+		if (prevSums != nullptr)
+		{
+			sumsLow = _mm_add_epi64(sumsLow, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevSums[x])));
+			sumsHigh = _mm_add_epi64(sumsHigh, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevSums[x + 2])));
+			rowCounts = _mm_add_epi32(rowCounts, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevCounts[x])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[x]), sumsLow);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&sums[x + 2]), sumsHigh);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&counts[x]), rowCounts);
+	}
+
+	// Single values
+	unsigned long long sum;
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(&sum), sumCarry);
+	unsigned int count = _mm_cvtsi128_si32(countCarry);
+
+	for (; x < len; ++x)
+	{
+		sum += src[x];
+		count += src[x] != 0 ? 1 : 0;
+
+		sums[x] = sum + (prevSums != nullptr ? prevSums[x] : 0);
+		counts[x] = count + (prevCounts != nullptr ? prevCounts[x] : 0);
+	}
+}
+
+void summedAreaLineSSE(const float* src, const double* prevSums, const unsigned int* prevCounts, double* sums, unsigned int* counts, int len)
+{
+	int nlanes = 4;
+	int x = 0;
+
+	const __m128 zeroPs = _mm_setzero_ps();
+	const __m128i one = _mm_set1_epi32(1);
+
+	// Totals of the previous pixels of the line in all lanes. Float values are summed in double
+	__m128d sumCarry = _mm_setzero_pd();
+	__m128i countCarry = _mm_setzero_si128();
+
+	int roundedLen = len & -nlanes;
+	for (; x < roundedLen; x += nlanes)
+	{
+		// 4 x float
+		__m128 values = _mm_loadu_ps(&src[x]);
+		__m128i nonZero = _mm_and_si128(_mm_castps_si128(_mm_cmpneq_ps(values, zeroPs)), one);
+
+		__m128i rowCounts = _mm_add_epi32(prefix_sum_u32(nonZero), countCarry);
+
+		// 2 x 2 x double
+		__m128d sumsLow = _mm_add_pd(prefix_sum_f64(_mm_cvtps_pd(values)), sumCarry);
+		__m128d sumsHigh = prefix_sum_f64(_mm_cvtps_pd(_mm_movehl_ps(values, values)));
+		sumsHigh = _mm_add_pd(sumsHigh, _mm_unpackhi_pd(sumsLow, sumsLow));
+
+		sumCarry = _mm_unpackhi_pd(sumsHigh, sumsHigh);
+		countCarry = _mm_shuffle_epi32(rowCounts, _MM_SHUFFLE(3, 3, 3, 3));
+
+		// SA(x, y) = row sum + SA(x, y - 1)
+		if (prevSums != nullptr)
+		{
+			sumsLow = _mm_add_pd(sumsLow, _mm_loadu_pd(&prevSums[x]));
+			sumsHigh = _mm_add_pd(sumsHigh, _mm_loadu_pd(&prevSums[x + 2]));
+			rowCounts = _mm_add_epi32(rowCounts, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&prevCounts[x])));
+		}
+
+		_mm_storeu_pd(&sums[x], sumsLow);
+		_mm_storeu_pd(&sums[x + 2], sumsHigh);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&counts[x]), rowCounts);
+	}
+
+	// Single values
+	double sum = _mm_cvtsd_f64(sumCarry);
+	unsigned int count = _mm_cvtsi128_si32(countCarry);
+
+	for (; x < len; ++x)
+	{
+		sum += src[x];
+		count += src[x] != 0 ? 1 : 0;
+
+		sums[x] = sum + (prevSums != nullptr ? prevSums[x] : 0.0);
+		counts[x] = count + (prevCounts != nullptr ? prevCounts[x] : 0);
+	}
 }
\ No newline at end of file
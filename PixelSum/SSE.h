@@ -12,4 +12,91 @@ int countNonZeroSSE(const unsigned char* data, int len);
 void sumAndCountNonZeroSSE(const unsigned char* data, int len, unsigned int& sum, unsigned int& countNonZero);
 
 // Fill summed area
-void fillSummedAreaSSE(const unsigned char* buffer, unsigned int* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight);
\ No newline at end of file
+void fillSummedAreaSSE(const unsigned char* buffer, unsigned int* summedArea, unsigned int* summedNonZeroArea, int xWidth, int yHeight);
+
+// Fill one line of an integral histogram with 'bins' interleaved 16-bit counts per pixel.
+// line[x * bins + b] = prevLine[x * bins + b] + count of bin b in src[0..x]. prevLine can be nullptr
+void fillHistogramLineSSE(const unsigned char* src, const unsigned short* prevLine, unsigned short* line, int xWidth, int bins, int binShift);
+
+// Widen and add 16-bit counts to 32-bit counts. dst = base + line
+void addLineU32U16SSE(const unsigned int* base, const unsigned short* line, unsigned int* dst, int len);
+
+// Per element minimum/maximum of two arrays
+void minArraySSE(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len);
+void maxArraySSE(const unsigned char* a, const unsigned char* b, unsigned char* dst, int len);
+
+// Minimum/maximum of all elements of an array. len > 0
+unsigned char minSSE(const unsigned char* data, int len);
+unsigned char maxSSE(const unsigned char* data, int len);
+
+// Pack one bit of every element to a bit array. bits[i / 64] bit (i % 64) = (data[i] >> bit) & 1
+void extractBitsSSE(const unsigned char* data, int len, int bit, unsigned long long* bits);
+
+// Weighted sum of three channels with 8-bit fixed point weights, w0 + w1 + w2 == 256.
+// dst[x] = (w0 * c0 + w1 * c1 + w2 * c2 + 128) >> 8. Interleaved with 3 or 4 channels per pixel or planar
+void lumaInterleavedSSE(const unsigned char* src, int channels, short w0, short w1, short w2, unsigned char* dst, int len);
+void lumaPlanarSSE(const unsigned char* src0, const unsigned char* src1, const unsigned char* src2, short w0, short w1, short w2, unsigned char* dst, int len);
+
+// Sum, count non zero and both for 16-bit and float pixels. Same as the 8-bit versions
+unsigned long long sumSSE(const unsigned short* data, int len);
+int countNonZeroSSE(const unsigned short* data, int len);
+void sumAndCountNonZeroSSE(const unsigned short* data, int len, unsigned long long& sum, unsigned int& countNonZero);
+
+double sumSSE(const float* data, int len);
+int countNonZeroSSE(const float* data, int len);
+void sumAndCountNonZeroSSE(const float* data, int len, double& sum, unsigned int& countNonZero);
+
+// Per element sum of two arrays. dst = src0 + src1, dst can be one of the sources
+void sumArraySSE(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len);
+
+// Per element difference of two arrays. dst = src0 - src1, dst can be one of the sources
+void subtractArraySSE(const unsigned int* src0, const unsigned int* src1, unsigned int* dst, int len);
+
+// dst = float(src) * scale
+void convertScaleU32SSE(const unsigned int* src, float scale, float* dst, int len);
+
+// dst = src1 != 0 ? float(src0) / float(src1) : 0
+void divideU32SSE(const unsigned int* src0, const unsigned int* src1, float* dst, int len);
+
+// Binarization by a local threshold. area = widths[x] * height, mean = sums[x] / area.
+// Bradley: dst = src * area > sums * scale ? 255 : 0
+// Sauvola: dst = src > mean * (1 + k * (sqrt(squares / area - mean^2) * invRange - 1)) ? 255 : 0
+void thresholdBradleySSE(const unsigned char* src, const unsigned int* sums, const float* widths, float height, float scale, unsigned char* dst, int len);
+void thresholdSauvolaSSE(const unsigned char* src, const unsigned int* sums, const unsigned int* squares, const float* widths, float height, float k, float invRange, unsigned char* dst, int len);
+
+// dst = saturate_u8(float(src) * scales[x] * scale + 0.5)
+void convertScaleRoundU32SSE(const unsigned int* src, const float* scales, float scale, unsigned char* dst, int len);
+
+// dst += src * weight, weight <= 255
+void multiplyAddU8SSE(const unsigned char* src, unsigned int weight, unsigned int* dst, int len);
+
+// Sparse sums of 4 lanes. corners is cornerCount x 4, dst is count x 4:
+// dst[i] = sum of weights[t] * corners[indices[t]] for t in offsets[i]..offsets[i + 1] - 1, modular
+void combineLanesSSE(const unsigned int* corners, const int* offsets, const int* indices, const int* weights, int count, int* dst);
+
+// Gradients of central differences, gx = right - left, gy = below - above. Unsigned orientation:
+// (gx, gy) is turned to gy >= 0, bins = count of k with cosines[k] * gy - sines[k] * gx > 0,
+// magnitudes = int(sqrt(gx^2 + gy^2) + 0.5)
+void gradientBinsSSE(const unsigned char* left, const unsigned char* right, const unsigned char* above, const unsigned char* below,
+	const float* cosines, const float* sines, int boundaries, unsigned char* bins, unsigned short* magnitudes, int len);
+
+// dst += src != 0 ? 1 : 0
+void addNonZeroU8SSE(const unsigned char* src, unsigned int* dst, int len);
+
+// Prefix sums of a line where mask != 0. rowSum[x] = sum of src[0..x] under the mask,
+// rowCount[x] = count of mask[0..x] != 0
+void maskedRowSumsSSE(const unsigned char* src, const unsigned char* mask, unsigned int* rowSum, unsigned int* rowCount, int len);
+
+// Column sums and counts of a strip of lines. sums += src, counts += src != 0 ? 1 : 0,
+// both are decremented when 'subtract' is set
+void updateColumnsU8SSE(const unsigned char* src, bool subtract, unsigned int* sums, unsigned int* counts, int len);
+
+// Sums and non-zero counts of 4x4 blocks. Block i is pixels 4i..4i+3 of 'lines' <= 4 lines
+// of 'stride' bytes, the last block is shorter when len is not a multiple of 4
+void blockSums4x4SSE(const unsigned char* src, int stride, int lines, unsigned int* sums, unsigned int* counts, int len);
+
+// One line of a summed area table. sums[x] = prevSums[x] + sum of src[0..x], counts[x] =
+// prevCounts[x] + count of src[0..x] != 0. prevSums and prevCounts are nullptr for the first line
+void summedAreaLineSSE(const unsigned char* src, const unsigned int* prevSums, const unsigned int* prevCounts, unsigned int* sums, unsigned int* counts, int len);
+void summedAreaLineSSE(const unsigned short* src, const unsigned long long* prevSums, const unsigned int* prevCounts, unsigned long long* sums, unsigned int* counts, int len);
+void summedAreaLineSSE(const float* src, const double* prevSums, const unsigned int* prevCounts, double* sums, unsigned int* counts, int len);
\ No newline at end of file
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace utils {
 
@@ -10,6 +16,96 @@ T clamp(T x, T lower, T upper)
 	return std::min(upper, std::max(x, lower));
 }
 
+// Index of the highest set bit. value > 0
+inline int floorLog2(unsigned int value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return int(index);
+#else
+	return 31 - __builtin_clz(value);
+#endif
+}
+
+// Calls func(begin, end) for contiguous parts of [0, count) on 'threads' threads.
+// threads <= 0 - one per hardware thread. The last part runs on the calling thread
+template<class TFunction>
+void parallelFor(int count, int threads, TFunction func)
+{
+	if (threads <= 0)
+	{
+		threads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	threads = std::min(threads, count);
+	if (threads <= 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+
+	for (int i = 0; i < threads - 1; ++i)
+	{
+		int begin = int((long long)count * i / threads);
+		int end = int((long long)count * (i + 1) / threads);
+
+		workers.emplace_back(func, begin, end);
+	}
+
+	func(int((long long)count * (threads - 1) / threads), count);
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+// Number of set bits
+inline int popCount64(unsigned long long value)
+{
+#ifdef _MSC_VER
+	return int(__popcnt(unsigned(value)) + __popcnt(unsigned(value >> 32)));
+#else
+	return __builtin_popcountll(value);
+#endif
+}
+
+// Hint to load the cache line of 'address', it is never dereferenced
+inline void prefetch(const void* address)
+{
+#ifdef _MSC_VER
+	_mm_prefetch((const char*)address, _MM_HINT_T0);
+#else
+	__builtin_prefetch(address);
+#endif
+}
+
+// Row-major summed area table of B(x, y)^2. Modular uint32
+inline void fillSummedSquares(const unsigned char* buffer, unsigned int* summedSquares, int xWidth, int yHeight)
+{
+	for (int y = 0; y < yHeight; ++y)
+	{
+		const auto src = buffer + y * xWidth;
+
+		const auto prevLine = summedSquares + (y - 1) * xWidth;
+		auto line = summedSquares + y * xWidth;
+
+		unsigned int rowSum = 0;
+
+		for (int x = 0; x < xWidth; ++x)
+		{
+			unsigned int value = src[x];
+			rowSum += value * value;
+
+			line[x] = rowSum + (y > 0 ? prevLine[x] : 0);
+		}
+	}
+}
+
 struct Rect
 {
 	int x0;
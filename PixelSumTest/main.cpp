@@ -1,12 +1,32 @@
 #include "PixelSumNaive.h"
 #include "PixelSumNaiveV2.h"
 #include "PixelSumIntegral.h"
+#include "PixelHistogramIntegral.h"
+#include "PixelMinMaxSparse.h"
+#include "PixelQuantileWavelet.h"
+#include "PixelSumBatch.h"
+#include "PixelSumMasked.h"
+#include "PixelSumPyramid.h"
+#include "PixelSumRegistry.h"
+#include "PixelSumReplicas.h"
+#include "PixelSumRowPrefix.h"
+#include "PixelSumVolume.h"
+#include "PixelBoxFilter.h"
+#include "PixelHaar.h"
+#include "PixelHog.h"
+#include "PixelResize.h"
+#include "PixelTemplateMatch.h"
+#include "PixelThreshold.h"
+#include "PixelTracker.h"
 
 #include <vector>
+#include <atomic>
 #include <chrono>
 #include <ratio>
 
 #include <ctime>		// std::time
+#include <climits>		// INT_MAX
+#include <cmath>		// std::ceil
 #include <cstdlib>		// std::rand
 #include <algorithm>	// std::generate
 
@@ -15,6 +35,8 @@
 #include "TestUtils.h"
 #include "SSECheck.h"
 
+#include "Utils.h"
+
 
 template<class TFunction>
 std::vector<unsigned char> makeData(int xWidth, int yHeight, TFunction func)
@@ -61,6 +83,18 @@ std::vector<unsigned char> makeRandomData(int xWidth, int yHeight)
 	return values;
 }
 
+// Random values, a third of them are zero
+std::vector<unsigned char> makeSparseData(int xWidth, int yHeight)
+{
+	std::vector<unsigned char> values(xWidth * yHeight);
+
+	std::generate(values.begin(), values.end(), []() {
+		return std::rand() % 3 == 0 ? 0 : std::rand() % 256;
+	});
+
+	return values;
+}
+
 std::vector<unsigned char> makeDataWithoutZero(int xWidth, int yHeight)
 {
 	std::vector<unsigned char> values(xWidth * yHeight);
@@ -80,6 +114,32 @@ std::vector<unsigned char> makeDataZero(int xWidth, int yHeight)
 	return values;
 }
 
+std::vector<utils::Rect> makeRandomRects(int xWidth, int yHeight, int count, int maxSize)
+{
+	std::vector<utils::Rect> rects;
+	rects.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		int x0 = std::rand() % xWidth;
+		int y0 = std::rand() % yHeight;
+
+		rects.push_back(utils::Rect(x0, y0, x0 + std::rand() % maxSize, y0 + std::rand() % maxSize));
+	}
+
+	return rects;
+}
+
+template<class TFunction>
+long long measureMks(TFunction func)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	func();
+	auto finisTime = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(finisTime - startTime).count();
+}
+
 
 /*
 TEST_CASE(test0)
@@ -162,29 +222,2263 @@ void testCaseMax(int xWidth = 4096, int yWidth = 4096)
 	return testCaseBase<integral::PixelSum>("SAT only maximum", values, xWidth, yWidth);
 }
 
+struct TiledPixelSum : public integral::PixelSum
+{
+	TiledPixelSum(const unsigned char* buffer, int xWidth, int yHeight)
+		: integral::PixelSum(buffer, xWidth, yHeight, integral::PixelSum::Layout::Tiled)
+	{}
+};
+
+void testCaseTiled(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+	return testCaseBase<TiledPixelSum>("SAT tiled", values, xWidth, yWidth);
+}
 
-int main(int argc, char** argv)
+void testCaseRowPrefix(int xWidth = 4096, int yWidth = 4096)
 {
-#ifdef __AVX2__
-	showCpuSupport();
-	if (!isAVXSupport())
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+	testCaseBase<rowprefix::PixelSum>("Row prefix", values, xWidth, yWidth);
+
+	// Lines replaced one by one, checked against a rebuild
+	rowprefix::PixelSum pixelSum(values.data(), xWidth, yWidth);
+
+	for (int i = 0; i < std::min(yWidth, 16); ++i)
 	{
-		std::cout << "AVX not supported" << std::endl;
-		return -1;
+		int y = std::rand() % yWidth;
+		auto line = makeRandomData(xWidth, 1);
+
+		std::copy(line.begin(), line.end(), values.begin() + y * xWidth);
+		pixelSum.updateRow(y, line.data());
 	}
-#elif __SSE2__
-	// x86 64 minimum SSE2
-#endif // __SSE2__
 
-	std::srand(unsigned(std::time(0)));
+	naivev2::PixelSum rebuilt(values.data(), xWidth, yWidth);
+
+	bool same = true;
+	for (const auto& rect : makeRandomRects(xWidth, yWidth, 1000, std::max(xWidth, yWidth)))
+	{
+		same = same
+			&& pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) == rebuilt.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)
+			&& pixelSum.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) == rebuilt.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1);
+	}
+
+	TEST_CHECK(same, "Random rects          ", "Row updates");
+
+	std::cout << std::endl;
+}
+
+// Estimates within the tolerance and the exact values within the reported errors
+bool checkPyramid(const pyramid::PixelSum& pixelSum, const integral::PixelSum& exact, const std::vector<utils::Rect>& rects, double tolerance)
+{
+	for (const auto& rect : rects)
+	{
+		auto sum = pixelSum.getPixelSumEstimate(rect.x0, rect.y0, rect.x1, rect.y1, tolerance);
+		auto average = pixelSum.getPixelAverageEstimate(rect.x0, rect.y0, rect.x1, rect.y1, tolerance / 100.0);
+		auto count = pixelSum.getNonZeroCountEstimate(rect.x0, rect.y0, rect.x1, rect.y1, tolerance / 100.0);
+
+		double exactSum = exact.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		double exactAverage = exact.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1);
+		double exactCount = exact.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1);
+
+		if (sum.error > tolerance || average.error > tolerance / 100.0 || count.error > tolerance / 100.0
+			|| std::abs(sum.value - exactSum) > sum.error + 1e-6
+			|| std::abs(average.value - exactAverage) > average.error + 1e-9
+			|| std::abs(count.value - exactCount) > count.error + 1e-6)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCasePyramid(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth);
+	testCaseBase<pyramid::PixelSum>("Pyramid exact", values, xWidth, yWidth);
+
+	pyramid::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum exact(values.data(), xWidth, yWidth);
+
+	auto rects = makeRandomRects(xWidth, yWidth, 1000, std::max(xWidth, yWidth));
+	rects.push_back(utils::Rect(-5, -5, xWidth + 5, yWidth + 5));
+	rects.push_back(utils::Rect(xWidth / 3, yWidth / 3, xWidth / 3, yWidth - 1));
 
 	// Tests
-	testCaseNaive();
-	testCaseMain();
-	testCaseMain(359, 257);
-	testCaseNoZero();
-	testCaseOnlyZero();
-	testCaseMax();
+	TEST_CHECK(checkPyramid(pixelSum, exact, rects, 0.0), "Tolerance 0           ", "Pyramid estimates");
+	TEST_CHECK(checkPyramid(pixelSum, exact, rects, 100.0), "Tolerance 100         ", "Pyramid estimates");
+	TEST_CHECK(checkPyramid(pixelSum, exact, rects, 1e5), "Tolerance 1e5         ", "Pyramid estimates");
+	TEST_CHECK(checkPyramid(pixelSum, exact, rects, 1e10), "Tolerance 1e10        ", "Pyramid estimates");
+
+	// Performance. Averages of large regions within 1%
+	auto largeRects = makeRandomRects(xWidth, yWidth, 10000, std::max(xWidth, yWidth));
+
+	double estimated = 0.0;
+	auto estimateMks = measureMks([&]() {
+		for (const auto& rect : largeRects)
+			estimated += pixelSum.getPixelAverageEstimate(rect.x0, rect.y0, rect.x1, rect.y1, 1.28).value;
+	});
+
+	double averaged = 0.0;
+	auto exactMks = measureMks([&]() {
+		for (const auto& rect : largeRects)
+			averaged += pixelSum.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1);
+	});
+
+	auto pyramidMakeMks = measureMks([&]() { pyramid::PixelSum(values.data(), xWidth, yWidth); });
+	auto integralMakeMks = measureMks([&]() { integral::PixelSum(values.data(), xWidth, yWidth); });
+
+	std::cout << "Pyramid (" << xWidth << "x" << yWidth << ") preparation " << pyramidMakeMks << "mks, integral " << integralMakeMks << "mks" << std::endl;
+	std::cout << largeRects.size() << " averages: estimates within 1.28 " << estimateMks << "mks, exact " << exactMks << "mks" << std::endl;
+	std::cout << std::endl;
+}
+
+void testCaseBatch(int xWidth = 64, int yWidth = 64, int count = 2000)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth * count);
+
+	std::vector<const unsigned char*> patches(count);
+	for (int i = 0; i < count; ++i)
+	{
+		patches[i] = values.data() + i * xWidth * yWidth;
+	}
+
+	// One table per patch, all of them kept as the batch keeps them
+	std::vector<integral::PixelSum> singles;
+	singles.reserve(count);
+
+	auto singleMks = measureMks([&]() {
+		for (int i = 0; i < count; ++i)
+			singles.emplace_back(patches[i], xWidth, yWidth);
+	});
+
+	auto batchMks = measureMks([&]() {
+		integral::PixelSumBatch(patches.data(), count, xWidth, yWidth, 1);
+	});
+
+	// The same tables again over the kept ones
+	auto resingleMks = measureMks([&]() {
+		for (int i = 0; i < count; ++i)
+			singles[i] = integral::PixelSum(patches[i], xWidth, yWidth);
+	});
+
+	integral::PixelSumBatch batch(patches.data(), count, xWidth, yWidth, 1);
+
+	auto rebuildMks = measureMks([&]() {
+		batch.rebuild(patches.data());
+	});
+
+	std::cout << "Batch of " << count << " (" << xWidth << "x" << yWidth << ") preparation: one by one " << singleMks
+		<< "mks, batch 1 thread " << batchMks << "mks" << std::endl;
+	std::cout << "Batch of " << count << " (" << xWidth << "x" << yWidth << ") again: one by one " << resingleMks
+		<< "mks, rebuild in the arena " << rebuildMks << "mks" << std::endl;
+
+	// Tests
+	auto rects = makeRandomRects(xWidth, yWidth, 20, std::max(xWidth, yWidth));
+	rects.push_back(utils::Rect(-5, -5, xWidth + 5, yWidth + 5));
+
+	bool same = batch.getCount() == count;
+	for (int i = 0; i < count && same; i += std::max(count / 200, 1))
+	{
+		integral::PixelSum pixelSum(patches[i], xWidth, yWidth);
+		auto view = batch.getView(i);
+
+		for (const auto& rect : rects)
+		{
+			same = same
+				&& view.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) == pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)
+				&& view.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1) == pixelSum.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1)
+				&& view.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) == pixelSum.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1)
+				&& view.getNonZeroAverage(rect.x0, rect.y0, rect.x1, rect.y1) == pixelSum.getNonZeroAverage(rect.x0, rect.y0, rect.x1, rect.y1);
+		}
+	}
+
+	// The last table of the arena
+	integral::PixelSum last(patches[count - 1], xWidth, yWidth);
+	same = same && batch.getView(count - 1).getPixelSum(0, 0, xWidth - 1, yWidth - 1) == last.getPixelSum(0, 0, xWidth - 1, yWidth - 1);
+
+	TEST_CHECK(same, "Random rects          ", "Batch views");
+
+	std::cout << std::endl;
+}
+
+// Queries of the registry against the naive sums of the images
+bool checkRegistry(integral::PixelSumRegistry& registry, const std::vector<std::vector<unsigned char>>& images, int xWidth, int yWidth, int id)
+{
+	naive::PixelSum pixelSum(images[id].data(), xWidth, yWidth);
+
+	for (const auto& rect : makeRandomRects(xWidth, yWidth, 10, std::max(xWidth, yWidth)))
+	{
+		if (registry.getPixelSum(id, rect.x0, rect.y0, rect.x1, rect.y1) != pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)
+			|| registry.getPixelAverage(id, rect.x0, rect.y0, rect.x1, rect.y1) != pixelSum.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1)
+			|| registry.getNonZeroCount(id, rect.x0, rect.y0, rect.x1, rect.y1) != int(pixelSum.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1))
+			|| registry.getNonZeroAverage(id, rect.x0, rect.y0, rect.x1, rect.y1) != pixelSum.getNonZeroAverage(rect.x0, rect.y0, rect.x1, rect.y1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseRegistry(int xWidth = 512, int yWidth = 512, int imageCount = 8)
+{
+	std::vector<std::vector<unsigned char>> images;
+	for (int i = 0; i < imageCount; ++i)
+	{
+		images.push_back(makeData(xWidth, yWidth));
+	}
+
+	// Three tables fit
+	size_t budget = integral::PixelSumRegistry::getTableBytes(xWidth, yWidth) * 3;
+
+	// Synchronous
+	integral::PixelSumRegistry registry(budget, false);
+	for (int i = 0; i < imageCount; ++i)
+	{
+		registry.add(i, images[i].data(), xWidth, yWidth);
+	}
+
+	bool same = true;
+	for (int round = 0; round < 3; ++round)
+	for (int i = 0; i < imageCount; ++i)
+	{
+		same = same && checkRegistry(registry, images, xWidth, yWidth, i);
+	}
+
+	TEST_CHECK(same, "Round robin, sync      ", "Registry queries");
+	TEST_CHECK(registry.getUsedBytes() <= budget, "Round robin, sync      ", "Registry budget");
+
+	// 0, 1, 2 resident, 0 is the most recent, 3 evicts 1
+	registry.getPixelSum(0, 0, 0, 0, 0);
+	registry.getPixelSum(1, 0, 0, 0, 0);
+	registry.getPixelSum(2, 0, 0, 0, 0);
+	registry.getPixelSum(0, 0, 0, 0, 0);
+	registry.getPixelSum(3, 0, 0, 0, 0);
+
+	TEST_CHECK(registry.isResident(0) && !registry.isResident(1) && registry.isResident(2) && registry.isResident(3), "Least recent evicted  ", "Registry LRU");
+
+	// A miss is answered by the rebuilt table, not counted as a hit too
+	auto before = registry.getCounters();
+	registry.getPixelSum(1, 0, 0, 0, 0);
+	auto counters = registry.getCounters();
+
+	TEST_CHECK(counters.misses == before.misses + 1 && counters.hits == before.hits && counters.rebuilds == before.rebuilds + 1, "Miss, sync            ", "Registry counters");
+
+	std::cout << "Registry (" << imageCount << " x " << xWidth << "x" << yWidth << ", 3 tables): hits " << counters.hits << ", misses " << counters.misses
+		<< ", rebuilds " << counters.rebuilds << " in " << counters.rebuildMks << "mks, evictions " << counters.evictions << std::endl;
+
+	// Asynchronous, scans until the tables are built
+	integral::PixelSumRegistry asyncRegistry(budget, true);
+	for (int i = 0; i < imageCount; ++i)
+	{
+		asyncRegistry.add(i, images[i].data(), xWidth, yWidth);
+	}
+
+	same = checkRegistry(asyncRegistry, images, xWidth, yWidth, 0);
+	asyncRegistry.waitRebuilds();
+	same = same && asyncRegistry.isResident(0) && checkRegistry(asyncRegistry, images, xWidth, yWidth, 0);
+
+	for (int i = 0; i < imageCount; ++i)
+	{
+		same = same && checkRegistry(asyncRegistry, images, xWidth, yWidth, i);
+	}
+
+	asyncRegistry.waitRebuilds();
+
+	// Replaced and removed images
+	images[1] = makeData(xWidth, yWidth);
+	asyncRegistry.add(1, images[1].data(), xWidth, yWidth);
+	asyncRegistry.remove(2);
+
+	same = same && checkRegistry(asyncRegistry, images, xWidth, yWidth, 1) && !asyncRegistry.contains(2);
+
+	counters = asyncRegistry.getCounters();
+	TEST_CHECK(same && counters.fallbacks > 0 && counters.hits > 0, "Scan while rebuilding ", "Registry queries");
+	TEST_CHECK(asyncRegistry.getUsedBytes() <= budget, "Scan while rebuilding ", "Registry budget");
+
+	std::cout << std::endl;
+}
+
+void benchmarkLayout(int xWidth = 4096, int yWidth = 4096, int count = 1000000)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+
+	integral::PixelSum rowMajor(values.data(), xWidth, yWidth, integral::PixelSum::Layout::RowMajor);
+	integral::PixelSum tiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	for (int maxSize : { 32, std::max(xWidth, yWidth) })
+	{
+		auto rects = makeRandomRects(xWidth, yWidth, count, maxSize);
+
+		unsigned int rowMajorSum = 0;
+		auto rowMajorMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				rowMajorSum += rowMajor.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		unsigned int tiledSum = 0;
+		auto tiledMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				tiledSum += tiled.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		std::cout << "SAT layout (" << xWidth << "x" << yWidth << ") " << count << " rects up to " << maxSize
+			<< ": row-major " << rowMajorMks << "mks, tiled " << tiledMks << "mks" << std::endl;
+
+		TEST_CHECK(rowMajorSum == tiledSum, "SAT layout", "Same sums");
+	}
+
+	// Clustered queries. Rects up to 16 around 'clusters' active 32x32 areas, queried in turns,
+	// an area moves now and then
+	for (int clusters : { 64, 256 })
+	{
+		std::vector<int> clusterX(clusters);
+		std::vector<int> clusterY(clusters);
+
+		std::vector<utils::Rect> rects;
+		rects.reserve(count);
+
+		for (int i = 0; i < count; ++i)
+		{
+			int cluster = i % clusters;
+			if (i < clusters || std::rand() % 4096 == 0)
+			{
+				clusterX[cluster] = std::rand() % xWidth;
+				clusterY[cluster] = std::rand() % yWidth;
+			}
+
+			int x0 = clusterX[cluster] + std::rand() % 32;
+			int y0 = clusterY[cluster] + std::rand() % 32;
+
+			rects.push_back(utils::Rect(x0, y0, x0 + std::rand() % 16, y0 + std::rand() % 16));
+		}
+
+		unsigned int rowMajorSum = 0;
+		auto rowMajorMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				rowMajorSum += rowMajor.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		unsigned int tiledSum = 0;
+		auto tiledMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				tiledSum += tiled.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		std::cout << "SAT layout (" << xWidth << "x" << yWidth << ") " << count << " rects up to 16 in " << clusters
+			<< " clusters: row-major " << rowMajorMks << "mks, tiled " << tiledMks << "mks" << std::endl;
+
+		TEST_CHECK(rowMajorSum == tiledSum, "SAT layout", "Same sums");
+	}
+
+	std::cout << std::endl;
+}
+unsigned int tiltedPixelSum(const std::vector<unsigned char>& values, int xWidth, int yWidth, int x, int y, int width, int height)
+{
+	unsigned int sum = 0;
+
+	// Bounding box of the tilted rectangle
+	for (int ty = std::max(y + 1, 0); ty <= std::min(y + width + height, yWidth - 1); ++ty)
+	for (int tx = std::max(x - height, 0); tx <= std::min(x + width, xWidth - 1); ++tx)
+	{
+		int u = tx + ty;
+		int v = tx - ty;
+
+		if (u > x + y && u <= x + y + 2 * width && v >= x - y - 2 * height && v < x - y)
+		{
+			sum += values[tx + ty * xWidth];
+		}
+	}
+
+	return sum;
+}
+
+bool checkTilted(const integral::PixelSum& pixelSum, const std::vector<unsigned char>& values, int xWidth, int yWidth, int count, int maxSize)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		int x = std::rand() % (xWidth + 40) - 20;
+		int y = std::rand() % (yWidth + 40) - 20;
+		int width = std::rand() % maxSize;
+		int height = std::rand() % maxSize;
+
+		if (pixelSum.getTiltedPixelSum(x, y, width, height) != tiltedPixelSum(values, xWidth, yWidth, x, y, width, height))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseTilted(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth, integral::PixelSum::Layout::RowMajor, true);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "SAT tilted (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(pixelSum.getTiltedPixelSum(xWidth / 2, yWidth / 2, 0, 0) == 0, "(50%, 50%, 0, 0)      ", "Tilted empty");
+	TEST_CHECK(pixelSum.getTiltedPixelSum(xWidth / 2, -(xWidth + yWidth), 2 * (xWidth + yWidth), 2 * (xWidth + yWidth)) == pixelSum.getPixelSum(0, 0, xWidth - 1, yWidth - 1), "Whole buffer          ", "Tilted");
+	TEST_CHECK(checkTilted(pixelSum, values, xWidth, yWidth, 1000, 16), "Random tilted up to 16 ", "Tilted");
+	TEST_CHECK(checkTilted(pixelSum, values, xWidth, yWidth, 100, 256), "Random tilted up to 256", "Tilted");
+	TEST_CHECK(checkTilted(pixelSum, values, xWidth, yWidth, 10, std::max(xWidth, yWidth)), "Random tilted          ", "Tilted");
+
+	std::cout << std::endl;
+}
+
+std::vector<unsigned char> makeLuma(const std::vector<unsigned char>& values, integral::PixelSum::Format format, int xWidth, int yWidth)
+{
+	std::vector<unsigned char> luma(xWidth * yWidth);
+
+	for (int i = 0; i < xWidth * yWidth; ++i)
+	{
+		int r, g, b;
+
+		switch (format)
+		{
+		case integral::PixelSum::Format::RGB:		r = values[i * 3]; g = values[i * 3 + 1]; b = values[i * 3 + 2]; break;
+		case integral::PixelSum::Format::BGR:		b = values[i * 3]; g = values[i * 3 + 1]; r = values[i * 3 + 2]; break;
+		case integral::PixelSum::Format::RGBA:		r = values[i * 4]; g = values[i * 4 + 1]; b = values[i * 4 + 2]; break;
+		case integral::PixelSum::Format::BGRA:		b = values[i * 4]; g = values[i * 4 + 1]; r = values[i * 4 + 2]; break;
+		default:									r = values[i]; g = values[i + xWidth * yWidth]; b = values[i + 2 * xWidth * yWidth]; break;
+		}
+
+		luma[i] = (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+	}
+
+	return luma;
+}
+
+bool checkSameSums(const integral::PixelSum& pixelSum0, const integral::PixelSum& pixelSum, const std::vector<utils::Rect>& rects)
+{
+	for (const auto& rect : rects)
+	{
+		if (pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) != pixelSum0.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) ||
+			pixelSum.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) != pixelSum0.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseColor(const char* name, integral::PixelSum::Format format, int channels, int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth * channels, yWidth);
+	std::vector<unsigned char> luma = makeLuma(values, format, xWidth, yWidth);
+
+	integral::PixelSum pixelSum0(luma.data(), xWidth, yWidth);
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	integral::PixelSum pixelSum(values.data(), format, xWidth, yWidth);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "SAT " << name << " (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	integral::PixelSum pixelSumTiled(values.data(), format, xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	// Tests
+	TEST_CHECK(pixelSum.getPixelSum(0, 0, xWidth - 1, yWidth - 1) == pixelSum0.getPixelSum(0, 0, xWidth - 1, yWidth - 1), "(0, 0, 100%, 100%)    ", "Sum");
+	TEST_CHECK(checkSameSums(pixelSum0, pixelSum, makeRandomRects(xWidth, yWidth, 1000, 256)), "Random rects up to 256", "Sum/Count");
+	TEST_CHECK(checkSameSums(pixelSum0, pixelSumTiled, makeRandomRects(xWidth, yWidth, 1000, 256)), "Random rects up to 256", "Tiled Sum/Count");
+
+	std::cout << std::endl;
+}
+
+template<class TPixel>
+bool checkPixelType(const std::vector<TPixel>& values, int xWidth, int yWidth, const std::vector<utils::Rect>& rects, double tolerance)
+{
+	naive::BasicPixelSum<TPixel> pixelSum0(values.data(), xWidth, yWidth);
+	naivev2::BasicPixelSum<TPixel> pixelSumV2(values.data(), xWidth, yWidth);
+	integral::BasicPixelSum<TPixel> pixelSumIntegral(values.data(), xWidth, yWidth);
+	integral::BasicPixelSum<TPixel> pixelSumTiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	for (const auto& rect : rects)
+	{
+		double sum = double(pixelSum0.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1));
+		int count = pixelSum0.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1);
+
+		double maxError = tolerance * std::max(1.0, std::abs(sum));
+
+		if (std::abs(double(pixelSumV2.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)) - sum) > maxError ||
+			std::abs(double(pixelSumIntegral.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)) - sum) > maxError ||
+			std::abs(double(pixelSumTiled.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1)) - sum) > maxError ||
+			pixelSumV2.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) != count ||
+			pixelSumIntegral.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) != count ||
+			pixelSumTiled.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1) != count)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCasePixelTypes(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned short> values16(xWidth * yWidth);
+	std::generate(values16.begin(), values16.end(), []() {
+		return (unsigned short)(std::rand() % 4 == 0 ? 0 : (std::rand() << 1) ^ std::rand());
+	});
+
+	std::vector<float> valuesFloat(xWidth * yWidth);
+	std::generate(valuesFloat.begin(), valuesFloat.end(), []() {
+		return std::rand() % 4 == 0 ? 0.0f : float(std::rand()) / 32.0f - 100.0f;
+	});
+
+	std::vector<unsigned short> valuesMax16(xWidth * yWidth, 65535);
+
+	auto makeTimeMks = measureMks([&]() {
+		integral::PixelSum16 pixelSum(values16.data(), xWidth, yWidth);
+	});
+	std::cout << "SAT uint16 (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		integral::PixelSumFloat pixelSum(valuesFloat.data(), xWidth, yWidth);
+	});
+	std::cout << "SAT float (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	integral::PixelSum16 pixelSumMax16(valuesMax16.data(), xWidth, yWidth);
+	naivev2::PixelSum16 pixelSumMax16V2(valuesMax16.data(), xWidth, yWidth);
+
+	// Tests
+	TEST_CHECK(pixelSumMax16.getPixelSum(0, 0, xWidth - 1, yWidth - 1) == 65535ULL * xWidth * yWidth, "(0, 0, 100%, 100%)    ", "Max uint16 Sum");
+	TEST_CHECK(pixelSumMax16V2.getPixelSum(0, 0, xWidth - 1, yWidth - 1) == 65535ULL * xWidth * yWidth, "(0, 0, 100%, 100%)    ", "Max uint16 Sum V2");
+	TEST_CHECK(checkPixelType(values16, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 100, 256), 0.0), "Random rects up to 256", "uint16 Sum/Count");
+	TEST_CHECK(checkPixelType(valuesFloat, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 100, 256), 1e-9), "Random rects up to 256", "float Sum/Count");
+
+	std::cout << std::endl;
+}
+
+// Sum of a box by a query per frame
+unsigned int framesPixelSum(const std::vector<integral::PixelSum>& frames, int x0, int y0, int t0, int x1, int y1, int t1)
+{
+	unsigned int sum = 0;
+	for (int t = std::max(t0, 0); t <= std::min(t1, int(frames.size()) - 1); ++t)
+	{
+		sum += frames[t].getPixelSum(x0, y0, x1, y1);
+	}
+
+	return sum;
+}
+
+int framesNonZeroCount(const std::vector<integral::PixelSum>& frames, int x0, int y0, int t0, int x1, int y1, int t1)
+{
+	int count = 0;
+	for (int t = std::max(t0, 0); t <= std::min(t1, int(frames.size()) - 1); ++t)
+	{
+		count += frames[t].getNonZeroCount(x0, y0, x1, y1);
+	}
+
+	return count;
+}
+
+bool checkVolume(const volume::PixelSum& pixelSum, const std::vector<integral::PixelSum>& frames, int xWidth, int yWidth, int count, int maxSize)
+{
+	int firstFrame = pixelSum.getFirstFrame();
+	int frameCount = pixelSum.getLastFrame() - firstFrame + 1;
+
+	for (const auto& rect : makeRandomRects(xWidth, yWidth, count, maxSize))
+	{
+		int t0 = firstFrame + std::rand() % frameCount;
+		int t1 = t0 + std::rand() % frameCount;
+
+		if (pixelSum.getPixelSum(rect.x0, rect.y0, t0, rect.x1, rect.y1, t1) != framesPixelSum(frames, rect.x0, rect.y0, t0, rect.x1, rect.y1, std::min(t1, pixelSum.getLastFrame())) ||
+			pixelSum.getNonZeroCount(rect.x0, rect.y0, t0, rect.x1, rect.y1, t1) != framesNonZeroCount(frames, rect.x0, rect.y0, t0, rect.x1, rect.y1, std::min(t1, pixelSum.getLastFrame())))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseVolume(int xWidth = 512, int yWidth = 512, int frameCount = 64, int ringFrames = 8)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth * frameCount);
+
+	std::vector<integral::PixelSum> frames;
+	for (int t = 0; t < frameCount; ++t)
+	{
+		frames.emplace_back(values.data() + t * xWidth * yWidth, xWidth, yWidth);
+	}
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	volume::PixelSum pixelSum(values.data(), xWidth, yWidth, frameCount);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "SVT (" << xWidth << "x" << yWidth << "x" << frameCount << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	// Ring buffer of the last frames
+	volume::PixelSum ring(xWidth, yWidth, ringFrames);
+	for (int t = 0; t < frameCount; ++t)
+	{
+		ring.pushFrame(values.data() + t * xWidth * yWidth);
+	}
+
+	// Tests
+	TEST_CHECK(pixelSum.getPixelSum(0, 0, 0, xWidth - 1, yWidth - 1, frameCount - 1) == framesPixelSum(frames, 0, 0, 0, xWidth - 1, yWidth - 1, frameCount - 1), "(0, 0, 0, 100%, 100%, 100%)", "Sum");
+	TEST_CHECK(pixelSum.getPixelSum(-10, -10, -10, xWidth + 10, yWidth + 10, frameCount + 10) == framesPixelSum(frames, 0, 0, 0, xWidth - 1, yWidth - 1, frameCount - 1), "(-10, -10, -10, 110%, ...) ", "Sum");
+	TEST_CHECK(checkVolume(pixelSum, frames, xWidth, yWidth, 1000, 64), "Random boxes up to 64      ", "Sum/Count");
+	TEST_CHECK(ring.getFirstFrame() == frameCount - ringFrames && ring.getLastFrame() == frameCount - 1, "Ring buffer                ", "Frames");
+	TEST_CHECK(ring.getPixelSum(0, 0, 0, xWidth - 1, yWidth - 1, frameCount - 1) == framesPixelSum(frames, 0, 0, frameCount - ringFrames, xWidth - 1, yWidth - 1, frameCount - 1), "Ring buffer                ", "Window Sum");
+	TEST_CHECK(checkVolume(ring, frames, xWidth, yWidth, 1000, 64), "Ring buffer random boxes   ", "Sum/Count");
+
+	// Box query vs a query per frame
+	auto rects = makeRandomRects(xWidth, yWidth, 10000, 64);
+
+	unsigned int checksum = 0;
+	auto volumeMks = measureMks([&]() {
+		for (const auto& rect : rects)
+		{
+			checksum += pixelSum.getPixelSum(rect.x0, rect.y0, 0, rect.x1, rect.y1, frameCount - 1);
+		}
+	});
+	auto framesMks = measureMks([&]() {
+		for (const auto& rect : rects)
+		{
+			checksum -= framesPixelSum(frames, rect.x0, rect.y0, 0, rect.x1, rect.y1, frameCount - 1);
+		}
+	});
+
+	std::cout << "10000 boxes of " << frameCount << " frames. SVT: " << volumeMks << "mks, per frame SAT: " << framesMks << "mks" << (checksum == 0 ? "" : " (mismatch)") << std::endl;
+	std::cout << std::endl;
+}
+
+// Compare with the region queries. Every 'step' line
+bool checkBoxFilter(const integral::PixelSum& pixelSum, int radius, const std::vector<unsigned int>& sums, const std::vector<float>& means, const std::vector<float>& nonZeroMeans, int step)
+{
+	int xWidth = pixelSum.getWidth();
+
+	for (int y = 0; y < pixelSum.getHeight(); y += step)
+	for (int x = 0; x < xWidth; ++x)
+	{
+		int x0 = x - radius;
+		int y0 = y - radius;
+		int x1 = x + radius;
+		int y1 = y + radius;
+
+		double mean = pixelSum.getPixelAverage(x0, y0, x1, y1);
+		double nonZeroMean = pixelSum.getNonZeroAverage(x0, y0, x1, y1);
+
+		if (sums[x + y * xWidth] != pixelSum.getPixelSum(x0, y0, x1, y1) ||
+			std::abs(means[x + y * xWidth] - mean) > 1e-5 * std::max(1.0, mean) ||
+			std::abs(nonZeroMeans[x + y * xWidth] - nonZeroMean) > 1e-5 * std::max(1.0, nonZeroMean))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseBoxFilter(int xWidth = 1024, int yWidth = 1024)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum pixelSumTiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	integral::BoxFilter filter(pixelSum);
+
+	const int radii[] = { 0, 1, 5, 40, 300 };
+	const int count = sizeof(radii) / sizeof(radii[0]);
+	int step = std::max(1, yWidth / 64);
+
+	std::vector<std::vector<unsigned int>> sums(count, std::vector<unsigned int>(xWidth * yWidth));
+	std::vector<std::vector<float>> means(count, std::vector<float>(xWidth * yWidth));
+	std::vector<std::vector<float>> nonZeroMeans(count, std::vector<float>(xWidth * yWidth));
+
+	std::vector<unsigned int*> sumPtrs;
+	std::vector<float*> meanPtrs;
+	std::vector<float*> nonZeroMeanPtrs;
+
+	for (int i = 0; i < count; ++i)
+	{
+		sumPtrs.push_back(sums[i].data());
+		meanPtrs.push_back(means[i].data());
+		nonZeroMeanPtrs.push_back(nonZeroMeans[i].data());
+	}
+
+	std::cout << "Box filter (" << xWidth << "x" << yWidth << ")" << std::endl;
+
+	filter.getSum(radii, count, sumPtrs.data());
+	filter.getMean(radii, count, meanPtrs.data());
+	filter.getNonZeroMean(radii, count, nonZeroMeanPtrs.data());
+
+	// Tests
+	TEST_CHECK(checkBoxFilter(pixelSum, 0, sums[0], means[0], nonZeroMeans[0], step), "Radius 0              ", "Sum/Mean/NonZeroMean");
+	TEST_CHECK(checkBoxFilter(pixelSum, 1, sums[1], means[1], nonZeroMeans[1], step), "Radius 1              ", "Sum/Mean/NonZeroMean");
+	TEST_CHECK(checkBoxFilter(pixelSum, 5, sums[2], means[2], nonZeroMeans[2], step), "Radius 5              ", "Sum/Mean/NonZeroMean");
+	TEST_CHECK(checkBoxFilter(pixelSum, 40, sums[3], means[3], nonZeroMeans[3], step), "Radius 40             ", "Sum/Mean/NonZeroMean");
+	TEST_CHECK(checkBoxFilter(pixelSum, 300, sums[4], means[4], nonZeroMeans[4], step), "Radius 300            ", "Sum/Mean/NonZeroMean");
+
+	integral::BoxFilter(pixelSumTiled, 1).getSum(radii[3], sums[0].data());
+	TEST_CHECK(sums[0] == sums[3], "Radius 40 tiled       ", "Sum");
+
+	std::cout << std::endl;
+}
+
+// Count of pixels different from a threshold by the region queries in double
+int countThresholdErrors(const integral::PixelSum& pixelSum, integral::AdaptiveThreshold::Method method, int radius, double k, const std::vector<unsigned char>& binary)
+{
+	int xWidth = pixelSum.getWidth();
+	int yWidth = pixelSum.getHeight();
+
+	// Squares fit 16 bits
+	std::vector<unsigned short> squares(pixelSum.getBuffer(), pixelSum.getBuffer() + xWidth * yWidth);
+	for (auto& value : squares)
+	{
+		value = value * value;
+	}
+
+	integral::PixelSum16 squaresSum(squares.data(), xWidth, yWidth);
+
+	int errors = 0;
+
+	for (int y = 0; y < yWidth; ++y)
+	for (int x = 0; x < xWidth; ++x)
+	{
+		auto rect = utils::Rect(x - radius, y - radius, x + radius, y + radius).intersected(0, 0, xWidth - 1, yWidth - 1);
+
+		double area = double(rect.getWidth()) * rect.getHeight();
+		double mean = pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) / area;
+		double value = pixelSum.getBuffer()[x + y * xWidth];
+
+		double threshold = mean * (1.0 - k);
+		if (method == integral::AdaptiveThreshold::Method::Sauvola)
+		{
+			double variance = squaresSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) / area - mean * mean;
+			threshold = mean * (1.0 + k * (std::sqrt(std::max(variance, 0.0)) / 128.0 - 1.0));
+		}
+
+		errors += (value > threshold ? 255 : 0) != binary[x + y * xWidth] ? 1 : 0;
+	}
+
+	return errors;
+}
+
+void testCaseThreshold(int xWidth = 1024, int yWidth = 1024)
+{
+	// Text-like blocks on a gradient
+	std::vector<unsigned char> values(xWidth * yWidth);
+	for (int y = 0; y < yWidth; ++y)
+	for (int x = 0; x < xWidth; ++x)
+	{
+		bool ink = (x / 7) % 3 == 0 && (y / 11) % 2 == 0;
+		values[x + y * xWidth] = (unsigned char)utils::clamp((ink ? 40 : 200) - x * 100 / xWidth + std::rand() % 21 - 10, 0, 255);
+	}
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+
+	integral::AdaptiveThreshold bradley(pixelSum, integral::AdaptiveThreshold::Method::Bradley);
+	integral::AdaptiveThreshold sauvola(pixelSum, integral::AdaptiveThreshold::Method::Sauvola, 2);
+
+	std::vector<unsigned char> binary(xWidth * yWidth);
+
+	auto makeTimeMks = measureMks([&]() {
+		bradley.apply(15, 0.15, binary.data());
+	});
+	std::cout << "Bradley threshold (" << xWidth << "x" << yWidth << ") time: " << makeTimeMks << "mks" << std::endl;
+
+	// Float vs double can differ at the threshold itself
+	int maxErrors = xWidth * yWidth / 10000;
+
+	// Tests
+	TEST_CHECK(countThresholdErrors(pixelSum, integral::AdaptiveThreshold::Method::Bradley, 15, 0.15, binary) <= maxErrors, "Radius 15             ", "Bradley");
+
+	bradley.apply(0, 0.15, binary.data());
+	TEST_CHECK(countThresholdErrors(pixelSum, integral::AdaptiveThreshold::Method::Bradley, 0, 0.15, binary) <= maxErrors, "Radius 0              ", "Bradley");
+
+	makeTimeMks = measureMks([&]() {
+		sauvola.apply(20, 0.34, binary.data());
+	});
+	std::cout << "Sauvola threshold (" << xWidth << "x" << yWidth << ") time: " << makeTimeMks << "mks" << std::endl;
+
+	TEST_CHECK(countThresholdErrors(pixelSum, integral::AdaptiveThreshold::Method::Sauvola, 20, 0.34, binary) <= maxErrors, "Radius 20             ", "Sauvola");
+
+	sauvola.apply(integral::AdaptiveThreshold::MaxSauvolaRadius, 0.2, binary.data());
+	TEST_CHECK(countThresholdErrors(pixelSum, integral::AdaptiveThreshold::Method::Sauvola, integral::AdaptiveThreshold::MaxSauvolaRadius, 0.2, binary) <= maxErrors, "Radius 128            ", "Sauvola");
+
+	// Larger radii are clamped, the squares of the window would overflow uint32
+	std::vector<unsigned char> clamped(xWidth * yWidth);
+	sauvola.apply(integral::AdaptiveThreshold::MaxSauvolaRadius + 100, 0.2, clamped.data());
+	TEST_CHECK(clamped == binary, "Radius 228            ", "Sauvola");
+
+	std::cout << std::endl;
+}
+
+// Output pixels against the rounded region averages of the source, off by one at most (float rounding)
+bool checkResize(const integral::PixelSum& pixelSum, int dstWidth, int dstHeight, const std::vector<unsigned char>& dst)
+{
+	int xWidth = pixelSum.getWidth();
+	int yWidth = pixelSum.getHeight();
+
+	for (int j = 0; j < dstHeight; ++j)
+	for (int i = 0; i < dstWidth; ++i)
+	{
+		int x0 = i * xWidth / dstWidth;
+		int y0 = j * yWidth / dstHeight;
+		int x1 = std::max(x0, (i + 1) * xWidth / dstWidth - 1);
+		int y1 = std::max(y0, (j + 1) * yWidth / dstHeight - 1);
+
+		double area = double(x1 - x0 + 1) * (y1 - y0 + 1);
+		int expected = int(pixelSum.getPixelSum(x0, y0, x1, y1) / area + 0.5);
+
+		if (std::abs(expected - int(dst[i + j * dstWidth])) > 1)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseResize(int xWidth = 1024, int yWidth = 1024)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth, []() {
+		return std::rand() % 256;
+	});
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum pixelSumTiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	integral::AreaResize resizer(pixelSum);
+
+	std::cout << "Area resize (" << xWidth << "x" << yWidth << ")" << std::endl;
+
+	std::vector<unsigned char> dst;
+
+	auto resize = [&](int dstWidth, int dstHeight) {
+		dst.assign(dstWidth * dstHeight, 0);
+		resizer.resize(dstWidth, dstHeight, dst.data());
+		return checkResize(pixelSum, dstWidth, dstHeight, dst);
+	};
+
+	// Tests
+	TEST_CHECK(resize(xWidth, yWidth) && dst == values, "Same size             ", "Resize");
+	TEST_CHECK(resize(std::max(1, xWidth / 2), std::max(1, yWidth / 2)), "Half                  ", "Resize");
+	TEST_CHECK(resize(std::max(1, xWidth * 2 / 3), std::max(1, yWidth * 3 / 7)), "2/3 x 3/7             ", "Resize");
+	TEST_CHECK(resize(1, 1), "1x1                   ", "Resize");
+	TEST_CHECK(resize(xWidth + 3, yWidth * 2), "Upscale               ", "Resize");
+
+	std::vector<unsigned char> tiled(dst.size());
+	integral::AreaResize(pixelSumTiled, 1).resize(xWidth + 3, yWidth * 2, tiled.data());
+	TEST_CHECK(tiled == dst, "Upscale tiled         ", "Resize");
+
+	// Mipmap chain
+	int levels = resizer.getMipmapLevels();
+
+	std::vector<std::vector<unsigned char>> chain;
+	std::vector<unsigned char*> chainPtrs;
+
+	for (int level = 0; level < levels; ++level)
+	{
+		chain.emplace_back(resizer.getMipmapWidth(level) * resizer.getMipmapHeight(level));
+		chainPtrs.push_back(chain.back().data());
+	}
+
+	auto makeTimeMks = measureMks([&]() {
+		resizer.getMipmapChain(levels, chainPtrs.data());
+	});
+	std::cout << "Mipmap chain " << levels << " levels time: " << makeTimeMks << "mks" << std::endl;
+
+	bool levelsEqual = chain[0] == values && resizer.getMipmapWidth(levels - 1) == 1 && resizer.getMipmapHeight(levels - 1) == 1;
+	for (int level = 1; level < levels; ++level)
+	{
+		levelsEqual = levelsEqual && checkResize(pixelSum, resizer.getMipmapWidth(level), resizer.getMipmapHeight(level), chain[level]);
+	}
+
+	TEST_CHECK(levelsEqual, "All levels            ", "Mipmap");
+
+	std::cout << std::endl;
+}
+
+// NCC of the template at (x, y) in double
+double referenceNcc(const std::vector<unsigned char>& values, int xWidth, const std::vector<unsigned char>& templ, int tWidth, int tHeight, int x, int y)
+{
+	double n = double(tWidth) * tHeight;
+	double sumI = 0.0, sumT = 0.0, sumII = 0.0, sumTT = 0.0, sumIT = 0.0;
+
+	for (int ty = 0; ty < tHeight; ++ty)
+	for (int tx = 0; tx < tWidth; ++tx)
+	{
+		double i = values[x + tx + (y + ty) * xWidth];
+		double t = templ[tx + ty * tWidth];
+
+		sumI += i;
+		sumT += t;
+		sumII += i * i;
+		sumTT += t * t;
+		sumIT += i * t;
+	}
+
+	double denominator = std::sqrt((sumII - sumI * sumI / n) * (sumTT - sumT * sumT / n));
+	return denominator > 1e-9 ? (sumIT - sumI * sumT / n) / denominator : 0.0;
+}
+
+void testCaseTemplateMatch(int xWidth = 512, int yWidth = 512, int tWidth = 24, int tHeight = 16)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth, []() {
+		return std::rand() % 256;
+	});
+
+	// Template cut from the image
+	int tx0 = (xWidth - tWidth) / 3;
+	int ty0 = (yWidth - tHeight) / 2;
+
+	std::vector<unsigned char> templ(tWidth * tHeight);
+	for (int ty = 0; ty < tHeight; ++ty)
+	{
+		std::copy(values.begin() + tx0 + (ty0 + ty) * xWidth, values.begin() + tx0 + tWidth + (ty0 + ty) * xWidth, templ.begin() + ty * tWidth);
+	}
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::TemplateMatch match(pixelSum, templ.data(), tWidth, tHeight);
+
+	int mapWidth = match.getMapWidth();
+	int mapHeight = match.getMapHeight();
+
+	std::vector<float> scores(mapWidth * mapHeight);
+
+	auto makeTimeMks = measureMks([&]() {
+		match.getScoreMap(scores.data());
+	});
+	std::cout << "Template match " << tWidth << "x" << tHeight << " (" << xWidth << "x" << yWidth << ") time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	auto checkScores = [&](int step) {
+		for (int y = 0; y < mapHeight; y += step)
+		for (int x = 0; x < mapWidth; ++x)
+		{
+			if (std::abs(scores[x + y * mapWidth] - referenceNcc(values, xWidth, templ, tWidth, tHeight, x, y)) > 1e-5)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	TEST_CHECK(checkScores(std::max(1, mapHeight / 16)), "Score map             ", "NCC");
+
+	const int k = 5;
+	integral::TemplateMatch::Match best[k];
+
+	int count = match.getTopMatches(k, best);
+
+	bool sorted = count == std::min(k, mapWidth * mapHeight);
+	for (int i = 0; i < count; ++i)
+	{
+		sorted = sorted && best[i].score == scores[best[i].x + best[i].y * mapWidth];
+		sorted = sorted && (i == 0 || best[i - 1].score >= best[i].score);
+	}
+
+	TEST_CHECK(sorted && best[0].x == tx0 && best[0].y == ty0 && best[0].score > 0.9999f, "Top matches           ", "NCC");
+	TEST_CHECK(*std::max_element(scores.begin(), scores.end()) == best[0].score, "Top score             ", "NCC");
+
+	// Flat template
+	std::vector<unsigned char> flat(tWidth * tHeight, 77);
+	integral::TemplateMatch(pixelSum, flat.data(), tWidth, tHeight, 1).getScoreMap(scores.data());
+
+	TEST_CHECK(std::all_of(scores.begin(), scores.end(), [](float score) { return score == 0.0f; }), "Flat template         ", "NCC");
+
+	std::cout << std::endl;
+}
+
+// Two-, three- and four-rectangle features of a 24x24 window
+std::vector<integral::HaarFeatureSet::Feature> makeHaarFeatures(int count)
+{
+	std::vector<integral::HaarFeatureSet::Feature> features(count);
+
+	for (auto& feature : features)
+	{
+		int type = std::rand() % 3;
+
+		int x = std::rand() % 12;
+		int y = std::rand() % 12;
+		int w = 1 + std::rand() % 6;
+		int h = 1 + std::rand() % 6;
+
+		if (type == 0)
+		{
+			feature.count = 2;
+			feature.rects[0] = { x, y, x + w - 1, y + h - 1, 1 };
+			feature.rects[1] = { x + w, y, x + 2 * w - 1, y + h - 1, -1 };
+		}
+		else if (type == 1)
+		{
+			feature.count = 3;
+			feature.rects[0] = { x, y, x + w - 1, y + h - 1, -1 };
+			feature.rects[1] = { x, y + h, x + w - 1, y + 2 * h - 1, 2 };
+			feature.rects[2] = { x, y + 2 * h, x + w - 1, y + 3 * h - 1, -1 };
+		}
+		else
+		{
+			feature.count = 4;
+			feature.rects[0] = { x, y, x + w - 1, y + h - 1, 1 };
+			feature.rects[1] = { x + w, y, x + 2 * w - 1, y + h - 1, -1 };
+			feature.rects[2] = { x, y + h, x + w - 1, y + 2 * h - 1, -1 };
+			feature.rects[3] = { x + w, y + h, x + 2 * w - 1, y + 2 * h - 1, 1 };
+		}
+	}
+
+	return features;
+}
+
+// Feature value by the pixels of the window inside of the buffer
+int referenceHaar(const std::vector<unsigned char>& values, int xWidth, int yWidth, const integral::HaarFeatureSet::Feature& feature, int x, int y)
+{
+	int result = 0;
+
+	for (int r = 0; r < feature.count; ++r)
+	{
+		const auto& rect = feature.rects[r];
+
+		for (int j = std::max(y + rect.y0, 0); j <= std::min(y + rect.y1, yWidth - 1); ++j)
+		for (int i = std::max(x + rect.x0, 0); i <= std::min(x + rect.x1, xWidth - 1); ++i)
+		{
+			result += rect.weight * values[i + j * xWidth];
+		}
+	}
+
+	return result;
+}
+
+void testCaseHaar(int xWidth = 640, int yWidth = 480, int featureCount = 2000)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth);
+	std::vector<integral::HaarFeatureSet::Feature> features = makeHaarFeatures(featureCount);
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::HaarFeatureSet featureSet(pixelSum, features.data(), featureCount);
+
+	std::cout << "Haar features " << featureCount << " (" << xWidth << "x" << yWidth << "), distinct corners: " << featureSet.getCornerCount() << std::endl;
+
+	// Windows on a grid, some of them cross the borders
+	std::vector<int> xs;
+	std::vector<int> ys;
+
+	for (int y = -4; y < yWidth; y += 13)
+	for (int x = -4; x < xWidth; x += 11)
+	{
+		xs.push_back(x);
+		ys.push_back(y);
+	}
+
+	int windows = int(xs.size());
+	std::vector<int> batch(windows * featureCount);
+
+	auto makeTimeMks = measureMks([&]() {
+		featureSet.evaluate(xs.data(), ys.data(), windows, batch.data());
+	});
+	std::cout << "Batch of " << windows << " windows time: " << makeTimeMks << "mks" << std::endl;
+
+	std::vector<int> single(featureCount);
+
+	makeTimeMks = measureMks([&]() {
+		for (int w = 0; w < windows; ++w)
+		{
+			featureSet.evaluate(xs[w], ys[w], single.data());
+		}
+	});
+	std::cout << "Window by window time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		for (int w = 0; w < windows; ++w)
+		for (int i = 0; i < featureCount; ++i)
+		{
+			int sum = 0;
+			for (int r = 0; r < features[i].count; ++r)
+			{
+				const auto& rect = features[i].rects[r];
+				sum += rect.weight * int(pixelSum.getPixelSum(xs[w] + rect.x0, ys[w] + rect.y0, xs[w] + rect.x1, ys[w] + rect.y1));
+			}
+
+			single[i] = sum;
+		}
+	});
+	std::cout << "getPixelSum per rectangle time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	auto checkWindows = [&](int step) {
+		for (int w = 0; w < windows; w += step)
+		{
+			featureSet.evaluate(xs[w], ys[w], single.data());
+
+			for (int i = 0; i < featureCount; ++i)
+			{
+				int expected = referenceHaar(values, xWidth, yWidth, features[i], xs[w], ys[w]);
+				if (single[i] != expected || batch[i + size_t(w) * featureCount] != expected)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	};
+
+	TEST_CHECK(checkWindows(std::max(1, windows / 97)), "Windows               ", "Single/Batch");
+
+	// Tiled tables are answered by the region queries
+	integral::PixelSum tiledPixelSum(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+	integral::HaarFeatureSet tiledFeatureSet(tiledPixelSum, features.data(), featureCount);
+
+	std::vector<int> tiledBatch(windows * featureCount);
+	tiledFeatureSet.evaluate(xs.data(), ys.data(), windows, tiledBatch.data());
+
+	bool same = tiledBatch == batch;
+	for (int w = 0; w < windows && same; w += std::max(1, windows / 97))
+	{
+		tiledFeatureSet.evaluate(xs[w], ys[w], single.data());
+		same = std::equal(single.begin(), single.end(), batch.begin() + size_t(w) * featureCount);
+	}
+
+	TEST_CHECK(same, "Tiled                 ", "Single/Batch");
+
+	// Adjacent rectangles share corners
+	integral::HaarFeatureSet::Feature edge = { { { 0, 0, 3, 5, 1 }, { 4, 0, 7, 5, -1 } }, 2 };
+	integral::HaarFeatureSet::Feature checker = { { { 0, 0, 1, 1, 1 }, { 2, 0, 3, 1, -1 }, { 0, 2, 1, 3, -1 }, { 2, 2, 3, 3, 1 } }, 4 };
+
+	TEST_CHECK(integral::HaarFeatureSet(pixelSum, &edge, 1).getCornerCount() == 6, "Two rectangles        ", "Shared corners");
+	TEST_CHECK(integral::HaarFeatureSet(pixelSum, &checker, 1).getCornerCount() == 9, "Four rectangles       ", "Shared corners");
+
+	std::cout << std::endl;
+}
+
+// Histogram of a region by atan2 of every pixel
+std::vector<unsigned int> referenceOrientationHistogram(const std::vector<unsigned char>& values, int xWidth, int yWidth, int bins, int x0, int y0, int x1, int y1)
+{
+	std::vector<unsigned int> histogram(bins, 0);
+
+	auto at = [&](int x, int y) {
+		return float(values[utils::clamp(x, 0, xWidth - 1) + utils::clamp(y, 0, yWidth - 1) * xWidth]);
+	};
+
+	for (int y = std::max(y0, 0); y <= std::min(y1, yWidth - 1); ++y)
+	for (int x = std::max(x0, 0); x <= std::min(x1, xWidth - 1); ++x)
+	{
+		float gx = at(x + 1, y) - at(x - 1, y);
+		float gy = at(x, y + 1) - at(x, y - 1);
+
+		double angle = std::atan2(gy, gx) * 180.0 / 3.14159265358979323846;
+		angle = angle < 0.0 ? angle + 180.0 : angle;
+		angle = angle >= 180.0 ? angle - 180.0 : angle;
+
+		int bin = std::min(int(angle * bins / 180.0), bins - 1);
+		histogram[bin] += (unsigned int)(std::sqrt(gx * gx + gy * gy) + 0.5f);
+	}
+
+	return histogram;
+}
+
+void testCaseOrientationHistogram(int xWidth = 1024, int yWidth = 1024, int bins = 9)
+{
+	// Smooth gradients with noise, all orientations
+	std::vector<unsigned char> values(xWidth * yWidth);
+	for (int y = 0; y < yWidth; ++y)
+	for (int x = 0; x < xWidth; ++x)
+	{
+		values[x + y * xWidth] = (unsigned char)utils::clamp(int(128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.07)) + std::rand() % 9 - 4, 0, 255);
+	}
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	integral::OrientationHistogram histogram(values.data(), xWidth, yWidth, bins);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "Orientation histogram " << bins << " bins (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	std::vector<unsigned int> result(bins);
+
+	auto checkRegion = [&](int x0, int y0, int x1, int y1) {
+		histogram.getHistogram(x0, y0, x1, y1, result.data());
+		return result == referenceOrientationHistogram(values, xWidth, yWidth, bins, x0, y0, x1, y1);
+	};
+
+	// Tests
+	TEST_CHECK(checkRegion(0, 0, xWidth - 1, yWidth - 1), "Whole buffer          ", "Histogram");
+	TEST_CHECK(checkRegion(xWidth / 4, yWidth / 3, xWidth / 2, yWidth / 2), "Inner region          ", "Histogram");
+	TEST_CHECK(checkRegion(-10, -10, 5, 3), "Clamped region        ", "Histogram");
+	TEST_CHECK(checkRegion(xWidth - 1, yWidth - 1, xWidth - 1, yWidth - 1), "Single pixel          ", "Histogram");
+
+	std::vector<float> normalized(bins);
+	histogram.getNormalizedHistogram(0, 0, xWidth - 1, yWidth - 1, normalized.data());
+
+	double norm = 0.0;
+	for (float value : normalized)
+	{
+		norm += double(value) * value;
+	}
+
+	TEST_CHECK(std::abs(norm - 1.0) < 1e-5, "Whole buffer          ", "Normalized");
+
+	std::cout << std::endl;
+}
+
+// Profiles of a region against the sums and counts of single rows and columns
+template<class TPixelSum>
+bool checkProfiles(const TPixelSum& pixelSum, int x0, int y0, int x1, int y1)
+{
+	typedef typename TPixelSum::Sum Sum;
+
+	// Up to the maximum size of the buffer
+	std::vector<Sum> rows(4096);
+	std::vector<Sum> columns(4096);
+	std::vector<unsigned int> nonZeroRows(rows.size());
+	std::vector<unsigned int> nonZeroColumns(columns.size());
+
+	int rowCount = pixelSum.getRowProfile(x0, y0, x1, y1, rows.data());
+	int columnCount = pixelSum.getColumnProfile(x0, y0, x1, y1, columns.data());
+
+	bool result = rowCount == pixelSum.getRowNonZeroProfile(x0, y0, x1, y1, nonZeroRows.data())
+		&& columnCount == pixelSum.getColumnNonZeroProfile(x0, y0, x1, y1, nonZeroColumns.data());
+
+	// Clamped region
+	int minX = std::max(std::min(x0, x1), 0);
+	int minY = std::max(std::min(y0, y1), 0);
+	int maxX = minX + columnCount - 1;
+	int maxY = minY + rowCount - 1;
+
+	for (int i = 0; i < rowCount && result; ++i)
+	{
+		result = rows[i] == pixelSum.getPixelSum(minX, minY + i, maxX, minY + i)
+			&& int(nonZeroRows[i]) == pixelSum.getNonZeroCount(minX, minY + i, maxX, minY + i);
+	}
+
+	for (int i = 0; i < columnCount && result; ++i)
+	{
+		result = columns[i] == pixelSum.getPixelSum(minX + i, minY, minX + i, maxY)
+			&& int(nonZeroColumns[i]) == pixelSum.getNonZeroCount(minX + i, minY, minX + i, maxY);
+	}
+
+	return result;
+}
+
+void testCaseProfiles(int xWidth = 1024, int yWidth = 1024)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	std::vector<unsigned short> values16(xWidth * yWidth);
+	std::generate(values16.begin(), values16.end(), []() {
+		return (unsigned short)(std::rand() % 4 == 0 ? 0 : (std::rand() << 1) ^ std::rand());
+	});
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum pixelSumTiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+	integral::PixelSum16 pixelSum16(values16.data(), xWidth, yWidth);
+	naivev2::PixelSum pixelSumV2(values.data(), xWidth, yWidth);
+	naivev2::PixelSum16 pixelSum16V2(values16.data(), xWidth, yWidth);
+
+	std::cout << "Profiles (" << xWidth << "x" << yWidth << ")" << std::endl;
+
+	std::vector<unsigned int> profile(std::max(xWidth, yWidth));
+
+	auto makeTimeMks = measureMks([&]() {
+		pixelSum.getRowProfile(0, 0, xWidth - 1, yWidth - 1, profile.data());
+		pixelSum.getColumnProfile(0, 0, xWidth - 1, yWidth - 1, profile.data());
+	});
+	std::cout << "Row and column profiles SAT time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		pixelSumV2.getRowProfile(0, 0, xWidth - 1, yWidth - 1, profile.data());
+		pixelSumV2.getColumnProfile(0, 0, xWidth - 1, yWidth - 1, profile.data());
+	});
+	std::cout << "Row and column profiles V2 time: " << makeTimeMks << "mks" << std::endl;
+
+	int x0 = xWidth / 5;
+	int y0 = yWidth / 7;
+	int x1 = xWidth * 3 / 4;
+	int y1 = yWidth - 2;
+
+	// Tests
+	TEST_CHECK(checkProfiles(pixelSum, x0, y0, x1, y1), "Inner region          ", "Profiles SAT");
+	TEST_CHECK(checkProfiles(pixelSum, x1, y1, -5, -9), "Clamped region        ", "Profiles SAT");
+	TEST_CHECK(checkProfiles(pixelSumTiled, x0, y0, x1, y1), "Inner region          ", "Profiles SAT tiled");
+	TEST_CHECK(checkProfiles(pixelSumTiled, -5, 0, xWidth + 5, yWidth), "Whole buffer          ", "Profiles SAT tiled");
+	TEST_CHECK(checkProfiles(pixelSum16, x0, y0, x1, y1), "Inner region          ", "Profiles SAT uint16");
+	TEST_CHECK(checkProfiles(pixelSumV2, x0, y0, x1, y1), "Inner region          ", "Profiles V2");
+	TEST_CHECK(checkProfiles(pixelSumV2, x1, y1, -5, -9), "Clamped region        ", "Profiles V2");
+	TEST_CHECK(checkProfiles(pixelSum16V2, x0, y0, x1, y1), "Inner region          ", "Profiles V2 uint16");
+
+	std::cout << std::endl;
+}
+
+// Pixel centers inside of a polygon (even-odd) or on its border
+bool isInsidePolygon(const std::vector<int>& xs, const std::vector<int>& ys, int x, int y)
+{
+	int count = int(xs.size());
+	bool inside = false;
+
+	for (int i = 0, j = count - 1; i < count; j = i++)
+	{
+		// On the edge
+		long long cross = (long long)(xs[j] - xs[i]) * (y - ys[i]) - (long long)(ys[j] - ys[i]) * (x - xs[i]);
+		if (cross == 0 && x >= std::min(xs[i], xs[j]) && x <= std::max(xs[i], xs[j]) && y >= std::min(ys[i], ys[j]) && y <= std::max(ys[i], ys[j]))
+		{
+			return true;
+		}
+
+		if ((ys[i] > y) != (ys[j] > y) && x < xs[i] + double(xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]))
+		{
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+// Sum, non-zero count and unclamped area of the pixels accepted by the predicate
+template<class TPredicate>
+void referenceShape(const std::vector<unsigned char>& values, int xWidth, int yWidth, int x0, int y0, int x1, int y1, TPredicate inside, unsigned int& sum, int& nonZero, int& area)
+{
+	sum = 0;
+	nonZero = 0;
+	area = 0;
+
+	for (int y = y0; y <= y1; ++y)
+	for (int x = x0; x <= x1; ++x)
+	{
+		if (!inside(x, y))
+		{
+			continue;
+		}
+
+		++area;
+
+		if (x >= 0 && y >= 0 && x < xWidth && y < yWidth)
+		{
+			sum += values[x + y * xWidth];
+			nonZero += values[x + y * xWidth] != 0 ? 1 : 0;
+		}
+	}
+}
+
+bool checkPolygon(const integral::PixelSum& pixelSum, const std::vector<unsigned char>& values, int xWidth, int yWidth, const std::vector<int>& xs, const std::vector<int>& ys)
+{
+	unsigned int sum;
+	int nonZero, area;
+
+	referenceShape(values, xWidth, yWidth,
+		*std::min_element(xs.begin(), xs.end()), *std::min_element(ys.begin(), ys.end()),
+		*std::max_element(xs.begin(), xs.end()), *std::max_element(ys.begin(), ys.end()),
+		[&](int x, int y) { return isInsidePolygon(xs, ys, x, y); }, sum, nonZero, area);
+
+	int count = int(xs.size());
+
+	return pixelSum.getPolygonSum(xs.data(), ys.data(), count) == sum
+		&& pixelSum.getPolygonNonZeroCount(xs.data(), ys.data(), count) == nonZero
+		&& std::abs(pixelSum.getPolygonAverage(xs.data(), ys.data(), count) - (area > 0 ? double(sum) / area : 0.0)) < 1e-9
+		&& std::abs(pixelSum.getPolygonNonZeroAverage(xs.data(), ys.data(), count) - (nonZero > 0 ? double(sum) / nonZero : 0.0)) < 1e-9;
+}
+
+bool checkDisc(const integral::PixelSum& pixelSum, const std::vector<unsigned char>& values, int xWidth, int yWidth, int cx, int cy, int radius)
+{
+	unsigned int sum;
+	int nonZero, area;
+
+	referenceShape(values, xWidth, yWidth, cx - radius, cy - radius, cx + radius, cy + radius, [&](int x, int y) {
+		return (long long)(x - cx) * (x - cx) + (long long)(y - cy) * (y - cy) <= (long long)radius * radius;
+	}, sum, nonZero, area);
+
+	return pixelSum.getDiscSum(cx, cy, radius) == sum
+		&& pixelSum.getDiscNonZeroCount(cx, cy, radius) == nonZero
+		&& std::abs(pixelSum.getDiscAverage(cx, cy, radius) - double(sum) / area) < 1e-9
+		&& std::abs(pixelSum.getDiscNonZeroAverage(cx, cy, radius) - (nonZero > 0 ? double(sum) / nonZero : 0.0)) < 1e-9;
+}
+
+void testCaseShapes(int xWidth = 1024, int yWidth = 768)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum pixelSumTiled(values.data(), xWidth, yWidth, integral::PixelSum::Layout::Tiled);
+
+	std::cout << "Polygons and discs (" << xWidth << "x" << yWidth << ")" << std::endl;
+
+	int w = xWidth - 1;
+	int h = yWidth - 1;
+
+	// Rectangle matches the inclusive rect query
+	std::vector<int> rectXs = { w / 4, w / 2, w / 2, w / 4 };
+	std::vector<int> rectYs = { h / 5, h / 5, h / 2, h / 2 };
+
+	std::vector<int> triangleXs = { w / 7, w - 3, w / 3 };
+	std::vector<int> triangleYs = { h / 9, h / 3, h - 1 };
+
+	// Concave with collinear and horizontal edges
+	std::vector<int> concaveXs = { 0, w / 2, w / 2, w / 4, w / 4, w / 8, 0 };
+	std::vector<int> concaveYs = { 0, 0, h / 2, h / 4, h / 2, h / 2, h / 4 };
+
+	// Self-intersecting star, partly outside of the buffer
+	std::vector<int> starXs = { w / 2, w / 2 + w / 3, -w / 5, w + w / 5, w / 2 - w / 3 };
+	std::vector<int> starYs = { -h / 4, h + 7, h / 3, h / 3, h + 7 };
+
+	std::vector<int> pointXs = { w / 3 };
+	std::vector<int> pointYs = { h / 3 };
+
+	auto makeTimeMks = measureMks([&]() {
+		for (int i = 0; i < 1000; ++i)
+		{
+			pixelSum.getDiscSum(w / 2, h / 2, 100);
+		}
+	});
+	std::cout << "1000 discs of radius 100 time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		for (int i = 0; i < 1000; ++i)
+		{
+			pixelSum.getPolygonSum(triangleXs.data(), triangleYs.data(), 3);
+		}
+	});
+	std::cout << "1000 triangles time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(pixelSum.getPolygonSum(rectXs.data(), rectYs.data(), 4) == pixelSum.getPixelSum(w / 4, h / 5, w / 2, h / 2), "Rectangle             ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSum, values, xWidth, yWidth, rectXs, rectYs), "Rectangle             ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSum, values, xWidth, yWidth, triangleXs, triangleYs), "Triangle              ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSumTiled, values, xWidth, yWidth, triangleXs, triangleYs), "Triangle tiled        ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSum, values, xWidth, yWidth, concaveXs, concaveYs), "Concave               ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSum, values, xWidth, yWidth, starXs, starYs), "Star outside          ", "Polygon");
+	TEST_CHECK(checkPolygon(pixelSum, values, xWidth, yWidth, pointXs, pointYs), "Single point          ", "Polygon");
+
+	TEST_CHECK(checkDisc(pixelSum, values, xWidth, yWidth, w / 2, h / 2, std::min(w, h) / 3), "Inner disc            ", "Disc");
+	TEST_CHECK(checkDisc(pixelSumTiled, values, xWidth, yWidth, w / 2, h / 2, std::min(w, h) / 3), "Inner disc tiled      ", "Disc");
+	TEST_CHECK(checkDisc(pixelSum, values, xWidth, yWidth, 3, h - 2, std::max(w, h) / 2), "Disc outside          ", "Disc");
+	TEST_CHECK(checkDisc(pixelSum, values, xWidth, yWidth, w / 3, h / 3, 0), "Radius 0              ", "Disc");
+
+	// Only the lines of the buffer are split into spans
+	TEST_CHECK(pixelSum.getDiscSum(w / 2, h / 2, 1000000) == pixelSum.getPixelSum(0, 0, w, h)
+		&& pixelSum.getDiscNonZeroCount(w / 2, h / 2, 1000000) == pixelSum.getNonZeroCount(0, 0, w, h), "Radius 1000000        ", "Disc");
+
+	std::vector<int> tallXs = { w / 4, w / 2, w / 2, w / 4 };
+	std::vector<int> tallYs = { h / 5, h / 5, INT_MAX, INT_MAX };
+
+	TEST_CHECK(pixelSum.getPolygonSum(tallXs.data(), tallYs.data(), 4) == pixelSum.getPixelSum(w / 4, h / 5, w / 2, h), "Vertex at INT_MAX     ", "Polygon");
+
+	std::cout << std::endl;
+}
+
+// Masked queries against the integral image of the masked copy and of the binary mask
+bool checkMasked(const masked::PixelSum& pixelSum, const std::vector<unsigned char>& values, const std::vector<unsigned char>& mask, int xWidth, int yWidth)
+{
+	std::vector<unsigned char> product(values.size());
+	std::vector<unsigned char> binary(values.size());
+
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		product[i] = mask[i] != 0 ? values[i] : 0;
+		binary[i] = mask[i] != 0 ? 1 : 0;
+	}
+
+	integral::PixelSum productSum(product.data(), xWidth, yWidth);
+	integral::PixelSum binarySum(binary.data(), xWidth, yWidth);
+
+	auto rects = makeRandomRects(xWidth, yWidth, 1000, std::max(xWidth, yWidth));
+	rects.push_back(utils::Rect(-5, -5, xWidth + 5, yWidth + 5));
+
+	for (const auto& rect : rects)
+	{
+		unsigned int sum = productSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		int count = int(binarySum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1));
+		double average = count > 0 ? double(sum) / count : 0.0;
+
+		if (pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) != sum
+			|| pixelSum.getMaskCount(rect.x0, rect.y0, rect.x1, rect.y1) != count
+			|| std::abs(pixelSum.getPixelAverage(rect.x0, rect.y0, rect.x1, rect.y1) - average) > 1e-9)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseMasked(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeData(xWidth, yWidth);
+
+	// Blobs and noise
+	std::vector<unsigned char> mask = makeData(xWidth, yWidth, []() {
+		return std::rand() % 5 == 0 ? 0 : 255;
+	});
+
+	std::vector<unsigned char> disc(xWidth * yWidth);
+	for (int y = 0; y < yWidth; ++y)
+	for (int x = 0; x < xWidth; ++x)
+	{
+		int dx = x - xWidth / 2;
+		int dy = y - yWidth / 2;
+		disc[x + y * xWidth] = dx * dx + dy * dy <= xWidth * yWidth / 9 ? 1 : 0;
+	}
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	masked::PixelSum pixelSum(values.data(), mask.data(), xWidth, yWidth);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "Masked (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		pixelSum.setMask(disc.data());
+	});
+	std::cout << "Swap mask time: " << makeTimeMks << "mks" << std::endl;
+
+	makeTimeMks = measureMks([&]() {
+		std::vector<unsigned char> product(values.size());
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			product[i] = disc[i] != 0 ? values[i] : 0;
+		}
+
+		integral::PixelSum productSum(product.data(), xWidth, yWidth);
+		integral::PixelSum binarySum(disc.data(), xWidth, yWidth);
+	});
+	std::cout << "Masked copy and two SAT time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(checkMasked(pixelSum, values, disc, xWidth, yWidth), "Random rects, disc    ", "Masked Sum/Count/Avg");
+
+	pixelSum.setMask(mask.data());
+	TEST_CHECK(checkMasked(pixelSum, values, mask, xWidth, yWidth), "Random rects, noise   ", "Masked Sum/Count/Avg");
+
+	masked::PixelSum copy(pixelSum);
+	copy.setMask(disc.data());
+	TEST_CHECK(checkMasked(pixelSum, values, mask, xWidth, yWidth) && checkMasked(copy, values, disc, xWidth, yWidth), "Copy, other mask      ", "Masked Sum/Count/Avg");
+
+	std::cout << std::endl;
+}
+
+// Random walk of a window, steps of a few pixels, jumps and resizes
+bool checkTracker(const naivev2::PixelSum& pixelSum, int steps, int maxStep, bool jumps)
+{
+	int xWidth = pixelSum.getWidth();
+	int yWidth = pixelSum.getHeight();
+
+	int x0 = std::rand() % xWidth;
+	int y0 = std::rand() % yWidth;
+	int width = std::rand() % std::max(xWidth / 2, 1) + 1;
+	int height = std::rand() % std::max(yWidth / 2, 1) + 1;
+
+	naivev2::WindowTracker tracker(pixelSum, x0, y0, x0 + width - 1, y0 + height - 1);
+
+	for (int i = 0; i < steps; ++i)
+	{
+		if (jumps && std::rand() % 10 == 0)
+		{
+			// Anywhere, partially or fully outside of the buffer, any size
+			x0 = std::rand() % (xWidth * 2) - xWidth / 2;
+			y0 = std::rand() % (yWidth * 2) - yWidth / 2;
+			width = std::rand() % xWidth + 1;
+			height = std::rand() % yWidth + 1;
+
+			tracker.setWindow(x0 + width - 1, y0 + height - 1, x0, y0);
+		}
+		else
+		{
+			tracker.move(std::rand() % (maxStep * 2 + 1) - maxStep, std::rand() % (maxStep * 2 + 1) - maxStep);
+		}
+
+		int wx0 = tracker.getX0();
+		int wy0 = tracker.getY0();
+		int wx1 = tracker.getX1();
+		int wy1 = tracker.getY1();
+
+		if (tracker.getPixelSum() != pixelSum.getPixelSum(wx0, wy0, wx1, wy1)
+			|| tracker.getNonZeroCount() != pixelSum.getNonZeroCount(wx0, wy0, wx1, wy1)
+			|| tracker.getPixelAverage() != pixelSum.getPixelAverage(wx0, wy0, wx1, wy1)
+			|| tracker.getNonZeroAverage() != pixelSum.getNonZeroAverage(wx0, wy0, wx1, wy1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseTracker(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	naivev2::PixelSum pixelSum(values.data(), xWidth, yWidth);
+
+	// Performance. 256x256 window, steps of up to 4 pixels
+	int x0 = xWidth / 4;
+	int y0 = yWidth / 4;
+	int x1 = x0 + std::min(xWidth, 256) - 1;
+	int y1 = y0 + std::min(yWidth, 256) - 1;
+
+	const int steps = 1000;
+	std::vector<int> dx(steps);
+	std::vector<int> dy(steps);
+
+	for (int i = 0; i < steps; ++i)
+	{
+		dx[i] = std::rand() % 9 - 4;
+		dy[i] = std::rand() % 9 - 4;
+	}
+
+	unsigned int trackedSum = 0;
+	auto trackerMks = measureMks([&]() {
+		naivev2::WindowTracker tracker(pixelSum, x0, y0, x1, y1);
+
+		for (int i = 0; i < steps; ++i)
+		{
+			tracker.move(dx[i], dy[i]);
+			trackedSum += tracker.getPixelSum();
+		}
+	});
+
+	unsigned int scannedSum = 0;
+	auto rescanMks = measureMks([&]() {
+		int wx0 = x0, wy0 = y0, wx1 = x1, wy1 = y1;
+
+		for (int i = 0; i < steps; ++i)
+		{
+			wx0 += dx[i]; wx1 += dx[i];
+			wy0 += dy[i]; wy1 += dy[i];
+
+			scannedSum += pixelSum.getPixelSum(wx0, wy0, wx1, wy1);
+		}
+	});
+
+	std::cout << "Tracker (" << xWidth << "x" << yWidth << ") " << steps << " steps: " << trackerMks << "mks, rescan: " << rescanMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(trackedSum == scannedSum, "Benchmark walk        ", "Tracker Sum         ");
+	TEST_CHECK(checkTracker(pixelSum, 2000, 1, false), "Steps of 1            ", "Tracker Sum/Count/Avg");
+	TEST_CHECK(checkTracker(pixelSum, 2000, 8, false), "Steps of 8            ", "Tracker Sum/Count/Avg");
+	TEST_CHECK(checkTracker(pixelSum, 2000, 8, true), "Jumps and resizes     ", "Tracker Sum/Count/Avg");
+
+	std::cout << std::endl;
+}
+
+void testCaseQueryCache(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	naivev2::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	naivev2::PixelSum cachedPixelSum(values.data(), xWidth, yWidth);
+	cachedPixelSum.setCacheSize(1000);
+
+	// Performance. 256 regions up to 256x256, each queried ~400 times
+	auto rects = makeRandomRects(xWidth, yWidth, 256, 256);
+
+	const int count = 100000;
+	std::vector<int> order(count);
+	std::generate(order.begin(), order.end(), [&]() { return std::rand() % int(rects.size()); });
+
+	unsigned int sums[2] = {};
+
+	auto scanMks = measureMks([&]() {
+		for (int index : order)
+			sums[0] += pixelSum.getPixelSum(rects[index].x0, rects[index].y0, rects[index].x1, rects[index].y1);
+	});
+
+	auto cachedMks = measureMks([&]() {
+		for (int index : order)
+			sums[1] += cachedPixelSum.getPixelSum(rects[index].x0, rects[index].y0, rects[index].x1, rects[index].y1);
+	});
+
+	long long hits, misses;
+	cachedPixelSum.getCacheCounters(hits, misses);
+
+	std::cout << "Query cache (" << xWidth << "x" << yWidth << ") " << count << " queries of " << rects.size() << " rects: scan "
+		<< scanMks << "mks, cached " << cachedMks << "mks, " << hits << " hits, " << misses << " misses" << std::endl;
+
+	// Tests
+	TEST_CHECK(sums[0] == sums[1], "Benchmark queries     ", "Cached Sum          ");
+	TEST_CHECK(cachedPixelSum.getCacheSize() == 1024 && hits > 0 && hits + misses == count, "Benchmark queries     ", "Cache counters      ");
+
+	// All queries, mixed and swapped corners, from several threads
+	std::atomic<bool> same(true);
+	utils::parallelFor(count, 4, [&](int begin, int end) {
+		bool sameRange = true;
+
+		for (int i = begin; i < end; ++i)
+		{
+			const auto& rect = rects[order[i]];
+
+			int x0 = i % 2 == 0 ? rect.x0 : rect.x1;
+			int x1 = i % 2 == 0 ? rect.x1 : rect.x0;
+
+			switch (i % 4)
+			{
+			case 0:
+				sameRange = sameRange && cachedPixelSum.getPixelSum(x0, rect.y0, x1, rect.y1) == pixelSum.getPixelSum(x0, rect.y0, x1, rect.y1);
+				break;
+			case 1:
+				sameRange = sameRange && cachedPixelSum.getPixelAverage(x0, rect.y0, x1, rect.y1) == pixelSum.getPixelAverage(x0, rect.y0, x1, rect.y1);
+				break;
+			case 2:
+				sameRange = sameRange && cachedPixelSum.getNonZeroCount(x0, rect.y0, x1, rect.y1) == pixelSum.getNonZeroCount(x0, rect.y0, x1, rect.y1);
+				break;
+			default:
+				sameRange = sameRange && cachedPixelSum.getNonZeroAverage(x0, rect.y0, x1, rect.y1) == pixelSum.getNonZeroAverage(x0, rect.y0, x1, rect.y1);
+				break;
+			}
+		}
+
+		if (!sameRange)
+			same = false;
+	});
+
+	TEST_CHECK(same, "Threads, all queries  ", "Cached Sum/Count/Avg");
+
+	// Invalidated results are scanned again
+	const auto& rect = rects[0];
+	cachedPixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+	cachedPixelSum.invalidateCache();
+
+	long long hitsBefore, missesBefore;
+	cachedPixelSum.getCacheCounters(hitsBefore, missesBefore);
+	cachedPixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+	cachedPixelSum.getNonZeroCount(rect.x0, rect.y0, rect.x1, rect.y1);
+	cachedPixelSum.getCacheCounters(hits, misses);
+
+	TEST_CHECK(misses == missesBefore + 1 && hits == hitsBefore + 1, "Invalidated           ", "Cache counters      ");
+
+	// Copies get an empty cache of the same size
+	naivev2::PixelSum copy(cachedPixelSum);
+	copy.getCacheCounters(hits, misses);
+
+	TEST_CHECK(copy.getCacheSize() == 1024 && hits == 0 && misses == 0
+		&& copy.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1) == pixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1), "Copy                  ", "Cache size          ");
+
+	copy.setCacheSize(0);
+	TEST_CHECK(copy.getCacheSize() == 0, "No cache              ", "Cache size          ");
+
+	std::cout << std::endl;
+}
+
+void testCaseHilbertBatch(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	for (auto layout : { integral::PixelSum::Layout::RowMajor, integral::PixelSum::Layout::Tiled })
+	{
+		integral::PixelSum pixelSum(values.data(), xWidth, yWidth, layout);
+
+		// Random, swapped and out of the buffer corners
+		std::vector<integral::PixelSum::Region> regions;
+		for (const auto& rect : makeRandomRects(xWidth + 20, yWidth + 20, 4096, std::max(xWidth, yWidth)))
+		{
+			regions.push_back({ rect.x1 - 10, rect.y0 - 10, rect.x0 - 10, rect.y1 - 10 });
+		}
+
+		std::vector<unsigned int> sums(regions.size());
+		std::vector<unsigned int> counts(regions.size());
+
+		pixelSum.getPixelSums(regions.data(), int(regions.size()), sums.data());
+		pixelSum.getNonZeroCounts(regions.data(), int(regions.size()), counts.data());
+
+		bool same = true;
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			const auto& region = regions[i];
+
+			same = same
+				&& sums[i] == pixelSum.getPixelSum(region.x0, region.y0, region.x1, region.y1)
+				&& int(counts[i]) == pixelSum.getNonZeroCount(region.x0, region.y0, region.x1, region.y1);
+		}
+
+		const char* name = layout == integral::PixelSum::Layout::Tiled ? "Tiled                 " : "Row-major             ";
+		TEST_CHECK(same, name, "Hilbert batch       ");
+	}
+
+	// Empty batch and other pixel types
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	pixelSum.getPixelSums(nullptr, 0, nullptr);
+
+	std::vector<float> floats(values.begin(), values.end());
+	integral::PixelSumFloat floatPixelSum(floats.data(), xWidth, yWidth);
+
+	integral::PixelSum::Region region = { 0, 0, xWidth / 2, yWidth / 2 };
+	double floatSum = 0.0;
+	floatPixelSum.getPixelSums(&region, 1, &floatSum);
+
+	TEST_CHECK(floatSum == floatPixelSum.getPixelSum(0, 0, xWidth / 2, yWidth / 2), "Float                 ", "Hilbert batch       ");
+
+	std::cout << std::endl;
+}
+
+void testCaseReplicas(int xWidth = 1024, int yWidth = 1024, int simulatedNodes = 4)
+{
+	std::vector<unsigned char> values = makeSparseData(xWidth, yWidth);
+
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+	auto rects = makeRandomRects(xWidth + 20, yWidth + 20, 10000, std::max(xWidth, yWidth));
+
+	// Nodes of the machine
+	integral::PixelSumReplicas machineReplicas(values.data(), xWidth, yWidth);
+
+	bool same = machineReplicas.getNodeCount() == integral::PixelSumReplicas::getMachineNodes()
+		&& machineReplicas.getThreadReplica() == integral::PixelSumReplicas::getCurrentNode() % machineReplicas.getNodeCount();
+
+	for (const auto& rect : rects)
+	{
+		same = same && machineReplicas.getPixelSum(rect.x0 - 10, rect.y0 - 10, rect.x1 - 10, rect.y1 - 10) == pixelSum.getPixelSum(rect.x0 - 10, rect.y0 - 10, rect.x1 - 10, rect.y1 - 10);
+	}
+
+	TEST_CHECK(same, "Machine nodes         ", "Replicas            ");
+
+	// Simulated nodes, a thread per node
+	auto makeMks = measureMks([&]() { integral::PixelSumReplicas(values.data(), xWidth, yWidth, simulatedNodes); });
+	integral::PixelSumReplicas replicas(values.data(), xWidth, yWidth, simulatedNodes);
+
+	std::atomic<bool> routed(true);
+	std::atomic<bool> sameNodes(true);
+
+	utils::parallelFor(simulatedNodes, simulatedNodes, [&](int begin, int end) {
+		for (int node = begin; node < end; ++node)
+		{
+			integral::PixelSumReplicas::setThreadNode(node);
+
+			if (replicas.getThreadReplica() != node)
+				routed = false;
+
+			for (const auto& rect : rects)
+			{
+				int x0 = rect.x0 - 10, y0 = rect.y0 - 10, x1 = rect.x1 - 10, y1 = rect.y1 - 10;
+
+				if (replicas.getPixelSum(x0, y0, x1, y1) != pixelSum.getPixelSum(x0, y0, x1, y1)
+					|| replicas.getPixelAverage(x0, y0, x1, y1) != pixelSum.getPixelAverage(x0, y0, x1, y1)
+					|| replicas.getNonZeroCount(x0, y0, x1, y1) != pixelSum.getNonZeroCount(x0, y0, x1, y1)
+					|| replicas.getNonZeroAverage(x0, y0, x1, y1) != pixelSum.getNonZeroAverage(x0, y0, x1, y1))
+				{
+					sameNodes = false;
+				}
+			}
+
+			integral::PixelSumReplicas::setThreadNode(-1);
+		}
+	});
+
+	std::cout << "Replicas (" << xWidth << "x" << yWidth << ") " << simulatedNodes << " simulated nodes on "
+		<< integral::PixelSumReplicas::getMachineNodes() << ", preparation " << makeMks << "mks, per machine node:";
+
+	int machineNodes = integral::PixelSumReplicas::getMachineNodes();
+
+	bool distinct = true;
+	size_t totalBytes = 0;
+
+	// Replicas add up on the machine nodes they were placed on
+	for (int node = 0; node < machineNodes; ++node)
+	{
+		std::cout << " " << replicas.getNodeBytes(node) / 1024 << "KiB";
+		totalBytes += replicas.getNodeBytes(node);
+	}
+
+	for (int node = 0; node < replicas.getNodeCount(); ++node)
+	{
+		distinct = distinct && replicas.getReplicaNode(node) >= 0 && replicas.getReplicaNode(node) < machineNodes
+			&& (node == 0 || replicas.getReplica(node).getSummedArea() != replicas.getReplica(0).getSummedArea());
+	}
+
+	std::cout << std::endl;
+
+	// Tests
+	TEST_CHECK(routed, "Simulated nodes       ", "Thread routing      ");
+	TEST_CHECK(sameNodes, "Simulated nodes       ", "Replicas Sum/Count/Avg");
+	TEST_CHECK(distinct && totalBytes == size_t(simulatedNodes) * integral::PixelSumRegistry::getTableBytes(xWidth, yWidth), "Simulated nodes       ", "Node memory         ");
+
+	std::cout << std::endl;
+}
+
+// Batches of 4k random regions one by one and in the Hilbert order
+void benchmarkHilbertBatch(int xWidth = 4096, int yWidth = 4096, int batches = 250)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+	const int count = 4096;
+
+	for (auto layout : { integral::PixelSum::Layout::RowMajor, integral::PixelSum::Layout::Tiled })
+	{
+		integral::PixelSum pixelSum(values.data(), xWidth, yWidth, layout);
+
+		for (int maxSize : { 16, 256 })
+		{
+			std::vector<std::vector<integral::PixelSum::Region>> sets(batches);
+			for (auto& regions : sets)
+			{
+				for (const auto& rect : makeRandomRects(xWidth, yWidth, count, maxSize))
+				{
+					regions.push_back({ rect.x0, rect.y0, rect.x1, rect.y1 });
+				}
+			}
+
+			std::vector<unsigned int> sums(count);
+			unsigned int total[2] = {};
+
+			auto singleMks = measureMks([&]() {
+				for (const auto& regions : sets)
+				{
+					for (int i = 0; i < count; ++i)
+						sums[i] = pixelSum.getPixelSum(regions[i].x0, regions[i].y0, regions[i].x1, regions[i].y1);
+
+					total[0] += sums[count - 1];
+				}
+			});
+
+			auto batchMks = measureMks([&]() {
+				for (const auto& regions : sets)
+				{
+					pixelSum.getPixelSums(regions.data(), count, sums.data());
+					total[1] += sums[count - 1];
+				}
+			});
+
+			std::cout << "Hilbert batch (" << xWidth << "x" << yWidth << (layout == integral::PixelSum::Layout::Tiled ? ", tiled) " : ") ")
+				<< batches << "x" << count << " rects up to " << maxSize << ": one by one " << singleMks << "mks, batch " << batchMks << "mks" << std::endl;
+
+			TEST_CHECK(total[0] == total[1], "Hilbert batch", "Same sums");
+		}
+	}
+
+	std::cout << std::endl;
+}
+
+// Preparation and queries of the three exact engines
+void benchmarkEngines(int xWidth = 4096, int yWidth = 4096, int count = 100000)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+
+	long long makeMks[3];
+
+	makeMks[0] = measureMks([&]() { naivev2::PixelSum(values.data(), xWidth, yWidth); });
+	makeMks[1] = measureMks([&]() { rowprefix::PixelSum(values.data(), xWidth, yWidth); });
+	makeMks[2] = measureMks([&]() { integral::PixelSum(values.data(), xWidth, yWidth); });
+
+	naivev2::PixelSum naivePixelSum(values.data(), xWidth, yWidth);
+	rowprefix::PixelSum rowPixelSum(values.data(), xWidth, yWidth);
+	integral::PixelSum integralPixelSum(values.data(), xWidth, yWidth);
+
+	std::cout << "Engines (" << xWidth << "x" << yWidth << ") preparation: naivev2 " << makeMks[0]
+		<< "mks, row prefix " << makeMks[1] << "mks, integral " << makeMks[2] << "mks" << std::endl;
+
+	for (int maxSize : { 16, 256 })
+	{
+		auto rects = makeRandomRects(xWidth, yWidth, count, maxSize);
+		unsigned int sums[3] = {};
+
+		auto naiveMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				sums[0] += naivePixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		auto rowMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				sums[1] += rowPixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		auto integralMks = measureMks([&]() {
+			for (const auto& rect : rects)
+				sums[2] += integralPixelSum.getPixelSum(rect.x0, rect.y0, rect.x1, rect.y1);
+		});
+
+		std::cout << count << " rects up to " << maxSize << ": naivev2 " << naiveMks << "mks, row prefix "
+			<< rowMks << "mks, integral " << integralMks << "mks" << std::endl;
+
+		TEST_CHECK(sums[0] == sums[1] && sums[1] == sums[2], "Engines", "Same sums");
+	}
+
+	std::cout << std::endl;
+}
+
+void benchmarkBoxFilter(int xWidth = 4096, int yWidth = 4096, int radius = 5)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+	integral::PixelSum pixelSum(values.data(), xWidth, yWidth);
+
+	std::vector<float> means(xWidth * yWidth);
+
+	// Query per pixel
+	auto queryMks = measureMks([&]() {
+		for (int y = 0; y < yWidth; ++y)
+		for (int x = 0; x < xWidth; ++x)
+		{
+			means[x + y * xWidth] = float(pixelSum.getPixelAverage(x - radius, y - radius, x + radius, y + radius));
+		}
+	});
+
+	auto singleMks = measureMks([&]() {
+		integral::BoxFilter(pixelSum, 1).getMean(radius, means.data());
+	});
+
+	auto parallelMks = measureMks([&]() {
+		integral::BoxFilter(pixelSum).getMean(radius, means.data());
+	});
+
+	std::cout << "Box filter mean (" << xWidth << "x" << yWidth << ", r = " << radius << ")" << std::endl;
+	std::cout << "getPixelAverage per pixel: " << queryMks << "mks" << std::endl;
+	std::cout << "BoxFilter 1 thread:        " << singleMks << "mks" << std::endl;
+	std::cout << "BoxFilter all threads:     " << parallelMks << "mks" << std::endl;
+	std::cout << std::endl;
+}
+
+bool checkHistogram(const integral::PixelHistogram& histogram, const std::vector<unsigned char>& values, int xWidth, int x0, int y0, int x1, int y1)
+{
+	std::vector<unsigned int> expected(histogram.getBins(), 0);
+	std::vector<unsigned int> result(histogram.getBins(), 0);
+
+	for (int y = y0; y <= y1; ++y)
+	for (int x = x0; x <= x1; ++x)
+	{
+		++expected[histogram.getBin(values[x + y * xWidth])];
+	}
+
+	histogram.getHistogram(x0, y0, x1, y1, result.data());
+	return expected == result;
+}
+
+void testCaseHistogram(int xWidth = 4096, int yWidth = 4096, int bins = 16)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+	naive::PixelSum pixelSum0(values.data(), xWidth, yWidth);
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	integral::PixelHistogram histogram(values.data(), xWidth, yWidth, bins);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "Histogram " << bins << " bins (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(checkHistogram(histogram, values, xWidth, 0, 0, xWidth - 1, yWidth - 1), "(0, 0, 100%, 100%)    ", "Histogram");
+	TEST_CHECK(checkHistogram(histogram, values, xWidth, xWidth / 2, yWidth / 2, xWidth / 2, yWidth / 2), "(50%, 50%, 50%, 50%)  ", "Histogram");
+	TEST_CHECK(checkHistogram(histogram, values, xWidth, xWidth / 4 + 1, yWidth / 4 + 3, xWidth * 3 / 4, yWidth * 3 / 4), "(25%, 25%, 75%, 75%)  ", "Histogram");
+
+	// Count above the last value of the bin below the middle
+	int bin = bins / 2 - 1;
+	int threshold = histogram.getBinWidth() * (bin + 1) - 1;
+	unsigned int countAbove = 0;
+	for (int y = yWidth / 4; y <= yWidth / 2; ++y)
+	for (int x = xWidth / 4; x <= xWidth / 2; ++x)
+	{
+		countAbove += values[x + y * xWidth] > threshold ? 1 : 0;
+	}
+
+	TEST_CHECK(histogram.getCountAbove(xWidth / 2, yWidth / 2, xWidth / 4, yWidth / 4, bin) == countAbove, "(50%, 50%, 25%, 25%)  ", "CountAbove");
+	TEST_CHECK(histogram.getCountAbove(-10, -10, xWidth + 10, yWidth + 10, bins - 1) == 0, "(-10, -10, 110%, 110%)", "CountAbove last bin");
+	TEST_CHECK(histogram.getCountAbove(-10, -10, xWidth + 10, yWidth + 10, -1) == unsigned(xWidth * yWidth), "(-10, -10, 110%, 110%)", "CountAbove all");
+	TEST_CHECK(histogram.getCountAbove(-10, -10, xWidth + 10, yWidth + 10, bin) == histogram.getCountAbove(0, 0, xWidth - 1, yWidth - 1, bin), "(-10, -10, 110%, 110%)", "CountAbove clamped");
+
+	std::cout << std::endl;
+}
+
+bool checkMinMax(const sparse::PixelMinMax& minMax, const std::vector<unsigned char>& values, int xWidth, int yWidth, const std::vector<utils::Rect>& rects)
+{
+	for (const auto& rect : rects)
+	{
+		auto region = rect.normalized().intersected(0, 0, xWidth - 1, yWidth - 1);
+
+		unsigned char expectedMin = 255;
+		unsigned char expectedMax = 0;
+
+		for (int y = region.y0; y <= region.y1; ++y)
+		for (int x = region.x0; x <= region.x1; ++x)
+		{
+			expectedMin = std::min(expectedMin, values[x + y * xWidth]);
+			expectedMax = std::max(expectedMax, values[x + y * xWidth]);
+		}
+
+		if (minMax.getMin(rect.x0, rect.y0, rect.x1, rect.y1) != expectedMin ||
+			minMax.getMax(rect.x0, rect.y0, rect.x1, rect.y1) != expectedMax)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void testCaseMinMax(int xWidth = 4096, int yWidth = 4096)
+{
+	// Smooth data, so the extremes are not always 0 and 255
+	std::vector<unsigned char> values = makeData(xWidth, yWidth);
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	sparse::PixelMinMax minMax(values.data(), xWidth, yWidth);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "Sparse min/max (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(minMax.getMin(0, 0, xWidth - 1, yWidth - 1) == 0, "(0, 0, 100%, 100%)    ", "Min");
+	TEST_CHECK(minMax.getMax(-10, -10, xWidth + 10, yWidth + 10) == 255, "(-10, -10, 110%, 110%)", "Max");
+	TEST_CHECK(checkMinMax(minMax, values, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 1000, 20)), "Random rects up to 20  ", "Min/Max");
+	TEST_CHECK(checkMinMax(minMax, values, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 100, 300)), "Random rects up to 300 ", "Min/Max");
+	TEST_CHECK(checkMinMax(minMax, values, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 10, std::max(xWidth, yWidth))), "Random rects           ", "Min/Max");
+
+	std::cout << std::endl;
+}
+
+bool checkQuantile(const wavelet::PixelQuantile& quantile, const std::vector<unsigned char>& values, int xWidth, int yWidth, const std::vector<utils::Rect>& rects)
+{
+	for (const auto& rect : rects)
+	{
+		auto region = rect.normalized().intersected(0, 0, xWidth - 1, yWidth - 1);
+
+		std::vector<unsigned char> regionValues;
+		for (int y = region.y0; y <= region.y1; ++y)
+		for (int x = region.x0; x <= region.x1; ++x)
+		{
+			regionValues.push_back(values[x + y * xWidth]);
+		}
+
+		int count = int(regionValues.size());
+		int rank = int(std::count_if(regionValues.begin(), regionValues.end(), [](unsigned char value) { return value < 100; }));
+
+		if (quantile.getRank(rect.x0, rect.y0, rect.x1, rect.y1, 100) != rank)
+		{
+			return false;
+		}
+
+		for (double percentile : { 0.1, 0.5, 0.9 })
+		{
+			int k = std::max(int(std::ceil(percentile * count)) - 1, 0);
+			std::nth_element(regionValues.begin(), regionValues.begin() + k, regionValues.end());
+
+			if (quantile.getPercentile(rect.x0, rect.y0, rect.x1, rect.y1, percentile) != regionValues[k])
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void testCaseQuantile(int xWidth = 4096, int yWidth = 4096)
+{
+	std::vector<unsigned char> values = makeRandomData(xWidth, yWidth);
+
+	auto startMakeTime = std::chrono::high_resolution_clock::now();
+	wavelet::PixelQuantile quantile(values.data(), xWidth, yWidth);
+	auto finisMakeTime = std::chrono::high_resolution_clock::now();
+
+	auto makeTimeMks = std::chrono::duration_cast<std::chrono::microseconds>(finisMakeTime - startMakeTime).count();
+	std::cout << "Wavelet quantile (" << xWidth << "x" << yWidth << ") Preparational time: " << makeTimeMks << "mks" << std::endl;
+
+	// Tests
+	TEST_CHECK(quantile.getQuantile(0, 0, xWidth - 1, yWidth - 1, 0) == *std::min_element(values.begin(), values.end()), "(0, 0, 100%, 100%)    ", "Min");
+	TEST_CHECK(quantile.getPercentile(-10, -10, xWidth + 10, yWidth + 10, 1.0) == *std::max_element(values.begin(), values.end()), "(-10, -10, 110%, 110%)", "Max");
+	TEST_CHECK(quantile.getMedian(xWidth / 2, yWidth / 2, xWidth / 2, yWidth / 2) == values[xWidth / 2 + yWidth / 2 * xWidth], "(50%, 50%, 50%, 50%)  ", "Median");
+	TEST_CHECK(checkQuantile(quantile, values, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 200, 64)), "Random rects up to 64  ", "Rank/Percentile");
+	TEST_CHECK(checkQuantile(quantile, values, xWidth, yWidth, makeRandomRects(xWidth, yWidth, 5, 1024)), "Random rects up to 1024", "Rank/Percentile");
+
+	std::cout << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+#ifdef __AVX2__
+	showCpuSupport();
+	if (!isAVXSupport())
+	{
+		std::cout << "AVX not supported" << std::endl;
+		return -1;
+	}
+#elif __SSE2__
+	// x86 64 minimum SSE2
+#endif // __SSE2__
+
+	std::srand(unsigned(std::time(0)));
+
+	// Tests
+	testCaseNaive();
+	testCaseMain();
+	testCaseMain(359, 257);
+	testCaseNoZero();
+	testCaseOnlyZero();
+	testCaseMax();
+	testCaseTiled();
+	testCaseTiled(359, 257);
+	testCaseRowPrefix();
+	testCaseRowPrefix(359, 257);
+	testCaseRowPrefix(1, 1);
+	testCasePyramid();
+	testCasePyramid(359, 257);
+	testCasePyramid(7, 5);
+	testCaseBatch();
+	testCaseBatch(32, 32, 1037);
+	testCaseBatch(97, 61, 21);
+	testCaseBatch(1, 1, 3);
+	testCaseRegistry();
+	testCaseRegistry(37, 29, 5);
+	testCaseTilted();
+	testCaseTilted(359, 257);
+	testCaseTilted(64, 300);
+	testCaseColor("RGB", integral::PixelSum::Format::RGB, 3);
+	testCaseColor("RGBA", integral::PixelSum::Format::RGBA, 4);
+	testCaseColor("BGR", integral::PixelSum::Format::BGR, 3, 359, 257);
+	testCaseColor("BGRA", integral::PixelSum::Format::BGRA, 4, 359, 257);
+	testCaseColor("planar RGB", integral::PixelSum::Format::PlanarRGB, 3);
+	testCaseColor("planar RGB", integral::PixelSum::Format::PlanarRGB, 3, 359, 257);
+	testCasePixelTypes();
+	testCasePixelTypes(359, 257);
+	testCaseVolume();
+	testCaseVolume(37, 29, 20, 3);
+	testCaseBoxFilter();
+	testCaseBoxFilter(359, 257);
+	testCaseBoxFilter(7, 5);
+	testCaseThreshold();
+	testCaseThreshold(359, 257);
+	testCaseResize();
+	testCaseResize(359, 257);
+	testCaseResize(1, 7);
+	testCaseTemplateMatch();
+	testCaseTemplateMatch(97, 61, 7, 5);
+	testCaseTemplateMatch(8, 8, 8, 8);
+	testCaseHaar();
+	testCaseHaar(37, 29, 17);
+	testCaseOrientationHistogram();
+	testCaseOrientationHistogram(97, 61, 5);
+	testCaseOrientationHistogram(1, 3, 9);
+	testCaseProfiles();
+	testCaseProfiles(359, 257);
+	testCaseProfiles(1, 1);
+	testCaseShapes();
+	testCaseShapes(37, 29);
+	testCaseMasked(1024, 1024);
+	testCaseMasked(359, 257);
+	testCaseMasked(7, 5);
+	testCaseTracker(1024, 1024);
+	testCaseTracker(359, 257);
+	testCaseTracker(7, 5);
+	testCaseQueryCache(1024, 1024);
+	testCaseQueryCache(359, 257);
+	testCaseQueryCache(7, 5);
+	testCaseHilbertBatch();
+	testCaseHilbertBatch(359, 257);
+	testCaseHilbertBatch(1, 1);
+	testCaseReplicas();
+	testCaseReplicas(37, 29, 3);
+	testCaseHistogram();
+	testCaseHistogram(359, 257, 8);
+	testCaseHistogram(1024, 1024, 32);
+	testCaseMinMax();
+	testCaseMinMax(359, 257);
+	testCaseQuantile();
+	testCaseQuantile(359, 257);
+
+	// Benchmarks
+	benchmarkLayout();
+	benchmarkEngines();
+	benchmarkHilbertBatch();
+	benchmarkBoxFilter();
 
 	return 0;
 }
\ No newline at end of file